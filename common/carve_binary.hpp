@@ -0,0 +1,85 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <cstdint>
+
+// Layout of the carve native binary mesh format (.cmesh), used to
+// cache fully built MeshSet<3> instances. All fields are 8 byte
+// aligned, so that a mapped file can be used in place. Numbers are
+// stored in host byte order; the byte_order mark identifies files written on
+// a machine of the other endianness.
+//
+//   header
+//   double     vertex[n_vertices][3]
+//   mesh_rec   mesh[n_meshes]
+//   face_rec   face[n_faces]     (in mesh order)
+//   edge_rec   edge[n_edges]     (in face order, each face's loop
+//                                 starting at face->edge)
+//   uint64_t   open_edge[..]     (for each mesh, n_open edge indices,
+//   uint64_t   closed_edge[..]    then n_closed edge indices)
+//
+// next/prev/face links of the half-edge structure are implied by
+// the edge ordering, so only vertex and rev indices are stored.
+namespace carve_binary {
+static const char MAGIC[8] = {'C', 'A', 'R', 'V', 'E', 'M', 'S', 'H'};
+static const uint32_t VERSION = 1;
+static const uint32_t ENDIAN_MARK = 0x01020304;
+static const uint64_t NONE = ~uint64_t(0);
+
+struct header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t n_vertices;
+	uint64_t n_meshes;
+	uint64_t n_faces;
+	uint64_t n_edges;
+};
+
+struct mesh_rec
+{
+	uint64_t n_faces;
+	uint64_t n_open;
+	uint64_t n_closed;
+	uint64_t is_negative;
+};
+
+struct face_rec
+{
+	uint64_t n_edges;
+	uint64_t id;
+	double N[3];
+	double d;
+};
+
+struct edge_rec
+{
+	uint64_t vert;
+	uint64_t rev;
+};
+} // namespace carve_binary
@@ -23,20 +23,31 @@
 // SOFTWARE.
 
 #include "read_ply.hpp"
+#include "carve_binary.hpp"
 
 #include <carve/input.hpp>
+#include <carve/parallel.hpp>
 #include <gloop/model/obj_format.hpp>
 #include <gloop/model/ply_format.hpp>
 #include <gloop/model/stream.hpp>
 #include <gloop/model/vtk_format.hpp>
 
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unordered_map>
 
 #ifndef WIN32
 #	include <cstdint>
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
 #endif
 
 namespace {
@@ -109,10 +120,41 @@ vertex_component<idx, curr_t>* vertex_component_inserter(const curr_t* i)
 	return new vertex_component<idx, curr_t>(i);
 }
 
+// Appends vertices directly to a StreamingPolyhedronData.
+struct stream_vertex : public gloop::stream::null_reader
+{
+	carve::input::StreamingPolyhedronData* data;
+	explicit stream_vertex(carve::input::StreamingPolyhedronData* _data)
+			: data(_data) {}
+	void next() override { data->addVertex(carve::geom3d::Vector()); }
+	void length(int l) override
+	{
+		if (l > 0)
+		{
+			data->reserveVertices(data->getVertexCount() + l);
+		}
+	}
+	void end() override {}
+	carve::geom3d::Vector& curr() const { return data->lastVertex(); }
+};
+
+vertex<std::vector<carve::geom3d::Vector>>* polyhedron_vertex_inserter(
+		carve::input::PolyhedronData* data)
+{
+	return vertex_inserter(data->points);
+}
+
+stream_vertex* polyhedron_vertex_inserter(
+		carve::input::StreamingPolyhedronData* data)
+{
+	return new stream_vertex(data);
+}
+
+template<typename data_t>
 struct face : public gloop::stream::null_reader
 {
-	carve::input::PolyhedronData* data;
-	explicit face(carve::input::PolyhedronData* _data) : data(_data) {}
+	data_t* data;
+	explicit face(data_t* _data) : data(_data) {}
 	void length(int l) override
 	{
 		if (l > 0)
@@ -122,12 +164,13 @@ struct face : public gloop::stream::null_reader
 	}
 };
 
+template<typename data_t>
 struct face_idx : public gloop::stream::reader<int>
 {
-	carve::input::PolyhedronData* data;
+	data_t* data;
 	mutable std::vector<int> vidx;
 
-	explicit face_idx(carve::input::PolyhedronData* _data)
+	explicit face_idx(data_t* _data)
 			: data(_data), vidx() {}
 
 	void length(int l) override
@@ -139,13 +182,14 @@ struct face_idx : public gloop::stream::reader<int>
 	void end() override { data->addFace(vidx.begin(), vidx.end()); }
 };
 
+template<typename data_t>
 struct tristrip_idx : public gloop::stream::reader<int>
 {
-	carve::input::PolyhedronData* data;
+	data_t* data;
 	mutable int a, b, c;
 	mutable bool clk;
 
-	explicit tristrip_idx(carve::input::PolyhedronData* _data)
+	explicit tristrip_idx(data_t* _data)
 			: data(_data), a(-1), b(-1), c(-1), clk(true) {}
 
 	void value(int val) override
@@ -225,11 +269,12 @@ struct begin_polyline : public gloop::stream::null_reader
 	void fail() override { delete data; }
 };
 
+template<typename data_t>
 struct begin_polyhedron : public gloop::stream::null_reader
 {
 	gloop::stream::model_reader& sr;
 	carve::input::Input& inputs;
-	carve::input::PolyhedronData* data;
+	data_t* data;
 
 	begin_polyhedron(gloop::stream::model_reader& _sr,
 			carve::input::Input& _inputs)
@@ -237,39 +282,403 @@ struct begin_polyhedron : public gloop::stream::null_reader
 	~begin_polyhedron() override = default;
 	void begin() override
 	{
-		data = new carve::input::PolyhedronData();
-		vertex<std::vector<carve::geom3d::Vector>>* vi =
-				vertex_inserter(data->points);
+		data = new data_t();
+		auto* vi = polyhedron_vertex_inserter(data);
 		sr.addReader("polyhedron.vertex", vi);
 		sr.addReader("polyhedron.vertex.x", vertex_component_inserter<0>(vi));
 		sr.addReader("polyhedron.vertex.y", vertex_component_inserter<1>(vi));
 		sr.addReader("polyhedron.vertex.z", vertex_component_inserter<2>(vi));
 
-		sr.addReader("polyhedron.face", new face(data));
-		sr.addReader("polyhedron.face.vertex_indices", new face_idx(data));
+		sr.addReader("polyhedron.face", new face<data_t>(data));
+		sr.addReader("polyhedron.face.vertex_indices", new face_idx<data_t>(data));
 
-		sr.addReader("polyhedron.tristrips.vertex_indices", new tristrip_idx(data));
+		sr.addReader("polyhedron.tristrips.vertex_indices", new tristrip_idx<data_t>(data));
 	}
 	void end() override { inputs.addDataBlock(data); }
 	void fail() override { delete data; }
 };
 
+// With streaming set, polyhedra are read into StreamingPolyhedronData
+// blocks, which can only be turned into a MeshSet<3>.
 void modelSetup(carve::input::Input& inputs,
-		gloop::stream::model_reader& model)
+		gloop::stream::model_reader& model, bool streaming)
 {
-	model.addReader("polyhedron", new begin_polyhedron(model, inputs));
+	if (streaming)
+	{
+		model.addReader("polyhedron",
+				new begin_polyhedron<carve::input::StreamingPolyhedronData>(model, inputs));
+	}
+	else
+	{
+		model.addReader("polyhedron",
+				new begin_polyhedron<carve::input::PolyhedronData>(model, inputs));
+	}
 	model.addReader("polyline", new begin_polyline(model, inputs));
 	model.addReader("pointset", new begin_pointset(model, inputs));
 }
 } // namespace
 
+namespace {
+// Key of a welding cell. With a zero tolerance the key is the bit
+// pattern of the coordinates, so that only identical points share a
+// cell; otherwise it is the integer grid cell of size tolerance.
+struct weld_key
+{
+	uint64_t k[3];
+
+	bool operator==(const weld_key& o) const
+	{
+		return k[0] == o.k[0] && k[1] == o.k[1] && k[2] == o.k[2];
+	}
+};
+
+struct hash_weld_key
+{
+	size_t operator()(const weld_key& key) const
+	{
+		uint64_t h = key.k[0] * 0x9e3779b97f4a7c15ULL;
+		h = (h ^ (h >> 29)) + key.k[1] * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 31)) + key.k[2] * 0x94d049bb133111ebULL;
+		return (size_t)(h ^ (h >> 32));
+	}
+};
+
+weld_key makeWeldKey(const carve::geom3d::Vector& v, double tolerance)
+{
+	weld_key key;
+	for (unsigned i = 0; i < 3; ++i)
+	{
+		if (tolerance > 0.0)
+		{
+			key.k[i] = (uint64_t)(int64_t)std::floor(v.v[i] / tolerance);
+		}
+		else
+		{
+			// +0.0 + -0.0 == +0.0, so both zeros map to the same key.
+			double d = v.v[i] + 0.0;
+			std::memcpy(&key.k[i], &d, sizeof(d));
+		}
+	}
+	return key;
+}
+
+// Bucket the indices [0, n) by part[i] < n_part with a parallel
+// counting sort: each chunk counts its indices per partition, and then
+// writes them to their slots. order holds the indices of partition p
+// at [part_begin[p], part_begin[p + 1]), in increasing order.
+void bucketByPartition(const std::vector<size_t>& part, size_t n_part,
+		std::vector<size_t>& order, std::vector<size_t>& part_begin)
+{
+	const size_t n = part.size();
+	const size_t n_chunks = carve::parallel::chunkCount(n, 65536);
+	std::vector<size_t> next(n_chunks * n_part, 0);
+	carve::parallel::for_chunks(0, n, 65536, [&](size_t lo, size_t hi, size_t c) {
+		for (size_t i = lo; i < hi; ++i)
+		{
+			++next[c * n_part + part[i]];
+		}
+	});
+
+	part_begin.resize(n_part + 1);
+	size_t total = 0;
+	for (size_t p = 0; p < n_part; ++p)
+	{
+		part_begin[p] = total;
+		for (size_t c = 0; c < n_chunks; ++c)
+		{
+			const size_t count = next[c * n_part + p];
+			next[c * n_part + p] = total;
+			total += count;
+		}
+	}
+	part_begin[n_part] = total;
+
+	order.resize(n);
+	carve::parallel::for_chunks(0, n, 65536, [&](size_t lo, size_t hi, size_t c) {
+		size_t* slot = &next[c * n_part];
+		for (size_t i = lo; i < hi; ++i)
+		{
+			order[slot[part[i]]++] = i;
+		}
+	});
+}
+
+// Merge coincident points of a triangle soup (three consecutive
+// points per triangle) into shared vertices. Points are bucketed once
+// by a hash of their coordinates, and each bucket is deduplicated by
+// its own thread. With a positive tolerance, the distinct points are
+// then compared with every point in the 27 grid cells (of size
+// tolerance) around them, and points within tolerance of each other
+// are merged, transitively. The result does not depend on the number
+// of threads: vertices are numbered in order of first occurrence.
+void weldVertices(const std::vector<carve::geom3d::Vector>& raw,
+		double tolerance, std::vector<carve::geom3d::Vector>& points,
+		std::vector<size_t>& index)
+{
+	using cell_map_t = std::unordered_map<weld_key, size_t, hash_weld_key>;
+	const size_t N = raw.size();
+	const size_t n_part = std::max<size_t>(1, carve::parallel::chunkCount(N, 65536));
+
+	std::vector<weld_key> keys(N);
+	std::vector<size_t> part(N);
+	carve::parallel::for_each_index(0, N, 4096, [&](size_t i) {
+		keys[i] = makeWeldKey(raw[i], 0.0);
+		part[i] = hash_weld_key()(keys[i]) % n_part;
+	});
+
+	std::vector<size_t> order, part_begin;
+	bucketByPartition(part, n_part, order, part_begin);
+
+	// rep[i] is the first point identical to point i.
+	std::vector<size_t> rep(N);
+	carve::parallel::for_chunks(0, n_part, 1, [&](size_t lo, size_t hi, size_t) {
+		for (size_t p = lo; p < hi; ++p)
+		{
+			cell_map_t cell;
+			cell.reserve(part_begin[p + 1] - part_begin[p]);
+			for (size_t k = part_begin[p]; k < part_begin[p + 1]; ++k)
+			{
+				const size_t i = order[k];
+				rep[i] = cell.insert(std::make_pair(keys[i], i)).first->second;
+			}
+		}
+	});
+
+	std::vector<size_t> point_id(N);
+	points.clear();
+	for (size_t i = 0; i < N; ++i)
+	{
+		if (rep[i] == i)
+		{
+			point_id[i] = points.size();
+			points.push_back(raw[i]);
+		}
+	}
+
+	if (tolerance > 0.0 && !points.empty())
+	{
+		using grid_map_t = std::unordered_map<weld_key, std::vector<size_t>, hash_weld_key>;
+		const size_t M = points.size();
+
+		// the distinct points of each grid cell, in increasing order.
+		std::vector<weld_key> cell_keys(M);
+		std::vector<size_t> cell_part(M);
+		carve::parallel::for_each_index(0, M, 4096, [&](size_t i) {
+			cell_keys[i] = makeWeldKey(points[i], tolerance);
+			cell_part[i] = hash_weld_key()(cell_keys[i]) % n_part;
+		});
+		bucketByPartition(cell_part, n_part, order, part_begin);
+
+		std::vector<grid_map_t> grid(n_part);
+		carve::parallel::for_chunks(0, n_part, 1, [&](size_t lo, size_t hi, size_t) {
+			for (size_t p = lo; p < hi; ++p)
+			{
+				for (size_t k = part_begin[p]; k < part_begin[p + 1]; ++k)
+				{
+					grid[p][cell_keys[order[k]]].push_back(order[k]);
+				}
+			}
+		});
+
+		// points within tolerance of each other are at most one cell
+		// apart on each axis.
+		const size_t n_chunks = carve::parallel::chunkCount(M, 4096);
+		std::vector<std::vector<std::pair<size_t, size_t>>> merges(n_chunks);
+		const double tol2 = tolerance * tolerance;
+
+		carve::parallel::for_chunks(0, M, 4096, [&](size_t lo, size_t hi, size_t c) {
+			for (size_t i = lo; i < hi; ++i)
+			{
+				for (int dx = -1; dx <= 1; ++dx)
+				{
+					for (int dy = -1; dy <= 1; ++dy)
+					{
+						for (int dz = -1; dz <= 1; ++dz)
+						{
+							weld_key k = cell_keys[i];
+							k.k[0] += (uint64_t)(int64_t)dx;
+							k.k[1] += (uint64_t)(int64_t)dy;
+							k.k[2] += (uint64_t)(int64_t)dz;
+							const grid_map_t& cells = grid[hash_weld_key()(k) % n_part];
+							grid_map_t::const_iterator cell = cells.find(k);
+							if (cell == cells.end())
+							{
+								continue;
+							}
+							const std::vector<size_t>& in_cell = (*cell).second;
+							for (size_t j = 0; j < in_cell.size() && in_cell[j] < i; ++j)
+							{
+								if ((points[i] - points[in_cell[j]]).length2() <= tol2)
+								{
+									merges[c].push_back(std::make_pair(i, in_cell[j]));
+								}
+							}
+						}
+					}
+				}
+			}
+		});
+
+		carve::djset::djset groups(M);
+		for (size_t c = 0; c < merges.size(); ++c)
+		{
+			for (size_t m = 0; m < merges[c].size(); ++m)
+			{
+				groups.merge_sets(merges[c][m].first, merges[c][m].second);
+			}
+		}
+
+		if (groups.count() != M)
+		{
+			std::vector<size_t> group_id, group_size;
+			groups.get_index_to_set(group_id, group_size);
+			std::vector<carve::geom3d::Vector> merged(groups.count());
+			for (size_t i = M; i > 0; --i)
+			{
+				merged[group_id[i - 1]] = points[i - 1];
+			}
+			for (size_t i = 0; i < N; ++i)
+			{
+				if (rep[i] == i)
+				{
+					point_id[i] = group_id[point_id[i]];
+				}
+			}
+			points.swap(merged);
+		}
+	}
+
+	index.resize(N);
+	carve::parallel::for_each_index(0, N, 4096, [&](size_t i) {
+		index[i] = point_id[rep[i]];
+	});
+}
+
+uint32_t readLE32(const char* p)
+{
+	const unsigned char* u = (const unsigned char*)p;
+	return (uint32_t)u[0] | ((uint32_t)u[1] << 8) | ((uint32_t)u[2] << 16) |
+			((uint32_t)u[3] << 24);
+}
+
+float readLEFloat(const char* p)
+{
+	uint32_t bits = readLE32(p);
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
+
+bool readSTLBinary(const std::string& buf,
+		std::vector<carve::geom3d::Vector>& raw)
+{
+	if (buf.size() < 84)
+	{
+		return false;
+	}
+	const size_t n_tri = readLE32(buf.data() + 80);
+	if (buf.size() < 84 + n_tri * 50)
+	{
+		std::cerr << "STL: truncated binary file (" << n_tri << " triangles expected)" << std::endl;
+		return false;
+	}
+
+	raw.resize(n_tri * 3);
+	const char* base = buf.data() + 84;
+	carve::parallel::for_each_index(0, n_tri, 4096, [&](size_t t) {
+		// skip the 12 byte facet normal; it is recomputed from the vertices.
+		const char* p = base + t * 50 + 12;
+		for (size_t j = 0; j < 3; ++j, p += 12)
+		{
+			raw[t * 3 + j] = carve::geom::VECTOR(readLEFloat(p), readLEFloat(p + 4), readLEFloat(p + 8));
+		}
+	});
+	return true;
+}
+
+bool readSTLAscii(const std::string& buf,
+		std::vector<carve::geom3d::Vector>& raw)
+{
+	std::istringstream in(buf);
+	std::string tok;
+	size_t n_in_facet = 0;
+	raw.clear();
+
+	while (in >> tok)
+	{
+		if (tok == "vertex")
+		{
+			carve::geom3d::Vector v;
+			if (!(in >> v.x >> v.y >> v.z))
+			{
+				std::cerr << "STL: bad vertex" << std::endl;
+				return false;
+			}
+			raw.push_back(v);
+			++n_in_facet;
+		}
+		else if (tok == "endfacet")
+		{
+			if (n_in_facet != 3)
+			{
+				std::cerr << "STL: facet with " << n_in_facet << " vertices" << std::endl;
+				return false;
+			}
+			n_in_facet = 0;
+		}
+	}
+	return n_in_facet == 0;
+}
+
+// Read an ascii or binary STL stream into a welded vertex list and
+// a list of vertex indices (three per triangle). Triangles that
+// collapse as a result of welding are dropped.
+bool readSTLData(std::istream& in, double weld_tolerance,
+		std::vector<carve::geom3d::Vector>& points, std::vector<int>& tri_idx)
+{
+	std::string buf((std::istreambuf_iterator<char>(in)),
+			std::istreambuf_iterator<char>());
+	std::vector<carve::geom3d::Vector> raw;
+
+	// binary files may also start with "solid", so prefer binary if
+	// the size of the file matches the triangle count.
+	bool binary = buf.compare(0, 5, "solid") != 0 ||
+			(buf.size() >= 84 && buf.size() == 84 + (size_t)readLE32(buf.data() + 80) * 50);
+
+	if (!(binary ? readSTLBinary(buf, raw) : readSTLAscii(buf, raw)))
+	{
+		return false;
+	}
+	buf.clear();
+	buf.shrink_to_fit();
+
+	std::vector<size_t> index;
+	weldVertices(raw, weld_tolerance, points, index);
+
+	tri_idx.clear();
+	tri_idx.reserve(index.size());
+	for (size_t i = 0; i + 2 < index.size(); i += 3)
+	{
+		size_t a = index[i], b = index[i + 1], c = index[i + 2];
+		if (a == b || b == c || c == a)
+		{
+			continue;
+		}
+		tri_idx.push_back((int)a);
+		tri_idx.push_back((int)b);
+		tri_idx.push_back((int)c);
+	}
+	return true;
+}
+} // namespace
+
 template<typename filetype_t>
 bool readFile(std::istream& in, carve::input::Input& inputs,
-		const carve::math::Matrix& transform)
+		const carve::math::Matrix& transform, bool streaming = false)
 {
 	filetype_t f;
 
-	modelSetup(inputs, f);
+	modelSetup(inputs, f, streaming);
 	if (!f.read(in))
 	{
 		return false;
@@ -344,7 +753,7 @@ bool readFile(std::istream& in, carve::mesh::MeshSet<3>*& result,
 {
 	carve::input::Input inputs;
 	result = nullptr;
-	if (!readFile<filetype_t>(in, inputs, transform))
+	if (!readFile<filetype_t>(in, inputs, transform, true))
 	{
 		return false;
 	}
@@ -549,3 +958,344 @@ carve::mesh::MeshSet<3>* readVTKasMesh(const std::string& in_file,
 	}
 	return result;
 }
+
+bool readSTL(std::istream& in, carve::input::Input& result,
+		const carve::math::Matrix& transform, double weld_tolerance)
+{
+	std::vector<carve::geom3d::Vector> points;
+	std::vector<int> tri_idx;
+	if (!readSTLData(in, weld_tolerance, points, tri_idx))
+	{
+		return false;
+	}
+
+	carve::input::PolyhedronData* data = new carve::input::PolyhedronData();
+	data->points.swap(points);
+	data->reserveFaces(tri_idx.size() / 3, 3);
+	for (size_t i = 0; i < tri_idx.size(); i += 3)
+	{
+		data->addFace(tri_idx[i], tri_idx[i + 1], tri_idx[i + 2]);
+	}
+	result.addDataBlock(data);
+	result.transform(transform);
+	return true;
+}
+
+bool readSTL(const std::string& in_file, carve::input::Input& result,
+		const carve::math::Matrix& transform, double weld_tolerance)
+{
+	std::ifstream in(in_file.c_str(), std::ios_base::binary | std::ios_base::in);
+
+	if (!in.is_open())
+	{
+		std::cerr << "File '" << in_file << "' could not be opened." << std::endl;
+		return false;
+	}
+
+	std::cerr << "Loading '" << in_file << "'" << std::endl;
+	return readSTL(in, result, transform, weld_tolerance);
+}
+
+carve::mesh::MeshSet<3>* readSTLasMesh(std::istream& in,
+		const carve::math::Matrix& transform, double weld_tolerance)
+{
+	std::vector<carve::geom3d::Vector> points;
+	std::vector<int> tri_idx;
+	if (!readSTLData(in, weld_tolerance, points, tri_idx))
+	{
+		return nullptr;
+	}
+
+	if (transform != carve::math::Matrix::IDENT())
+	{
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			points[i] *= transform;
+		}
+	}
+
+	// build the mesh directly, without an intermediate
+	// carve::input::PolyhedronData.
+	carve::input::StreamingPolyhedronData data;
+	data.reserveVertices((int)points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		data.addVertex(points[i]);
+	}
+	std::vector<carve::geom3d::Vector>().swap(points);
+
+	data.reserveFaces((int)(tri_idx.size() / 3), 3);
+	for (size_t i = 0; i < tri_idx.size(); i += 3)
+	{
+		data.addFace(tri_idx[i], tri_idx[i + 1], tri_idx[i + 2]);
+	}
+	std::vector<int>().swap(tri_idx);
+
+	return data.createMesh(carve::input::opts());
+}
+
+carve::mesh::MeshSet<3>* readSTLasMesh(const std::string& in_file,
+		const carve::math::Matrix& transform, double weld_tolerance)
+{
+	std::ifstream in(in_file.c_str(), std::ios_base::binary | std::ios_base::in);
+
+	if (!in.is_open())
+	{
+		std::cerr << "File '" << in_file << "' could not be opened." << std::endl;
+		return nullptr;
+	}
+
+	std::cerr << "Loading '" << in_file << "'" << std::endl;
+	return readSTLasMesh(in, transform, weld_tolerance);
+}
+
+namespace {
+// Reserve count records of rec_size bytes at offset, if they fit in
+// the size bytes of the image; at is set to their offset.
+bool takeSection(uint64_t count, size_t rec_size, size_t size,
+		size_t& offset, size_t& at)
+{
+	if (offset > size || count > (size - offset) / rec_size)
+	{
+		return false;
+	}
+	at = offset;
+	offset += (size_t)count * rec_size;
+	return true;
+}
+
+// Rebuild a MeshSet from a carve binary image (see carve_binary.hpp).
+// All indices are validated before any allocation, after which the
+// half-edge structure is recreated directly: no face stitching,
+// plane fitting or orientation calculation is performed.
+carve::mesh::MeshSet<3>* meshFromCarveBinary(const char* data, size_t size)
+{
+	using meshset_t = carve::mesh::MeshSet<3>;
+	using namespace carve_binary;
+
+	if (size < sizeof(header))
+	{
+		std::cerr << "cmesh: truncated header" << std::endl;
+		return nullptr;
+	}
+	const header* hdr = (const header*)data;
+	if (std::memcmp(hdr->magic, MAGIC, sizeof(MAGIC)) != 0 || hdr->version != VERSION)
+	{
+		std::cerr << "cmesh: not a carve binary mesh, or unsupported version" << std::endl;
+		return nullptr;
+	}
+	if (hdr->byte_order != ENDIAN_MARK)
+	{
+		std::cerr << "cmesh: file was written with a different byte order" << std::endl;
+		return nullptr;
+	}
+
+	size_t offset = sizeof(header);
+	size_t verts_at, meshes_at, faces_at, edges_at;
+	if (!takeSection(hdr->n_vertices, 3 * sizeof(double), size, offset, verts_at) ||
+			!takeSection(hdr->n_meshes, sizeof(mesh_rec), size, offset, meshes_at) ||
+			!takeSection(hdr->n_faces, sizeof(face_rec), size, offset, faces_at) ||
+			!takeSection(hdr->n_edges, sizeof(edge_rec), size, offset, edges_at))
+	{
+		std::cerr << "cmesh: truncated file" << std::endl;
+		return nullptr;
+	}
+	const double* verts = (const double*)(data + verts_at);
+	const mesh_rec* meshes = (const mesh_rec*)(data + meshes_at);
+	const face_rec* faces = (const face_rec*)(data + faces_at);
+	const edge_rec* edges = (const edge_rec*)(data + edges_at);
+	const uint64_t* edge_lists = (const uint64_t*)(data + offset);
+
+	// every term is checked against what is left, so the sums cannot
+	// wrap around.
+	const uint64_t max_lists = (size - offset) / sizeof(uint64_t);
+	uint64_t n_faces = 0, n_lists = 0;
+	for (uint64_t m = 0; m < hdr->n_meshes; ++m)
+	{
+		if (meshes[m].n_faces > hdr->n_faces - n_faces ||
+				meshes[m].n_open > max_lists - n_lists ||
+				meshes[m].n_closed > max_lists - n_lists - meshes[m].n_open)
+		{
+			std::cerr << "cmesh: inconsistent mesh table" << std::endl;
+			return nullptr;
+		}
+		n_faces += meshes[m].n_faces;
+		n_lists += meshes[m].n_open + meshes[m].n_closed;
+	}
+	if (n_faces != hdr->n_faces)
+	{
+		std::cerr << "cmesh: inconsistent mesh table" << std::endl;
+		return nullptr;
+	}
+
+	std::vector<uint64_t> first_edge(hdr->n_faces + 1, 0);
+	for (uint64_t f = 0; f < hdr->n_faces; ++f)
+	{
+		if (faces[f].n_edges < 3 || faces[f].n_edges > hdr->n_edges - first_edge[f])
+		{
+			std::cerr << "cmesh: bad face record" << std::endl;
+			return nullptr;
+		}
+		first_edge[f + 1] = first_edge[f] + faces[f].n_edges;
+	}
+	if (first_edge.back() != hdr->n_edges)
+	{
+		std::cerr << "cmesh: inconsistent face table" << std::endl;
+		return nullptr;
+	}
+	for (uint64_t e = 0; e < hdr->n_edges; ++e)
+	{
+		if (edges[e].vert >= hdr->n_vertices ||
+				(edges[e].rev != NONE && edges[e].rev >= hdr->n_edges))
+		{
+			std::cerr << "cmesh: bad edge record" << std::endl;
+			return nullptr;
+		}
+	}
+
+	// the mesh is not stitched, so rev links must pair up edges that
+	// join the same two vertices in opposite directions.
+	std::vector<uint64_t> next(hdr->n_edges);
+	for (uint64_t f = 0; f < hdr->n_faces; ++f)
+	{
+		for (uint64_t e = first_edge[f]; e < first_edge[f + 1]; ++e)
+		{
+			next[e] = e + 1 == first_edge[f + 1] ? first_edge[f] : e + 1;
+		}
+	}
+	for (uint64_t e = 0; e < hdr->n_edges; ++e)
+	{
+		const uint64_t r = edges[e].rev;
+		if (r != NONE &&
+				(r == e || edges[r].rev != e || edges[r].vert != edges[next[e]].vert ||
+						edges[next[r]].vert != edges[e].vert))
+		{
+			std::cerr << "cmesh: bad edge pairing" << std::endl;
+			return nullptr;
+		}
+	}
+	for (uint64_t i = 0; i < n_lists; ++i)
+	{
+		if (edge_lists[i] >= hdr->n_edges)
+		{
+			std::cerr << "cmesh: bad edge list" << std::endl;
+			return nullptr;
+		}
+	}
+
+	std::vector<meshset_t::vertex_t> vertex_storage(hdr->n_vertices);
+	carve::parallel::for_each_index(0, hdr->n_vertices, 16384, [&](size_t v) {
+		vertex_storage[v].v = carve::geom::VECTOR(verts[v * 3], verts[v * 3 + 1], verts[v * 3 + 2]);
+	});
+
+	std::vector<meshset_t::edge_t*> edge_ptr(hdr->n_edges);
+	std::vector<meshset_t::face_t*> face_ptr(hdr->n_faces);
+	meshset_t::vertex_t* vbase = vertex_storage.data();
+
+	carve::parallel::for_each_index(0, hdr->n_faces, 4096, [&](size_t f) {
+		const uint64_t beg = first_edge[f], end = first_edge[f + 1];
+		for (uint64_t e = beg; e < end; ++e)
+		{
+			edge_ptr[e] = new meshset_t::edge_t(vbase + edges[e].vert, nullptr);
+		}
+		for (uint64_t e = beg; e < end; ++e)
+		{
+			edge_ptr[e]->next = edge_ptr[e + 1 == end ? beg : e + 1];
+			edge_ptr[e]->prev = edge_ptr[e == beg ? end - 1 : e - 1];
+		}
+		carve::geom::plane<3> plane;
+		plane.N = carve::geom::VECTOR(faces[f].N[0], faces[f].N[1], faces[f].N[2]);
+		plane.d = faces[f].d;
+		face_ptr[f] = new meshset_t::face_t(edge_ptr[beg], plane);
+		face_ptr[f]->id = faces[f].id;
+	});
+
+	carve::parallel::for_each_index(0, hdr->n_edges, 16384, [&](size_t e) {
+		if (edges[e].rev != NONE)
+		{
+			edge_ptr[e]->rev = edge_ptr[edges[e].rev];
+		}
+	});
+
+	std::vector<meshset_t::mesh_t*> mesh_ptr;
+	mesh_ptr.reserve(hdr->n_meshes);
+	uint64_t f = 0, l = 0;
+	for (uint64_t m = 0; m < hdr->n_meshes; ++m)
+	{
+		std::vector<meshset_t::face_t*> m_faces(face_ptr.begin() + f,
+				face_ptr.begin() + f + meshes[m].n_faces);
+		f += meshes[m].n_faces;
+
+		std::vector<meshset_t::edge_t*> m_open, m_closed;
+		m_open.reserve(meshes[m].n_open);
+		m_closed.reserve(meshes[m].n_closed);
+		for (uint64_t i = 0; i < meshes[m].n_open; ++i)
+		{
+			m_open.push_back(edge_ptr[edge_lists[l++]]);
+		}
+		for (uint64_t i = 0; i < meshes[m].n_closed; ++i)
+		{
+			m_closed.push_back(edge_ptr[edge_lists[l++]]);
+		}
+
+		mesh_ptr.push_back(new meshset_t::mesh_t(m_faces, m_open, m_closed,
+				meshes[m].is_negative != 0));
+	}
+
+	return new meshset_t(vertex_storage, mesh_ptr);
+}
+} // namespace
+
+carve::mesh::MeshSet<3>* readCarveMesh(std::istream& in)
+{
+	std::vector<uint64_t> buf;
+	std::vector<char> chunk(1 << 16);
+	size_t size = 0;
+	while (in.good())
+	{
+		in.read(chunk.data(), chunk.size());
+		const size_t n = in.gcount();
+		buf.resize((size + n + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+		std::memcpy((char*)buf.data() + size, chunk.data(), n);
+		size += n;
+	}
+	return meshFromCarveBinary((const char*)buf.data(), size);
+}
+
+carve::mesh::MeshSet<3>* readCarveMesh(const std::string& in_file)
+{
+#ifndef WIN32
+	int fd = open(in_file.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		std::cerr << "File '" << in_file << "' could not be opened." << std::endl;
+		return nullptr;
+	}
+
+	std::cerr << "Loading '" << in_file << "'" << std::endl;
+	struct stat st;
+	carve::mesh::MeshSet<3>* result = nullptr;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED)
+		{
+			result = meshFromCarveBinary((const char*)data, (size_t)st.st_size);
+			munmap(data, (size_t)st.st_size);
+		}
+	}
+	close(fd);
+	return result;
+#else
+	std::ifstream in(in_file.c_str(), std::ios_base::binary | std::ios_base::in);
+
+	if (!in.is_open())
+	{
+		std::cerr << "File '" << in_file << "' could not be opened." << std::endl;
+		return nullptr;
+	}
+
+	std::cerr << "Loading '" << in_file << "'" << std::endl;
+	return readCarveMesh(in);
+#endif
+}
@@ -106,3 +106,32 @@ CARVE_IO_API carve::mesh::MeshSet<3>* readVTKasMesh(
 CARVE_IO_API carve::mesh::MeshSet<3>* readVTKasMesh(
 		const std::string& in_file,
 		const carve::math::Matrix& transform = carve::math::Matrix::IDENT());
+
+// STL input. Triangles are welded into shared vertices: with a
+// weld_tolerance of 0 only identical points are merged, otherwise
+// points closer than weld_tolerance are merged as well.
+CARVE_IO_API bool readSTL(
+		std::istream& in, carve::input::Input& result,
+		const carve::math::Matrix& transform = carve::math::Matrix::IDENT(),
+		double weld_tolerance = 0.0);
+
+CARVE_IO_API bool readSTL(
+		const std::string& in_file, carve::input::Input& result,
+		const carve::math::Matrix& transform = carve::math::Matrix::IDENT(),
+		double weld_tolerance = 0.0);
+
+CARVE_IO_API carve::mesh::MeshSet<3>* readSTLasMesh(
+		std::istream& in,
+		const carve::math::Matrix& transform = carve::math::Matrix::IDENT(),
+		double weld_tolerance = 0.0);
+
+CARVE_IO_API carve::mesh::MeshSet<3>* readSTLasMesh(
+		const std::string& in_file,
+		const carve::math::Matrix& transform = carve::math::Matrix::IDENT(),
+		double weld_tolerance = 0.0);
+
+// Carve native binary input (.cmesh), as written by writeCarveMesh().
+// On POSIX systems the file is memory mapped.
+CARVE_IO_API carve::mesh::MeshSet<3>* readCarveMesh(std::istream& in);
+
+CARVE_IO_API carve::mesh::MeshSet<3>* readCarveMesh(const std::string& in_file);
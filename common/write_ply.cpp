@@ -23,6 +23,9 @@
 // SOFTWARE.
 
 #include "write_ply.hpp"
+#include "carve_binary.hpp"
+
+#include <carve/triangulator.hpp>
 
 #include <gloop/model/obj_format.hpp>
 #include <gloop/model/ply_format.hpp>
@@ -30,7 +33,9 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iomanip>
+#include <unordered_map>
 
 #ifndef WIN32
 #	include <cstdint>
@@ -294,6 +299,58 @@ void setup(gloop::stream::model_writer& file,
 	file.addWriter("pointset.vertex.y", new vertex_component<1>(*vi));
 	file.addWriter("pointset.vertex.z", new vertex_component<2>(*vi));
 }
+
+// Split a face into triangles for STL output. Triangles are
+// returned as vertex triples; non-convex faces are handled by
+// triangulating their 2d projection.
+void triangulateForSTL(const carve::mesh::MeshSet<3>::face_t* face,
+		std::vector<const carve::mesh::MeshSet<3>::vertex_t*>& tris)
+{
+	using vertex_t = carve::mesh::MeshSet<3>::vertex_t;
+	tris.clear();
+	if (face->nVertices() == 3)
+	{
+		const carve::mesh::MeshSet<3>::edge_t* e = face->edge;
+		tris.push_back(e->vert);
+		tris.push_back(e->next->vert);
+		tris.push_back(e->next->next->vert);
+		return;
+	}
+
+	std::vector<const vertex_t*> verts;
+	std::vector<carve::geom2d::P2> projected;
+	for (carve::mesh::MeshSet<3>::face_t::const_edge_iter_t i = face->begin();
+			 i != face->end(); ++i)
+	{
+		verts.push_back((*i).vert);
+		projected.push_back(face->project((*i).vert->v));
+	}
+
+	std::vector<carve::triangulate::tri_idx> result;
+	carve::triangulate::triangulate(projected, result);
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		tris.push_back(verts[result[i].a]);
+		tris.push_back(verts[result[i].b]);
+		tris.push_back(verts[result[i].c]);
+	}
+}
+
+void writeLE32(char* p, uint32_t v)
+{
+	p[0] = (char)(v & 0xff);
+	p[1] = (char)((v >> 8) & 0xff);
+	p[2] = (char)((v >> 16) & 0xff);
+	p[3] = (char)((v >> 24) & 0xff);
+}
+
+void writeLEFloat(char* p, double v)
+{
+	float f = (float)v;
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(f));
+	writeLE32(p, bits);
+}
 } // namespace
 
 void writePLY(std::ostream& out, const carve::mesh::MeshSet<3>* poly,
@@ -507,3 +564,194 @@ void writeVTK(const std::string& out_file,
 	}
 	writeVTK(out, lines);
 }
+
+void writeSTL(std::ostream& out, const carve::mesh::MeshSet<3>* poly,
+		bool ascii)
+{
+	std::vector<const carve::mesh::MeshSet<3>::vertex_t*> tris;
+
+	if (ascii)
+	{
+		out << std::setprecision(17);
+		out << "solid carve" << std::endl;
+		for (carve::mesh::MeshSet<3>::const_face_iter i = poly->faceBegin();
+				 i != poly->faceEnd(); ++i)
+		{
+			const carve::geom3d::Vector& N = (*i)->plane.N;
+			triangulateForSTL(*i, tris);
+			for (size_t t = 0; t < tris.size(); t += 3)
+			{
+				out << "facet normal " << N.x << " " << N.y << " " << N.z << std::endl;
+				out << "  outer loop" << std::endl;
+				for (size_t j = 0; j < 3; ++j)
+				{
+					const carve::geom3d::Vector& v = tris[t + j]->v;
+					out << "    vertex " << v.x << " " << v.y << " " << v.z << std::endl;
+				}
+				out << "  endloop" << std::endl;
+				out << "endfacet" << std::endl;
+			}
+		}
+		out << "endsolid carve" << std::endl;
+		return;
+	}
+
+	std::vector<char> body;
+	uint32_t n_tri = 0;
+	for (carve::mesh::MeshSet<3>::const_face_iter i = poly->faceBegin();
+			 i != poly->faceEnd(); ++i)
+	{
+		const carve::geom3d::Vector& N = (*i)->plane.N;
+		triangulateForSTL(*i, tris);
+		for (size_t t = 0; t < tris.size(); t += 3)
+		{
+			char rec[50] = {0};
+			for (size_t k = 0; k < 3; ++k)
+			{
+				writeLEFloat(rec + k * 4, N.v[k]);
+			}
+			for (size_t j = 0; j < 3; ++j)
+			{
+				for (size_t k = 0; k < 3; ++k)
+				{
+					writeLEFloat(rec + 12 + j * 12 + k * 4, tris[t + j]->v.v[k]);
+				}
+			}
+			body.insert(body.end(), rec, rec + sizeof(rec));
+			++n_tri;
+		}
+	}
+
+	char header[84] = {0};
+	std::strncpy(header, "carve binary STL", 80);
+	writeLE32(header + 80, n_tri);
+	out.write(header, sizeof(header));
+	if (!body.empty())
+	{
+		out.write(&body[0], body.size());
+	}
+}
+
+void writeSTL(const std::string& out_file, const carve::mesh::MeshSet<3>* poly,
+		bool ascii)
+{
+	std::ofstream out(out_file.c_str(), std::ios_base::binary);
+	if (!out.is_open())
+	{
+		std::cerr << "File '" << out_file << "' could not be opened." << std::endl;
+		return;
+	}
+	writeSTL(out, poly, ascii);
+}
+
+void writeCarveMesh(std::ostream& out, const carve::mesh::MeshSet<3>* poly)
+{
+	using meshset_t = carve::mesh::MeshSet<3>;
+
+	carve_binary::header hdr;
+	std::memcpy(hdr.magic, carve_binary::MAGIC, sizeof(hdr.magic));
+	hdr.version = carve_binary::VERSION;
+	hdr.byte_order = carve_binary::ENDIAN_MARK;
+	hdr.n_vertices = poly->vertex_storage.size();
+	hdr.n_meshes = poly->meshes.size();
+	hdr.n_faces = 0;
+	hdr.n_edges = 0;
+
+	std::unordered_map<const meshset_t::edge_t*, uint64_t> edge_idx;
+	std::vector<carve_binary::mesh_rec> meshes(poly->meshes.size());
+	for (size_t m = 0; m < poly->meshes.size(); ++m)
+	{
+		const meshset_t::mesh_t* mesh = poly->meshes[m];
+		meshes[m].n_faces = mesh->faces.size();
+		meshes[m].n_open = mesh->open_edges.size();
+		meshes[m].n_closed = mesh->closed_edges.size();
+		meshes[m].is_negative = mesh->is_negative ? 1 : 0;
+		hdr.n_faces += mesh->faces.size();
+		for (size_t f = 0; f < mesh->faces.size(); ++f)
+		{
+			hdr.n_edges += mesh->faces[f]->n_edges;
+		}
+	}
+	edge_idx.reserve(hdr.n_edges);
+
+	std::vector<carve_binary::face_rec> faces;
+	faces.reserve(hdr.n_faces);
+	for (meshset_t::const_face_iter i = poly->faceBegin(); i != poly->faceEnd(); ++i)
+	{
+		const meshset_t::face_t* face = *i;
+		carve_binary::face_rec rec;
+		rec.n_edges = face->n_edges;
+		rec.id = face->id;
+		for (unsigned k = 0; k < 3; ++k)
+		{
+			rec.N[k] = face->plane.N.v[k];
+		}
+		rec.d = face->plane.d;
+		faces.push_back(rec);
+
+		const meshset_t::edge_t* e = face->edge;
+		do
+		{
+			const uint64_t idx = edge_idx.size();
+			edge_idx[e] = idx;
+			e = e->next;
+		} while (e != face->edge);
+	}
+
+	const meshset_t::vertex_t* vbase = poly->vertex_storage.data();
+	std::vector<carve_binary::edge_rec> edges;
+	edges.reserve(hdr.n_edges);
+	for (meshset_t::const_face_iter i = poly->faceBegin(); i != poly->faceEnd(); ++i)
+	{
+		const meshset_t::edge_t* e = (*i)->edge;
+		do
+		{
+			carve_binary::edge_rec rec;
+			CARVE_ASSERT(e->vert >= vbase && e->vert < vbase + hdr.n_vertices);
+			rec.vert = (uint64_t)(e->vert - vbase);
+			rec.rev = e->rev ? edge_idx[e->rev] : carve_binary::NONE;
+			edges.push_back(rec);
+			e = e->next;
+		} while (e != (*i)->edge);
+	}
+
+	std::vector<uint64_t> edge_lists;
+	for (size_t m = 0; m < poly->meshes.size(); ++m)
+	{
+		const meshset_t::mesh_t* mesh = poly->meshes[m];
+		for (size_t j = 0; j < mesh->open_edges.size(); ++j)
+		{
+			edge_lists.push_back(edge_idx[mesh->open_edges[j]]);
+		}
+		for (size_t j = 0; j < mesh->closed_edges.size(); ++j)
+		{
+			edge_lists.push_back(edge_idx[mesh->closed_edges[j]]);
+		}
+	}
+
+	std::vector<double> verts;
+	verts.reserve(hdr.n_vertices * 3);
+	for (size_t v = 0; v < poly->vertex_storage.size(); ++v)
+	{
+		verts.insert(verts.end(), poly->vertex_storage[v].v.v, poly->vertex_storage[v].v.v + 3);
+	}
+
+	out.write((const char*)&hdr, sizeof(hdr));
+	out.write((const char*)verts.data(), verts.size() * sizeof(double));
+	out.write((const char*)meshes.data(), meshes.size() * sizeof(carve_binary::mesh_rec));
+	out.write((const char*)faces.data(), faces.size() * sizeof(carve_binary::face_rec));
+	out.write((const char*)edges.data(), edges.size() * sizeof(carve_binary::edge_rec));
+	out.write((const char*)edge_lists.data(), edge_lists.size() * sizeof(uint64_t));
+}
+
+void writeCarveMesh(const std::string& out_file,
+		const carve::mesh::MeshSet<3>* poly)
+{
+	std::ofstream out(out_file.c_str(), std::ios_base::binary);
+	if (!out.is_open())
+	{
+		std::cerr << "File '" << out_file << "' could not be opened." << std::endl;
+		return;
+	}
+	writeCarveMesh(out, poly);
+}
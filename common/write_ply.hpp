@@ -74,3 +74,15 @@ CARVE_IO_API void writeVTK(const std::string& out_file, const carve::poly::Polyh
 CARVE_IO_API void writeVTK(std::ostream& out, const carve::line::PolylineSet* lines);
 CARVE_IO_API void writeVTK(const std::string& out_file,
 		const carve::line::PolylineSet* lines);
+
+// STL output. Non-triangular faces are triangulated.
+CARVE_IO_API void writeSTL(std::ostream& out, const carve::mesh::MeshSet<3>* poly,
+		bool ascii = false);
+CARVE_IO_API void writeSTL(const std::string& out_file, const carve::mesh::MeshSet<3>* poly,
+		bool ascii = false);
+
+// Carve native binary output (.cmesh). Stores the complete half-edge
+// structure, so that readCarveMesh() can rebuild the MeshSet without
+// stitching faces or refitting planes.
+CARVE_IO_API void writeCarveMesh(std::ostream& out, const carve::mesh::MeshSet<3>* poly);
+CARVE_IO_API void writeCarveMesh(const std::string& out_file, const carve::mesh::MeshSet<3>* poly);
@@ -0,0 +1,377 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/aabb.hpp>
+#include <carve/geom.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace carve {
+namespace geom {
+
+// A binary bounding volume hierarchy over objects that can move, be
+// added and be removed. Unlike RTreeNode, which is built once, the
+// hierarchy is maintained locally: inserting an object descends to
+// the sibling that grows least, removing one splices out its leaf,
+// and updating one refits the boxes of its ancestors, stopping as soon
+// as a box is unchanged. Nodes are kept in a pool, indexed by number.
+template<unsigned ndim, typename data_t,
+		typename aabb_calc_t = carve::geom::get_aabb<ndim, data_t>>
+class DynamicBVH
+{
+public:
+	using aabb_t = aabb<ndim>;
+
+	DynamicBVH() = default;
+
+	template<typename iter_t>
+	DynamicBVH(iter_t begin, iter_t end)
+	{
+		build(begin, end);
+	}
+
+	bool empty() const { return root == npos; }
+	size_t size() const { return leaves.size(); }
+
+	bool contains(const data_t& val) const
+	{
+		return leaves.find(val) != leaves.end();
+	}
+
+	void clear()
+	{
+		nodes.clear();
+		free_nodes.clear();
+		leaves.clear();
+		root = npos;
+	}
+
+	// Replace the contents with the objects in [begin, end), split top
+	// down at the median centre along the longest axis.
+	template<typename iter_t>
+	void build(iter_t begin, iter_t end)
+	{
+		clear();
+		std::vector<uint32_t> items;
+		for (iter_t i = begin; i != end; ++i)
+		{
+			items.push_back(newLeaf(*i));
+		}
+		if (!items.empty())
+		{
+			root = buildRange(items, 0, items.size());
+			nodes[root].parent = npos;
+		}
+	}
+
+	void insert(const data_t& val)
+	{
+		CARVE_ASSERT(!contains(val));
+		const uint32_t leaf = newLeaf(val);
+		if (root == npos)
+		{
+			root = leaf;
+			return;
+		}
+
+		const aabb_t& bbox = nodes[leaf].bbox;
+		uint32_t sibling = root;
+		while (!isLeaf(sibling))
+		{
+			const uint32_t c0 = nodes[sibling].child[0];
+			const uint32_t c1 = nodes[sibling].child[1];
+			const double g0 = cost(join(nodes[c0].bbox, bbox)) - cost(nodes[c0].bbox);
+			const double g1 = cost(join(nodes[c1].bbox, bbox)) - cost(nodes[c1].bbox);
+			sibling = g0 <= g1 ? c0 : c1;
+		}
+
+		const uint32_t parent = nodes[sibling].parent;
+		const uint32_t node = newNode();
+		nodes[node].parent = parent;
+		nodes[node].child[0] = sibling;
+		nodes[node].child[1] = leaf;
+		nodes[node].bbox = join(nodes[sibling].bbox, nodes[leaf].bbox);
+		nodes[sibling].parent = node;
+		nodes[leaf].parent = node;
+		if (parent == npos)
+		{
+			root = node;
+		}
+		else
+		{
+			nodes[parent].child[nodes[parent].child[0] == sibling ? 0 : 1] = node;
+			refitUp(parent);
+		}
+	}
+
+	bool remove(const data_t& val)
+	{
+		typename leaf_map_t::iterator i = leaves.find(val);
+		if (i == leaves.end())
+		{
+			return false;
+		}
+		const uint32_t leaf = (*i).second;
+		leaves.erase(i);
+
+		const uint32_t parent = nodes[leaf].parent;
+		freeNode(leaf);
+		if (parent == npos)
+		{
+			root = npos;
+			return true;
+		}
+
+		const uint32_t sibling =
+				nodes[parent].child[nodes[parent].child[0] == leaf ? 1 : 0];
+		const uint32_t grandparent = nodes[parent].parent;
+		nodes[sibling].parent = grandparent;
+		freeNode(parent);
+		if (grandparent == npos)
+		{
+			root = sibling;
+		}
+		else
+		{
+			nodes[grandparent].child[nodes[grandparent].child[0] == parent ? 0 : 1] =
+					sibling;
+			refitUp(grandparent);
+		}
+		return true;
+	}
+
+	// Recompute the box of an object that has moved or changed shape.
+	bool update(const data_t& val)
+	{
+		typename leaf_map_t::const_iterator i = leaves.find(val);
+		if (i == leaves.end())
+		{
+			return false;
+		}
+		const uint32_t leaf = (*i).second;
+		const aabb_t bbox = aabb_calc_t()(val);
+		if (bbox == nodes[leaf].bbox)
+		{
+			return true;
+		}
+		nodes[leaf].bbox = bbox;
+		if (nodes[leaf].parent != npos)
+		{
+			refitUp(nodes[leaf].parent);
+		}
+		return true;
+	}
+
+	// Recompute every box, after many objects have moved.
+	void refit()
+	{
+		if (root != npos)
+		{
+			refitSubtree(root);
+		}
+	}
+
+	// Report the objects whose boxes intersect obj (generally an aabb).
+	// The aabb class must provide a method intersects(obj_t).
+	template<typename obj_t, typename out_iter_t>
+	void search(const obj_t& obj, out_iter_t out) const
+	{
+		if (root != npos)
+		{
+			search(root, obj, out);
+		}
+	}
+
+	aabb_t getAABB() const { return root == npos ? aabb_t() : nodes[root].bbox; }
+
+private:
+	static const uint32_t npos = ~uint32_t(0);
+
+	struct node_t
+	{
+		aabb_t bbox;
+		uint32_t parent{npos};
+		uint32_t child[2]{npos, npos};
+		data_t data{};
+	};
+
+	using leaf_map_t = std::unordered_map<data_t, uint32_t>;
+
+	std::vector<node_t> nodes;
+	std::vector<uint32_t> free_nodes;
+	leaf_map_t leaves;
+	uint32_t root{npos};
+
+	bool isLeaf(uint32_t n) const { return nodes[n].child[0] == npos; }
+
+	static aabb_t join(const aabb_t& a, const aabb_t& b)
+	{
+		aabb_t r = a;
+		r.unionAABB(b);
+		return r;
+	}
+
+	// Half the surface of a box, for choosing where to insert.
+	static double cost(const aabb_t& bbox)
+	{
+		double r = 0.0;
+		for (unsigned i = 0; i < ndim; ++i)
+		{
+			r += bbox.extent.v[i];
+		}
+		return r;
+	}
+
+	uint32_t newNode()
+	{
+		uint32_t n;
+		if (free_nodes.empty())
+		{
+			n = uint32_t(nodes.size());
+			nodes.emplace_back();
+		}
+		else
+		{
+			n = free_nodes.back();
+			free_nodes.pop_back();
+			nodes[n] = node_t();
+		}
+		return n;
+	}
+
+	void freeNode(uint32_t n)
+	{
+		nodes[n].child[0] = nodes[n].child[1] = npos;
+		nodes[n].data = data_t();
+		free_nodes.push_back(n);
+	}
+
+	uint32_t newLeaf(const data_t& val)
+	{
+		const uint32_t n = newNode();
+		nodes[n].bbox = aabb_calc_t()(val);
+		nodes[n].data = val;
+		leaves[val] = n;
+		return n;
+	}
+
+	uint32_t buildRange(std::vector<uint32_t>& items, size_t begin, size_t end)
+	{
+		if (end - begin == 1)
+		{
+			return items[begin];
+		}
+
+		aabb_t centres(nodes[items[begin]].bbox.pos);
+		for (size_t i = begin + 1; i < end; ++i)
+		{
+			centres.unionAABB(aabb_t(nodes[items[i]].bbox.pos));
+		}
+		unsigned axis = 0;
+		for (unsigned i = 1; i < ndim; ++i)
+		{
+			if (centres.extent.v[i] > centres.extent.v[axis])
+			{
+				axis = i;
+			}
+		}
+
+		const size_t mid = begin + (end - begin) / 2;
+		std::nth_element(items.begin() + begin, items.begin() + mid,
+				items.begin() + end, [&](uint32_t a, uint32_t b) {
+					return nodes[a].bbox.pos.v[axis] < nodes[b].bbox.pos.v[axis];
+				});
+
+		const uint32_t c0 = buildRange(items, begin, mid);
+		const uint32_t c1 = buildRange(items, mid, end);
+		const uint32_t n = newNode();
+		nodes[n].child[0] = c0;
+		nodes[n].child[1] = c1;
+		nodes[n].bbox = join(nodes[c0].bbox, nodes[c1].bbox);
+		nodes[c0].parent = n;
+		nodes[c1].parent = n;
+		return n;
+	}
+
+	template<typename obj_t, typename out_iter_t>
+	void search(uint32_t n, const obj_t& obj, out_iter_t& out) const
+	{
+		const node_t& node = nodes[n];
+		if (!node.bbox.intersects(obj))
+		{
+			return;
+		}
+		if (node.child[0] == npos)
+		{
+			*out++ = node.data;
+		}
+		else
+		{
+			search(node.child[0], obj, out);
+			search(node.child[1], obj, out);
+		}
+	}
+
+	void refitUp(uint32_t n)
+	{
+		while (n != npos)
+		{
+			node_t& node = nodes[n];
+			const aabb_t bbox =
+					join(nodes[node.child[0]].bbox, nodes[node.child[1]].bbox);
+			if (bbox == node.bbox)
+			{
+				return;
+			}
+			node.bbox = bbox;
+			n = node.parent;
+		}
+	}
+
+	void refitSubtree(uint32_t n)
+	{
+		node_t& node = nodes[n];
+		if (node.child[0] == npos)
+		{
+			node.bbox = aabb_calc_t()(node.data);
+			return;
+		}
+		refitSubtree(node.child[0]);
+		refitSubtree(node.child[1]);
+		nodes[n].bbox =
+				join(nodes[nodes[n].child[0]].bbox, nodes[nodes[n].child[1]].bbox);
+	}
+};
+
+template<unsigned ndim, typename data_t, typename aabb_calc_t>
+const uint32_t DynamicBVH<ndim, data_t, aabb_calc_t>::npos;
+}
+} // namespace carve::geom
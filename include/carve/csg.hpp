@@ -66,6 +66,8 @@ struct Data;
 class LoopEdges;
 } // namespace detail
 
+class CSG_TreeCache;
+
 /**
  * \class CSG
  * \brief The class responsible for the computation of CSG operations.
@@ -76,6 +78,15 @@ class CARVE_API CSG
 private:
 public:
 	using meshset_t = carve::mesh::MeshSet<3>;
+	using face_rtree_t = carve::geom::RTreeNode<3, carve::mesh::Face<3>*>;
+
+	// An output face, with the face it was derived from.
+	struct OutputFace
+	{
+		meshset_t::face_t* face;
+		const meshset_t::face_t* orig_face;
+		bool flipped;
+	};
 
 	struct CARVE_API Hook
 	{
@@ -89,6 +100,10 @@ public:
 		virtual void processOutputFace(std::vector<meshset_t::face_t*>& /* faces */,
 				const meshset_t::face_t* /* orig_face */,
 				bool /* flipped */) {}
+		// Called once, before the result is assembled, with every output
+		// face in the order it was collected. Faces may be replaced, but
+		// the replacements should stay in place of the face they replace.
+		virtual void processOutputFaces(std::vector<OutputFace>& /* faces */) {}
 		virtual void resultFace(const meshset_t::face_t* /* new_face */,
 				const meshset_t::face_t* /* orig_face */,
 				bool /* flipped */) {}
@@ -113,17 +128,19 @@ public:
 			PROCESS_OUTPUT_FACE_HOOK = 1,
 			INTERSECTION_VERTEX_HOOK = 2,
 			EDGE_DIVISION_HOOK = 3,
-			HOOK_MAX = 4,
+			PROCESS_OUTPUT_FACES_HOOK = 4,
+			HOOK_MAX = 5,
 
 			RESULT_FACE_BIT = 0x0001,
 			PROCESS_OUTPUT_FACE_BIT = 0x0002,
 			INTERSECTION_VERTEX_BIT = 0x0004,
-			EDGE_DIVISION_BIT = 0x0008
+			EDGE_DIVISION_BIT = 0x0008,
+			PROCESS_OUTPUT_FACES_BIT = 0x0010
 		};
 
 		std::vector<std::list<Hook*>> hooks;
 
-		bool hasHook(unsigned hook_num);
+		bool hasHook(unsigned hook_num) const { return !hooks[hook_num].empty(); }
 
 		void intersectionVertex(const meshset_t::vertex_t* vertex,
 				const IObjPairSet& intersections);
@@ -131,6 +148,8 @@ public:
 		void processOutputFace(std::vector<meshset_t::face_t*>& faces,
 				const meshset_t::face_t* orig_face, bool flipped);
 
+		void processOutputFaces(std::vector<OutputFace>& faces);
+
 		void resultFace(const meshset_t::face_t* new_face,
 				const meshset_t::face_t* orig_face, bool flipped);
 
@@ -162,13 +181,26 @@ public:
 		virtual void collect(FaceLoopGroup* group, CSG::Hooks&) = 0;
 		virtual meshset_t* done(CSG::Hooks&) = 0;
 
+		/**
+     * \brief Returns true if shells that no intersection touches may be
+     * passed to collectShell() whole, instead of as face loop groups.
+     */
+		virtual bool acceptsShells(CSG::Hooks&) { return false; }
+
+		/**
+     * \brief Collect an untouched shell of either operand, which
+     * classifies as \a fc with respect to the other operand.
+     */
+		virtual void collectShell(const meshset_t::mesh_t* /* shell */,
+				FaceClass /* fc */, CSG::Hooks&) {}
+
 		Collector() = default;
 		virtual ~Collector() = default;
 	};
 
 private:
-	using face_rtree_t = carve::geom::RTreeNode<3, carve::mesh::Face<3>*>;
 	using face_pairs_t = std::unordered_map<carve::mesh::Face<3>*, std::vector<carve::mesh::Face<3>*>>;
+	using ShellClassification = std::vector<std::pair<const meshset_t::mesh_t*, FaceClass>>;
 
 	/// The computed intersection data.
 	Intersections intersections;
@@ -260,7 +292,23 @@ private:
 			CSG& csg, CSG::Collector& collector);
 
 	size_t generateFaceLoops(meshset_t* poly, const detail::Data& data,
-			FaceLoopList& face_loops_out);
+			FaceLoopList& face_loops_out,
+			const std::vector<bool>* skip_shells = nullptr);
+
+	/**
+   * \brief Find the shells of \a poly that no intersection touches, and
+   * classify each of them as a whole against \a other.
+   *
+   * @param[in] poly The polyhedron whose shells are examined.
+   * @param[in] other The polyhedron to classify against.
+   * @param[out] skip_shells Flags, indexed like poly->meshes, of the shells
+   * that were classified.
+   * @param[out] shells The classified shells.
+   */
+	void classifyUntouchedShells(meshset_t* poly, meshset_t* other,
+			const face_rtree_t* other_rtree,
+			std::vector<bool>& skip_shells,
+			ShellClassification& shells);
 
 	// intersect_group.cpp
 
@@ -346,7 +394,7 @@ private:
 			meshset_t* poly_b, const face_rtree_t* poly_b_rtree,
 			FLGroupList& b_loops_grouped,
 			const detail::LoopEdges& b_edge_map,
-			CSG::Collector& collector);
+			CSG::Collector& collector, bool propagate);
 
 	// intersect_half_classify_group.cpp
 
@@ -390,7 +438,7 @@ private:
 			const face_rtree_t* b_rtree, VertexClassification& vclass,
 			EdgeClassification& eclass, FaceLoopList& a_face_loops,
 			FaceLoopList& b_face_loops, size_t& a_edge_count,
-			size_t& b_edge_count);
+			size_t& b_edge_count, ShellClassification* shells = nullptr);
 
 public:
 	/**
@@ -412,11 +460,34 @@ public:
    */
 	enum CLASSIFY_TYPE {
 		CLASSIFY_NORMAL, /**< Normal (group) classifier. */
-		CLASSIFY_EDGE		 /**< Edge classifier. */
+		CLASSIFY_EDGE,	 /**< Edge classifier. */
+		CLASSIFY_FLOOD	 /**< Group classifier that propagates classifications
+											across edges where the other operand crosses. */
 	};
 
 	CSG::Hooks hooks; /**< The manager for calculation hooks. */
 
+	/**
+   * \brief If true, compute() classifies each shell that no intersection
+   * touches once, and copies it into the result whole, instead of
+   * splitting it into face loops and stitching it back together.
+   */
+	bool pass_through_shells{true};
+
+	/**
+   * \brief If not nullptr, CSG tree nodes evaluated with this object
+   * share the results of structurally equal subexpressions through
+   * this cache (see carve/tree.hpp).
+   */
+	CSG_TreeCache* tree_cache{nullptr};
+
+	/**
+   * \brief The number of face loop groups that the last compute()
+   * classified directly, by testing points against the other operand,
+   * with CLASSIFY_NORMAL or CLASSIFY_FLOOD.
+   */
+	size_t n_group_classifications{0};
+
 	CSG();
 	~CSG();
 
@@ -452,6 +523,31 @@ public:
 			V2Set* shared_edges = nullptr,
 			CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
 
+	/**
+   * \brief Compute a CSG operation between two polyhedra, using face
+   * R-trees that have already been built for them.
+   *
+   * @param a Polyhedron a
+   * @param a_rtree A face R-tree of \a a, or nullptr to build one.
+   * @param b Polyhedron b
+   * @param b_rtree A face R-tree of \a b, or nullptr to build one.
+   * @param collector The collector (determines the CSG operation performed)
+   * @param shared_edges A pointer to a set that will be populated with shared
+   * edges (if not nullptr).
+   * @param classify_type The type of classifier to use.
+   *
+   * @return
+   */
+	meshset_t* compute(meshset_t* a, const face_rtree_t* a_rtree,
+			meshset_t* b, const face_rtree_t* b_rtree, CSG::Collector& collector,
+			V2Set* shared_edges = nullptr,
+			CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
+	meshset_t* compute(meshset_t* a, const face_rtree_t* a_rtree,
+			meshset_t* b, const face_rtree_t* b_rtree, OP op,
+			V2Set* shared_edges = nullptr,
+			CLASSIFY_TYPE classify_type = CLASSIFY_NORMAL);
+
 	void slice(meshset_t* a, meshset_t* b, std::list<meshset_t*>& a_sliced,
 			std::list<meshset_t*>& b_sliced, V2Set* shared_edges = nullptr);
 
@@ -0,0 +1,508 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <carve/csg.hpp>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace carve {
+namespace csg {
+
+// The state shared by the standard collectors: the faces and shells
+// collected so far, and the assembly of the result from them. Calling
+// hooks is left to the derived collector.
+class CARVE_API CollectorBase : public CSG::Collector
+{
+public:
+	using meshset_t = CSG::meshset_t;
+
+	enum Selection {
+		DISCARD,
+		KEEP,
+		KEEP_REVERSED
+	};
+
+protected:
+	std::vector<CSG::OutputFace> faces;
+
+	// untouched shells of either operand that are copied into the
+	// result whole, and whether they are reversed.
+	std::vector<std::pair<const meshset_t::mesh_t*, bool>> shells;
+
+	const meshset_t* src_a;
+	const meshset_t* src_b;
+
+	CollectorBase(const meshset_t* _src_a, const meshset_t* _src_b)
+			: CSG::Collector(), src_a(_src_a), src_b(_src_b) {}
+
+	~CollectorBase() override = default;
+
+	// The class of the faces of grp, or FACE_UNCLASSIFIED if its
+	// classifications are missing or contradictory.
+	FaceClass groupClass(FaceLoopGroup* grp) const;
+
+	void addFace(meshset_t::face_t* face, const meshset_t::face_t* orig_face,
+			bool flipped)
+	{
+		faces.push_back(CSG::OutputFace{ face, orig_face, flipped });
+	}
+
+	void addShell(const meshset_t::mesh_t* shell, Selection selection)
+	{
+		if (selection != DISCARD)
+		{
+			shells.push_back(std::make_pair(shell, selection == KEEP_REVERSED));
+		}
+	}
+
+	// Start face at its least vertex by position. Face division begins
+	// each loop wherever its pointer-keyed sets do, which depends on
+	// where the intersection vertices were allocated, so the start of an
+	// output face would otherwise vary between identical computations.
+	static void startAtLeastVertex(meshset_t::face_t* face)
+	{
+		meshset_t::edge_t* min = face->edge;
+		meshset_t::edge_t* e = face->edge->next;
+		while (e != face->edge)
+		{
+			if (e->vert->v < min->vert->v)
+			{
+				min = e;
+			}
+			e = e->next;
+		}
+		face->edge = min;
+	}
+
+	// Build the result from the collected faces and shells.
+	meshset_t* assemble();
+
+	// Call f(new_face, orig_face, flipped) for each face of result, as
+	// returned by assemble().
+	template<typename func_t>
+	void eachResultFace(const meshset_t* result, func_t f) const
+	{
+		for (size_t i = 0; i < faces.size(); ++i)
+		{
+			f(faces[i].face, faces[i].orig_face, faces[i].flipped);
+		}
+		for (size_t i = 0; i < shells.size(); ++i)
+		{
+			const meshset_t::mesh_t* shell = result->meshes[n_stitched + i];
+			for (size_t j = 0; j < shell->faces.size(); ++j)
+			{
+				f(shell->faces[j], shells[i].first->faces[j], shells[i].second);
+			}
+		}
+	}
+
+private:
+	// the number of meshes of the result built from faces, which
+	// precede those copied from shells.
+	size_t n_stitched{ 0 };
+};
+
+// The faces kept by each operation, as a collector policy. A policy
+// provides select(), and classify, which is false if faces are kept
+// whatever their class.
+template<CSG::OP op>
+struct OpSelect
+{
+	static const bool classify = op != CSG::ALL;
+
+	static CollectorBase::Selection select(bool poly_a, FaceClass face_class)
+	{
+		switch (op)
+		{
+		case CSG::UNION:
+			if (face_class == FACE_OUT ||
+					(poly_a && face_class == FACE_ON_ORIENT_OUT))
+			{
+				return CollectorBase::KEEP;
+			}
+			break;
+		case CSG::INTERSECTION:
+			if (face_class == FACE_IN || (poly_a && face_class == FACE_ON_ORIENT_OUT))
+			{
+				return CollectorBase::KEEP;
+			}
+			break;
+		case CSG::A_MINUS_B:
+			if ((face_class == FACE_OUT || face_class == FACE_ON_ORIENT_IN) && poly_a)
+			{
+				return CollectorBase::KEEP;
+			}
+			else if (face_class == FACE_IN && !poly_a)
+			{
+				return CollectorBase::KEEP_REVERSED;
+			}
+			break;
+		case CSG::B_MINUS_A:
+			if ((face_class == FACE_OUT || face_class == FACE_ON_ORIENT_IN) &&
+					!poly_a)
+			{
+				return CollectorBase::KEEP;
+			}
+			else if (face_class == FACE_IN && poly_a)
+			{
+				return CollectorBase::KEEP_REVERSED;
+			}
+			break;
+		case CSG::SYMMETRIC_DIFFERENCE:
+			if (face_class == FACE_OUT)
+			{
+				return CollectorBase::KEEP;
+			}
+			else if (face_class == FACE_IN)
+			{
+				return CollectorBase::KEEP_REVERSED;
+			}
+			break;
+		case CSG::ALL:
+			return CollectorBase::KEEP;
+		}
+		return CollectorBase::DISCARD;
+	}
+};
+
+template<CSG::OP op>
+const bool OpSelect<op>::classify;
+
+// A list of hooks of static types. Each type declares the hooks it
+// handles as a static member hook_bits (a combination of CSG::Hooks
+// bits), and provides the CSG::Hook member functions for them. The
+// hooks are called in order, by qualified calls, so a hook derived
+// from CSG::Hook is called without virtual dispatch.
+template<typename... hook_t>
+struct StaticHooks
+{
+	using meshset_t = CSG::meshset_t;
+
+	static const unsigned bits = 0;
+
+	void intersectionVertex(const meshset_t::vertex_t*, const IObjPairSet&) {}
+	void processOutputFace(std::vector<meshset_t::face_t*>&,
+			const meshset_t::face_t*, bool) {}
+	void processOutputFaces(std::vector<CSG::OutputFace>&) {}
+	void resultFace(const meshset_t::face_t*, const meshset_t::face_t*, bool) {}
+	void edgeDivision(const meshset_t::edge_t*, size_t, const meshset_t::vertex_t*,
+			const meshset_t::vertex_t*) {}
+};
+
+template<typename first_t, typename... rest_t>
+struct StaticHooks<first_t, rest_t...>
+{
+	using meshset_t = CSG::meshset_t;
+
+	static const unsigned bits = first_t::hook_bits | StaticHooks<rest_t...>::bits;
+
+	first_t& first;
+	StaticHooks<rest_t...> rest;
+
+	StaticHooks(first_t& _first, rest_t&... _rest) : first(_first), rest(_rest...) {}
+
+	void intersectionVertex(const meshset_t::vertex_t* vertex,
+			const IObjPairSet& intersections)
+	{
+		intersectionVertex(has<CSG::Hooks::INTERSECTION_VERTEX_BIT>(), vertex,
+				intersections);
+		rest.intersectionVertex(vertex, intersections);
+	}
+
+	void processOutputFace(std::vector<meshset_t::face_t*>& faces,
+			const meshset_t::face_t* orig_face, bool flipped)
+	{
+		processOutputFace(has<CSG::Hooks::PROCESS_OUTPUT_FACE_BIT>(), faces,
+				orig_face, flipped);
+		rest.processOutputFace(faces, orig_face, flipped);
+	}
+
+	void processOutputFaces(std::vector<CSG::OutputFace>& faces)
+	{
+		processOutputFaces(has<CSG::Hooks::PROCESS_OUTPUT_FACES_BIT>(), faces);
+		rest.processOutputFaces(faces);
+	}
+
+	void resultFace(const meshset_t::face_t* new_face,
+			const meshset_t::face_t* orig_face, bool flipped)
+	{
+		resultFace(has<CSG::Hooks::RESULT_FACE_BIT>(), new_face, orig_face, flipped);
+		rest.resultFace(new_face, orig_face, flipped);
+	}
+
+	void edgeDivision(const meshset_t::edge_t* orig_edge, size_t orig_edge_idx,
+			const meshset_t::vertex_t* v1, const meshset_t::vertex_t* v2)
+	{
+		edgeDivision(has<CSG::Hooks::EDGE_DIVISION_BIT>(), orig_edge, orig_edge_idx,
+				v1, v2);
+		rest.edgeDivision(orig_edge, orig_edge_idx, v1, v2);
+	}
+
+private:
+	template<unsigned bit>
+	using has = std::integral_constant<bool, (first_t::hook_bits & bit) != 0>;
+
+	void intersectionVertex(std::true_type, const meshset_t::vertex_t* vertex,
+			const IObjPairSet& intersections)
+	{
+		first.first_t::intersectionVertex(vertex, intersections);
+	}
+	void intersectionVertex(std::false_type, const meshset_t::vertex_t*,
+			const IObjPairSet&) {}
+
+	void processOutputFace(std::true_type,
+			std::vector<meshset_t::face_t*>& faces,
+			const meshset_t::face_t* orig_face, bool flipped)
+	{
+		first.first_t::processOutputFace(faces, orig_face, flipped);
+	}
+	void processOutputFace(std::false_type, std::vector<meshset_t::face_t*>&,
+			const meshset_t::face_t*, bool) {}
+
+	void processOutputFaces(std::true_type, std::vector<CSG::OutputFace>& faces)
+	{
+		first.first_t::processOutputFaces(faces);
+	}
+	void processOutputFaces(std::false_type, std::vector<CSG::OutputFace>&) {}
+
+	void resultFace(std::true_type, const meshset_t::face_t* new_face,
+			const meshset_t::face_t* orig_face, bool flipped)
+	{
+		first.first_t::resultFace(new_face, orig_face, flipped);
+	}
+	void resultFace(std::false_type, const meshset_t::face_t*,
+			const meshset_t::face_t*, bool) {}
+
+	void edgeDivision(std::true_type, const meshset_t::edge_t* orig_edge,
+			size_t orig_edge_idx, const meshset_t::vertex_t* v1,
+			const meshset_t::vertex_t* v2)
+	{
+		first.first_t::edgeDivision(orig_edge, orig_edge_idx, v1, v2);
+	}
+	void edgeDivision(std::false_type, const meshset_t::edge_t*, size_t,
+			const meshset_t::vertex_t*, const meshset_t::vertex_t*) {}
+};
+
+template<typename... hook_t>
+const unsigned StaticHooks<hook_t...>::bits;
+
+template<typename first_t, typename... rest_t>
+const unsigned StaticHooks<first_t, rest_t...>::bits;
+
+// A collector for the faces chosen by select_t (see OpSelect), which
+// calls hooks of static types directly for each output face. Hooks
+// registered with the CSG object are called as well, after the static
+// hooks, and cost one check per face loop group or per pass when there
+// are none. Output faces are in the order they are collected, and each
+// starts at its least vertex, so the result does not depend on memory
+// layout.
+template<typename select_t, typename... hook_t>
+class StaticCollector : public CollectorBase
+{
+public:
+	using hooks_t = StaticHooks<hook_t...>;
+
+	StaticCollector(const meshset_t* _src_a, const meshset_t* _src_b,
+			hook_t&... _hooks)
+			: CollectorBase(_src_a, _src_b), hooks(_hooks...) {}
+
+	~StaticCollector() override = default;
+
+	hooks_t& staticHooks() { return hooks; }
+
+	void collect(FaceLoopGroup* grp, CSG::Hooks& dyn_hooks) override
+	{
+		FaceClass fc = FACE_OUT;
+		if (select_t::classify)
+		{
+			fc = groupClass(grp);
+			if (fc == FACE_UNCLASSIFIED)
+			{
+				return;
+			}
+		}
+
+		switch (select_t::select(grp->src == src_a, fc))
+		{
+		case KEEP:
+			collectLoops(grp, false, dyn_hooks);
+			break;
+		case KEEP_REVERSED:
+			collectLoops(grp, true, dyn_hooks);
+			break;
+		case DISCARD:
+			break;
+		}
+	}
+
+	// Shells are copied face for face, so they cannot go through a hook
+	// that replaces output faces.
+	bool acceptsShells(CSG::Hooks& dyn_hooks) override
+	{
+		return !(hooks_t::bits & (CSG::Hooks::PROCESS_OUTPUT_FACE_BIT |
+												 CSG::Hooks::PROCESS_OUTPUT_FACES_BIT)) &&
+				!dyn_hooks.hasHook(CSG::Hooks::PROCESS_OUTPUT_FACE_HOOK) &&
+				!dyn_hooks.hasHook(CSG::Hooks::PROCESS_OUTPUT_FACES_HOOK);
+	}
+
+	void collectShell(const meshset_t::mesh_t* shell, FaceClass fc,
+			CSG::Hooks& /* dyn_hooks */) override
+	{
+		addShell(shell, select_t::select(shell->meshset == src_a, fc));
+	}
+
+	meshset_t* done(CSG::Hooks& dyn_hooks) override
+	{
+		if (hooks_t::bits & CSG::Hooks::PROCESS_OUTPUT_FACES_BIT)
+		{
+			hooks.processOutputFaces(faces);
+		}
+		if (dyn_hooks.hasHook(CSG::Hooks::PROCESS_OUTPUT_FACES_HOOK))
+		{
+			dyn_hooks.processOutputFaces(faces);
+		}
+
+		meshset_t* result = assemble();
+
+		if (hooks_t::bits & CSG::Hooks::RESULT_FACE_BIT)
+		{
+			hooks_t& h = hooks;
+			eachResultFace(result, [&h](const meshset_t::face_t* new_face,
+																	 const meshset_t::face_t* orig_face,
+																	 bool flipped) {
+				h.resultFace(new_face, orig_face, flipped);
+			});
+		}
+		if (dyn_hooks.hasHook(CSG::Hooks::RESULT_FACE_HOOK))
+		{
+			eachResultFace(result, [&dyn_hooks](const meshset_t::face_t* new_face,
+																		 const meshset_t::face_t* orig_face,
+																		 bool flipped) {
+				dyn_hooks.resultFace(new_face, orig_face, flipped);
+			});
+		}
+		return result;
+	}
+
+private:
+	hooks_t hooks;
+	std::vector<meshset_t::face_t*> new_faces;
+
+	void collectLoops(FaceLoopGroup* grp, bool flipped, CSG::Hooks& dyn_hooks)
+	{
+		const bool dyn = dyn_hooks.hasHook(CSG::Hooks::PROCESS_OUTPUT_FACE_HOOK);
+		for (FaceLoop* f = grp->face_loops.head; f; f = f->next)
+		{
+			meshset_t::face_t* face =
+					f->orig_face->create(f->vertices.begin(), f->vertices.end(), flipped);
+			startAtLeastVertex(face);
+			if (!(hooks_t::bits & CSG::Hooks::PROCESS_OUTPUT_FACE_BIT) && !dyn)
+			{
+				addFace(face, f->orig_face, flipped);
+				continue;
+			}
+
+			new_faces.assign(1, face);
+			hooks.processOutputFace(new_faces, f->orig_face, flipped);
+			if (dyn)
+			{
+				dyn_hooks.processOutputFace(new_faces, f->orig_face, flipped);
+			}
+			for (size_t i = 0; i < new_faces.size(); ++i)
+			{
+				addFace(new_faces[i], f->orig_face, flipped);
+			}
+		}
+	}
+};
+
+namespace detail {
+
+// Forwards the static hooks that are called from within the
+// intersection code, rather than by the collector, for the duration of
+// one computation.
+template<typename hooks_t>
+struct StaticHookBridge : public CSG::Hook
+{
+	hooks_t& hooks;
+	CSG::Hooks& registry;
+
+	StaticHookBridge(hooks_t& _hooks, CSG::Hooks& _registry)
+			: hooks(_hooks), registry(_registry)
+	{
+		const unsigned bits = hooks_t::bits & (CSG::Hooks::INTERSECTION_VERTEX_BIT |
+																							CSG::Hooks::EDGE_DIVISION_BIT);
+		if (bits)
+		{
+			registry.registerHook(this, bits);
+		}
+	}
+
+	~StaticHookBridge() override { registry.unregisterHook(this); }
+
+	void intersectionVertex(const CSG::meshset_t::vertex_t* vertex,
+			const IObjPairSet& intersections) override
+	{
+		hooks.intersectionVertex(vertex, intersections);
+	}
+
+	void edgeDivision(const CSG::meshset_t::edge_t* orig_edge,
+			size_t orig_edge_idx, const CSG::meshset_t::vertex_t* v1,
+			const CSG::meshset_t::vertex_t* v2) override
+	{
+		hooks.edgeDivision(orig_edge, orig_edge_idx, v1, v2);
+	}
+};
+}
+
+// Compute a CSG operation between a and b, keeping the faces chosen by
+// select_t, and calling hooks of static types (see StaticHooks) as well
+// as those registered with csg.
+template<typename select_t, typename... hook_t>
+CSG::meshset_t* compute(CSG& csg, CSG::meshset_t* a, CSG::meshset_t* b,
+		CSG::CLASSIFY_TYPE classify_type, hook_t&... hooks)
+{
+	using collector_t = StaticCollector<select_t, hook_t...>;
+
+	collector_t collector(a, b, hooks...);
+	detail::StaticHookBridge<typename collector_t::hooks_t> bridge(
+			collector.staticHooks(), csg.hooks);
+	return csg.compute(a, b, collector, nullptr, classify_type);
+}
+
+template<CSG::OP op, typename... hook_t>
+CSG::meshset_t* compute(CSG& csg, CSG::meshset_t* a, CSG::meshset_t* b,
+		CSG::CLASSIFY_TYPE classify_type, hook_t&... hooks)
+{
+	return compute<OpSelect<op>>(csg, a, b, classify_type, hooks...);
+}
+}
+} // namespace carve::csg
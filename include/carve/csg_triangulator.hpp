@@ -26,6 +26,7 @@
 
 #include <carve/csg.hpp>
 #include <carve/face_decl.hpp>
+#include <carve/parallel.hpp>
 #include <carve/tag.hpp>
 #include <carve/triangulator.hpp>
 
@@ -35,9 +36,44 @@ namespace carve {
 namespace csg {
 
 namespace detail {
+// Registered with PROCESS_OUTPUT_FACE_BIT, output faces are triangulated
+// one original face at a time, as they are collected. Registered with
+// PROCESS_OUTPUT_FACES_BIT, triangulation is deferred until every face
+// has been collected, and then done in parallel.
 template<bool with_improvement>
 class CarveTriangulator : public csg::CSG::Hook
 {
+	static void triangulateFace(const carve::mesh::MeshSet<3>::face_t* face,
+			std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vloop,
+			std::vector<triangulate::tri_idx>& result)
+	{
+		face->getVertices(vloop);
+
+		triangulate::triangulate(
+				carve::mesh::MeshSet<3>::face_t::projection_mapping(face->project),
+				vloop, result);
+
+		if (with_improvement)
+		{
+			// flip towards Delaunay in the plane of the face, where the
+			// axis projection does not distort angles.
+			const carve::geom3d::Vector& n = face->plane.N;
+			carve::geom3d::Vector e = carve::geom::VECTOR(0.0, 0.0, 0.0);
+			e.v[carve::geom::smallestAxis(n)] = 1.0;
+			const carve::geom3d::Vector u = carve::geom::cross(n, e).normalized();
+			const carve::geom3d::Vector v = carve::geom::cross(n, u);
+
+			std::vector<carve::geom2d::P2> points;
+			points.reserve(vloop.size());
+			for (size_t i = 0; i < vloop.size(); ++i)
+			{
+				points.push_back(carve::geom::VECTOR(carve::geom::dot(vloop[i]->v, u),
+						carve::geom::dot(vloop[i]->v, v)));
+			}
+			triangulate::improveDelaunay(points, result);
+		}
+	}
+
 public:
 	CarveTriangulator() = default;
 
@@ -71,27 +107,68 @@ public:
 			std::vector<triangulate::tri_idx> result;
 
 			std::vector<carve::mesh::MeshSet<3>::vertex_t*> vloop;
-			face->getVertices(vloop);
+			triangulateFace(face, vloop, result);
 
-			triangulate::triangulate(
-					carve::mesh::MeshSet<3>::face_t::projection_mapping(face->project),
-					vloop, result);
+			std::vector<carve::mesh::MeshSet<3>::vertex_t*> fv;
+			fv.resize(3);
+			for (size_t i = 0; i < result.size(); ++i)
+			{
+				fv[0] = vloop[result[i].a];
+				fv[1] = vloop[result[i].b];
+				fv[2] = vloop[result[i].c];
+				out_faces.push_back(face->create(fv.begin(), fv.end(), false));
+			}
+			delete face;
+		}
+		std::swap(faces, out_faces);
+	}
 
-			if (with_improvement)
+	void processOutputFaces(std::vector<CSG::OutputFace>& faces) override
+	{
+		// triangulate each n-gon independently, then replace the faces in
+		// order, so that the result does not depend on the thread count.
+		std::vector<std::vector<carve::mesh::MeshSet<3>::vertex_t*>> vloops(
+				faces.size());
+		std::vector<std::vector<triangulate::tri_idx>> results(faces.size());
+		carve::parallel::for_each_index(0, faces.size(), 16, [&](size_t f) {
+			CARVE_ASSERT(faces[f].face->nVertices() >= 3);
+			if (faces[f].face->nVertices() != 3)
 			{
-				triangulate::improve(
-						carve::mesh::MeshSet<3>::face_t::projection_mapping(face->project),
-						vloop, carve::mesh::vertex_distance(), result);
+				triangulateFace(faces[f].face, vloops[f], results[f]);
 			}
+		});
 
-			std::vector<carve::mesh::MeshSet<3>::vertex_t*> fv;
-			fv.resize(3);
+		size_t n_tris = 0;
+		for (size_t f = 0; f < faces.size(); ++f)
+		{
+			n_tris += faces[f].face->nVertices() - 2;
+		}
+
+		std::vector<CSG::OutputFace> out_faces;
+		out_faces.reserve(n_tris);
+
+		std::vector<carve::mesh::MeshSet<3>::vertex_t*> fv;
+		fv.resize(3);
+		for (size_t f = 0; f < faces.size(); ++f)
+		{
+			carve::mesh::MeshSet<3>::face_t* face = faces[f].face;
+
+			if (face->nVertices() == 3)
+			{
+				out_faces.push_back(faces[f]);
+				continue;
+			}
+
+			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vloop = vloops[f];
+			const std::vector<triangulate::tri_idx>& result = results[f];
 			for (size_t i = 0; i < result.size(); ++i)
 			{
 				fv[0] = vloop[result[i].a];
 				fv[1] = vloop[result[i].b];
 				fv[2] = vloop[result[i].c];
-				out_faces.push_back(face->create(fv.begin(), fv.end(), false));
+				out_faces.push_back(CSG::OutputFace{
+						face->create(fv.begin(), fv.end(), false), faces[f].orig_face,
+						faces[f].flipped });
 			}
 			delete face;
 		}
@@ -25,7 +25,9 @@
 #pragma once
 
 #include <carve/carve.hpp>
+#include <carve/parallel.hpp>
 
+#include <atomic>
 #include <vector>
 
 namespace carve {
@@ -164,5 +166,106 @@ public:
 		}
 	}
 };
+
+// A disjoint set structure that supports concurrent merge_sets() and
+// find_set_head() calls from multiple threads, without locking.
+// Heads are linked by index (the larger head is made a child of the
+// smaller one), so the head of every set is its smallest element,
+// whatever order the merges happen in.
+class concurrent_djset
+{
+protected:
+	std::vector<std::atomic<size_t>> parent;
+	std::atomic<size_t> n_sets{0};
+
+public:
+	concurrent_djset() : parent() {}
+
+	explicit concurrent_djset(size_t N) { init(N); }
+
+	void init(size_t N)
+	{
+		std::vector<std::atomic<size_t>> temp(N);
+		for (size_t i = 0; i < N; ++i)
+		{
+			temp[i].store(i, std::memory_order_relaxed);
+		}
+		std::swap(parent, temp);
+		n_sets.store(N);
+	}
+
+	size_t count() const { return n_sets.load(); }
+
+	size_t find_set_head(size_t a)
+	{
+		while (true)
+		{
+			size_t p = parent[a].load(std::memory_order_acquire);
+			if (p == a)
+			{
+				return a;
+			}
+			size_t gp = parent[p].load(std::memory_order_acquire);
+			if (p == gp)
+			{
+				return p;
+			}
+			// path halving. a failed exchange means that another thread
+			// has already moved a closer to its head.
+			parent[a].compare_exchange_weak(p, gp, std::memory_order_acq_rel);
+			a = gp;
+		}
+	}
+
+	bool same_set(size_t a, size_t b)
+	{
+		return find_set_head(a) == find_set_head(b);
+	}
+
+	void merge_sets(size_t a, size_t b)
+	{
+		while (true)
+		{
+			a = find_set_head(a);
+			b = find_set_head(b);
+			if (a == b)
+			{
+				return;
+			}
+			if (a < b)
+			{
+				std::swap(a, b);
+			}
+			size_t expected = a;
+			if (parent[a].compare_exchange_strong(expected, b, std::memory_order_acq_rel))
+			{
+				n_sets--;
+				return;
+			}
+		}
+	}
+
+	// Number the sets in order of their smallest element, in the same
+	// way as djset::get_index_to_set().
+	void get_index_to_set(std::vector<size_t>& index_set,
+			std::vector<size_t>& set_size)
+	{
+		const size_t N = parent.size();
+		index_set.clear();
+		index_set.resize(N);
+		carve::parallel::for_each_index(0, N, 4096, [&](size_t i) {
+			index_set[i] = find_set_head(i);
+		});
+
+		set_size.clear();
+		set_size.resize(count(), 0);
+		size_t c = 0;
+		for (size_t i = 0; i < N; ++i)
+		{
+			index_set[i] = index_set[i] == i ? c++ : index_set[index_set[i]];
+			set_size[index_set[i]]++;
+		}
+	}
+};
 }
 } // namespace carve::djset
@@ -87,6 +87,37 @@ inline double orient2d(const P2& a, const P2& b, const P2& c)
 }
 #endif
 
+/**
+ * \brief Return the position of d with respect to the circle
+ *        through a, b and c.
+ *
+ * (Can be implemented exactly)
+ *
+ * @return positive, if a, b and c are anticlockwise and d is
+ *         inside the circle, or they are clockwise and d is
+ *         outside it.
+ *         zero, if d is on the circle.
+ *         negative, otherwise.
+ */
+#if defined(CARVE_USE_EXACT_PREDICATES)
+inline double incircle(const P2& a, const P2& b, const P2& c, const P2& d)
+{
+	return shewchuk::incircle(a.v, b.v, c.v, d.v);
+}
+#else
+inline double incircle(const P2& a, const P2& b, const P2& c, const P2& d)
+{
+	double adx = a.x - d.x, ady = a.y - d.y;
+	double bdx = b.x - d.x, bdy = b.y - d.y;
+	double cdx = c.x - d.x, cdy = c.y - d.y;
+	double alift = adx * adx + ady * ady;
+	double blift = bdx * bdx + bdy * bdy;
+	double clift = cdx * cdx + cdy * cdy;
+	return alift * (bdx * cdy - cdx * bdy) + blift * (cdx * ady - adx * cdy) +
+				 clift * (adx * bdy - bdx * ady);
+}
+#endif
+
 /**
  * \brief Determine whether p is internal to the anticlockwise
  *        angle abc, where b is the apex of the angle.
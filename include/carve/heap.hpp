@@ -24,8 +24,12 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <utility>
+#include <vector>
 
 namespace carve {
 namespace heap {
@@ -358,5 +362,166 @@ void sort_heap(random_access_iter_t begin, random_access_iter_t end,
 	}
 	notify(begin[0], 0);
 }
+
+// A d-ary min-heap of dense ids in [0, n), each with a key. The
+// position of every id is recorded, so that its key can be changed, or
+// it can be removed, in O(log n). Keys are stored alongside the ids, so
+// that sifting touches nothing but the heap array.
+template<typename key_t, unsigned D = 4>
+class indexed_heap
+{
+public:
+	using entry_t = std::pair<key_t, uint32_t>;
+
+	static const uint32_t npos = ~uint32_t(0);
+
+	explicit indexed_heap(size_t n_ids = 0) : pos(n_ids, npos) {}
+
+	bool empty() const { return entries.empty(); }
+	size_t size() const { return entries.size(); }
+
+	bool contains(uint32_t id) const { return pos[id] != npos; }
+
+	uint32_t top() const { return entries[0].second; }
+	const key_t& top_key() const { return entries[0].first; }
+
+	// Replace the contents of the heap with (key, id) pairs, in O(n).
+	void assign(std::vector<entry_t>&& _entries)
+	{
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			pos[entries[i].second] = npos;
+		}
+		entries = std::move(_entries);
+		for (size_t i = entries.size(); i > 0;)
+		{
+			--i;
+			pos[entries[i].second] = uint32_t(i);
+		}
+		for (size_t i = entries.size() / D + 1; i > 0;)
+		{
+			sift_down(--i);
+		}
+	}
+
+	// Insert id with the given key, or change its key.
+	void update(uint32_t id, const key_t& key)
+	{
+		uint32_t i = pos[id];
+		if (i == npos)
+		{
+			entries.emplace_back(key, id);
+			pos[id] = uint32_t(entries.size() - 1);
+			sift_up(entries.size() - 1);
+		}
+		else if (key < entries[i].first)
+		{
+			entries[i].first = key;
+			sift_up(i);
+		}
+		else
+		{
+			entries[i].first = key;
+			sift_down(i);
+		}
+	}
+
+	// Remove id, if it is present.
+	void remove(uint32_t id)
+	{
+		const uint32_t i = pos[id];
+		if (i == npos)
+		{
+			return;
+		}
+		pos[id] = npos;
+		const entry_t last = entries.back();
+		entries.pop_back();
+		if (i == entries.size())
+		{
+			return;
+		}
+		entries[i] = last;
+		pos[last.second] = i;
+		if (i > 0 && last.first < entries[(i - 1) / D].first)
+		{
+			sift_up(i);
+		}
+		else
+		{
+			sift_down(i);
+		}
+	}
+
+	uint32_t pop()
+	{
+		const uint32_t id = top();
+		remove(id);
+		return id;
+	}
+
+private:
+	std::vector<entry_t> entries;
+	std::vector<uint32_t> pos;
+
+	void place(size_t i, const entry_t& e)
+	{
+		entries[i] = e;
+		pos[e.second] = uint32_t(i);
+	}
+
+	void sift_up(size_t i)
+	{
+		const entry_t e = entries[i];
+		while (i > 0)
+		{
+			const size_t parent = (i - 1) / D;
+			if (!(e.first < entries[parent].first))
+			{
+				break;
+			}
+			place(i, entries[parent]);
+			i = parent;
+		}
+		place(i, e);
+	}
+
+	void sift_down(size_t i)
+	{
+		const size_t n = entries.size();
+		if (i >= n)
+		{
+			return;
+		}
+		const entry_t e = entries[i];
+		for (;;)
+		{
+			const size_t first = i * D + 1;
+			if (first >= n)
+			{
+				break;
+			}
+			const size_t last = std::min(first + D, n);
+			size_t child = first;
+			for (size_t c = first + 1; c < last; ++c)
+			{
+				if (entries[c].first < entries[child].first)
+				{
+					child = c;
+				}
+			}
+			if (!(entries[child].first < e.first))
+			{
+				break;
+			}
+			place(i, entries[child]);
+			i = child;
+		}
+		place(i, e);
+	}
+};
+
+template<typename key_t, unsigned D>
+const uint32_t indexed_heap<key_t, D>::npos;
 }
 } // namespace carve::heap
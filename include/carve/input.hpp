@@ -27,10 +27,13 @@
 #include <carve/carve.hpp>
 
 #include <carve/mesh.hpp>
+#include <carve/parallel.hpp>
 #include <carve/pointset.hpp>
 #include <carve/poly.hpp>
 #include <carve/polyline.hpp>
 
+#include <algorithm>
+#include <iterator>
 #include <map>
 #include <string>
 
@@ -205,6 +208,208 @@ struct PolyhedronData : public VertexData
 	}
 };
 
+// Builds a MeshSet<3> while a model is being read, rather than
+// collecting the whole model in a PolyhedronData first. Vertices are
+// stored directly in what becomes the vertex storage of the result,
+// and buffered face indices are converted to mesh faces whenever they
+// exceed the buffer budget. The transient memory on top of the final
+// MeshSet is therefore bounded by the face buffer, plus the edge map
+// used to stitch faces into meshes.
+//
+// Faces may refer to vertices that have not yet been added; such
+// faces stay buffered until the vertices arrive. createMesh() hands
+// the mesh data over to the result, so it can only be called once.
+struct StreamingPolyhedronData : public Data
+{
+	using vertex_t = carve::mesh::Vertex<3>;
+	using face_t = carve::mesh::Face<3>;
+
+	std::vector<vertex_t> vertex_storage;
+	std::vector<face_t*> faces;
+	std::vector<int> pendingIndices;
+	size_t pendingFaceCount{0};
+	size_t bufferLimit;
+
+	explicit StreamingPolyhedronData(size_t buffer_bytes = 1 << 20)
+			: Data(), bufferLimit(std::max<size_t>(1, buffer_bytes / sizeof(int))) {}
+
+	~StreamingPolyhedronData() override
+	{
+		for (size_t i = 0; i < faces.size(); ++i)
+		{
+			delete faces[i];
+		}
+	}
+
+	void transform(const carve::math::Matrix& transform) override
+	{
+		for (size_t i = 0; i < vertex_storage.size(); ++i)
+		{
+			vertex_storage[i].v *= transform;
+		}
+		carve::mesh::recalcFaces(faces.data(), faces.size());
+	}
+
+	void reserveVertices(int count)
+	{
+		if (count > 0 && (size_t)count > vertex_storage.capacity())
+		{
+			growVertexStorage(count);
+		}
+	}
+
+	size_t addVertex(carve::geom3d::Vector point)
+	{
+		if (vertex_storage.size() == vertex_storage.capacity())
+		{
+			growVertexStorage(std::max<size_t>(16, vertex_storage.size() * 2));
+		}
+		size_t index = vertex_storage.size();
+		vertex_storage.push_back(vertex_t(point));
+		return index;
+	}
+
+	size_t getVertexCount() const { return vertex_storage.size(); }
+
+	const carve::geom3d::Vector& getVertex(int index) const
+	{
+		return vertex_storage[index].v;
+	}
+
+	carve::geom3d::Vector& lastVertex() { return vertex_storage.back().v; }
+
+	void reserveFaces(int count, int /* avgFaceSize */)
+	{
+		if (count > 0)
+		{
+			faces.reserve(faces.size() + pendingFaceCount + count);
+		}
+	}
+
+	int getFaceCount() const { return (int)(faces.size() + pendingFaceCount); }
+
+	template<typename Iter>
+	void addFace(Iter begin, Iter end)
+	{
+		pendingIndices.push_back((int)std::distance(begin, end));
+		std::copy(begin, end, std::back_inserter(pendingIndices));
+		faceAdded();
+	}
+
+	void addFace(int a, int b, int c)
+	{
+		pendingIndices.push_back(3);
+		pendingIndices.push_back(a);
+		pendingIndices.push_back(b);
+		pendingIndices.push_back(c);
+		faceAdded();
+	}
+
+	void addFace(int a, int b, int c, int d)
+	{
+		pendingIndices.push_back(4);
+		pendingIndices.push_back(a);
+		pendingIndices.push_back(b);
+		pendingIndices.push_back(c);
+		pendingIndices.push_back(d);
+		faceAdded();
+	}
+
+	// Convert buffered faces into mesh faces, in order, up to the first
+	// face that refers to a vertex that has not been added yet.
+	void flush()
+	{
+		std::vector<size_t> offsets;
+		size_t p = 0;
+		while (p < pendingIndices.size())
+		{
+			CARVE_ASSERT(pendingIndices[p] > 1);
+			const size_t N = (size_t)pendingIndices[p];
+			if (p + N >= pendingIndices.size())
+			{
+				break;
+			}
+			bool ready = true;
+			for (size_t j = 1; ready && j <= N; ++j)
+			{
+				int idx = pendingIndices[p + j];
+				CARVE_ASSERT(idx >= 0);
+				ready = (size_t)idx < vertex_storage.size();
+			}
+			if (!ready)
+			{
+				break;
+			}
+			offsets.push_back(p);
+			p += N + 1;
+		}
+
+		const size_t base = faces.size();
+		faces.resize(base + offsets.size());
+		carve::parallel::for_each_index(0, offsets.size(), 1024, [&](size_t i) {
+			const int* idx = &pendingIndices[offsets[i]];
+			std::vector<vertex_t*> v(idx[0]);
+			for (int j = 0; j < idx[0]; ++j)
+			{
+				v[j] = &vertex_storage[idx[j + 1]];
+			}
+			faces[base + i] = new face_t(v.begin(), v.end());
+		});
+
+		pendingIndices.erase(pendingIndices.begin(), pendingIndices.begin() + p);
+		pendingFaceCount -= offsets.size();
+	}
+
+	carve::mesh::MeshSet<3>* createMesh(const Options& options)
+	{
+		flush();
+		CARVE_ASSERT(pendingIndices.empty());
+		std::vector<int>().swap(pendingIndices);
+
+		Options::const_iterator i;
+		carve::mesh::MeshOptions mopts;
+		i = options.find("avoid_cavities");
+		if (i != options.end())
+		{
+			mopts.avoid_cavities(_bool((*i).second));
+		}
+
+		std::vector<carve::mesh::Mesh<3>*> meshes;
+		carve::mesh::Mesh<3>::create(faces.begin(), faces.end(), meshes, mopts);
+		std::vector<face_t*>().swap(faces);
+		return new carve::mesh::MeshSet<3>(vertex_storage, meshes);
+	}
+
+private:
+	void faceAdded()
+	{
+		++pendingFaceCount;
+		if (pendingIndices.size() >= bufferLimit)
+		{
+			flush();
+		}
+	}
+
+	// Grow the vertex storage, moving the vertices of faces that have
+	// already been built over to the new storage.
+	void growVertexStorage(size_t n)
+	{
+		std::vector<vertex_t> grown;
+		grown.reserve(n);
+		grown.insert(grown.end(), vertex_storage.begin(), vertex_storage.end());
+		const vertex_t* old_base = vertex_storage.data();
+		carve::parallel::for_each_index(0, faces.size(), 1024, [&](size_t i) {
+			carve::mesh::Edge<3>* e = faces[i]->edge;
+			do
+			{
+				e->vert = &grown[e->vert - old_base];
+				e = e->next;
+			} while (e != faces[i]->edge);
+		});
+		vertex_storage.swap(grown);
+	}
+};
+
 struct PolylineSetData : public VertexData
 {
 	using polyline_data_t = std::pair<bool, std::vector<int>>;
@@ -288,6 +493,11 @@ public:
 template<>
 inline carve::mesh::MeshSet<3>* Input::create(Data* d, const Options& options)
 {
+	StreamingPolyhedronData* s = dynamic_cast<StreamingPolyhedronData*>(d);
+	if (s != nullptr)
+	{
+		return s->createMesh(options);
+	}
 	PolyhedronData* p = dynamic_cast<PolyhedronData*>(d);
 	if (p == nullptr)
 	{
@@ -31,25 +31,30 @@
 #include <carve/mesh.hpp>
 #include <carve/poly.hpp>
 
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 namespace carve {
 namespace interpolate {
 
-static inline std::vector<double> polyInterpolate(
-		const std::vector<carve::geom2d::P2>& s, const carve::geom2d::P2& v)
+// Mean value weights of the vertices of s for the point v, written to
+// result. r, A and D are scratch space, so that repeated calls need not
+// allocate.
+static inline void polyInterpolate(const std::vector<carve::geom2d::P2>& s,
+		const carve::geom2d::P2& v, std::vector<double>& result,
+		std::vector<double>& r, std::vector<double>& A, std::vector<double>& D)
 {
 	// see hormann et al. 2006
 	const size_t SZ = s.size();
-	std::vector<double> r;
-	std::vector<double> A;
-	std::vector<double> D;
-
-	std::vector<double> result;
 
 	r.resize(SZ);
 	A.resize(SZ);
 	D.resize(SZ);
 
-	result.resize(SZ, 0.0);
+	result.assign(SZ, 0.0);
 
 	for (size_t i = 0; i < SZ; ++i)
 	{
@@ -63,14 +68,14 @@ static inline std::vector<double> polyInterpolate(
 		if (fabs(r[i]) < 1e-16)
 		{
 			result[i] = 1.0;
-			return result;
+			return;
 		}
 		else if (fabs(A[i]) < 1e-16 && D[i] < 0.0)
 		{
 			double r2 = sqrt(dot(si2, si2));
 			result[i2] = r[i] / (r[i] + r2);
 			result[i] = r2 / (r[i] + r2);
-			return result;
+			return;
 		}
 	}
 
@@ -104,7 +109,16 @@ static inline std::vector<double> polyInterpolate(
 	//       for (size_t i = 0; i < SZ; ++i) {
 	//         test = test + result[i] * s[i];
 	//       }
+}
 
+static inline std::vector<double> polyInterpolate(
+		const std::vector<carve::geom2d::P2>& s, const carve::geom2d::P2& v)
+{
+	std::vector<double> r;
+	std::vector<double> A;
+	std::vector<double> D;
+	std::vector<double> result;
+	polyInterpolate(s, v, result, r, A, D);
 	return result;
 }
 
@@ -173,6 +187,221 @@ val_t interp(const std::vector<carve::geom2d::P2>& poly,
 	return interp(poly, vals, x, y, identity_t<val_t>());
 }
 
+namespace detail {
+
+// Attribute values for faces, held in one flat array. Each face is
+// given a dense id the first time a value is stored for it, and its
+// slots (one per corner or edge, or one for the whole face) are
+// contiguous, so that a face costs one lookup however many values it
+// has. A slot is a row of width values.
+template<typename attr_t>
+class FaceStore
+{
+public:
+	using face_t = carve::mesh::MeshSet<3>::face_t;
+
+	static const uint32_t npos = ~uint32_t(0);
+
+	size_t width() const { return row; }
+
+	// Only possible while the store is empty.
+	void setWidth(size_t w)
+	{
+		CARVE_ASSERT(present.empty());
+		row = w;
+	}
+
+	uint32_t find(const face_t* f) const
+	{
+		typename id_map_t::const_iterator i = ids.find(f);
+		return i == ids.end() ? npos : (*i).second;
+	}
+
+	// The id of f, allocating n slots for it if it is new, or if its
+	// address has been reused by a face with a different number of
+	// slots.
+	uint32_t insert(const face_t* f, size_t n)
+	{
+		std::pair<typename id_map_t::iterator, bool> r =
+				ids.insert(std::make_pair(f, uint32_t(ranges.size())));
+		if (!r.second)
+		{
+			if (ranges[(*r.first).second].n == n)
+			{
+				return (*r.first).second;
+			}
+			(*r.first).second = uint32_t(ranges.size());
+		}
+		ranges.push_back(range_t{ present.size(), n, 0 });
+		present.resize(present.size() + n, 0);
+		slots.resize(present.size() * row);
+		return (*r.first).second;
+	}
+
+	size_t size(uint32_t id) const { return ranges[id].n; }
+
+	// true if every slot of id holds a value.
+	bool complete(uint32_t id) const { return ranges[id].n_set == ranges[id].n; }
+
+	const attr_t* get(uint32_t id, size_t i) const
+	{
+		const range_t& r = ranges[id];
+		if (i >= r.n || !present[r.base + i])
+		{
+			return nullptr;
+		}
+		return &slots[(r.base + i) * row];
+	}
+
+	const attr_t* get(const face_t* f, size_t i) const
+	{
+		const uint32_t id = find(f);
+		return id == npos ? nullptr : get(id, i);
+	}
+
+	// The slots of id, in order. Only meaningful if complete(id).
+	const attr_t* values(uint32_t id) const
+	{
+		return &slots[ranges[id].base * row];
+	}
+
+	// Mark slot i of id as holding a value, and return it for writing.
+	attr_t* put(uint32_t id, size_t i)
+	{
+		range_t& r = ranges[id];
+		CARVE_ASSERT(i < r.n);
+		if (!present[r.base + i])
+		{
+			present[r.base + i] = 1;
+			++r.n_set;
+		}
+		return &slots[(r.base + i) * row];
+	}
+
+	void put(uint32_t id, size_t i, const attr_t& attr) { *put(id, i) = attr; }
+
+private:
+	struct range_t
+	{
+		size_t base;
+		size_t n;
+		size_t n_set;
+	};
+
+	using id_map_t = std::unordered_map<const face_t*, uint32_t>;
+
+	size_t row{1};
+	id_map_t ids;
+	std::vector<range_t> ranges;
+	std::vector<attr_t> slots;
+	std::vector<char> present;
+};
+
+template<typename attr_t>
+const uint32_t FaceStore<attr_t>::npos;
+
+// An original face projected into its own plane, with what is needed
+// to weight its corners for points on it: barycentric coefficients for
+// a triangle, mean value weights (see polyInterpolate) otherwise. The
+// output faces of one original face arrive together, so set() keeps
+// the previous projection if it is of the same, unmoved, face.
+class FaceProjection
+{
+public:
+	using face_t = carve::mesh::MeshSet<3>::face_t;
+	using vector_t = carve::geom::vector<3>;
+
+	static const size_t npos = ~size_t(0);
+
+	void set(const face_t* f)
+	{
+		if (f == face && unchanged())
+		{
+			return;
+		}
+		face = f;
+		project = f->project;
+		pos.clear();
+		proj.clear();
+		for (face_t::const_edge_iter_t e = f->begin(); e != f->end(); ++e)
+		{
+			pos.push_back(e->vert->v);
+			proj.push_back(project(e->vert->v));
+		}
+		tri = false;
+		if (pos.size() == 3)
+		{
+			e1 = proj[1] - proj[0];
+			e2 = proj[2] - proj[0];
+			const double det = carve::geom::cross(e1, e2);
+			if (fabs(det) > 1e-16)
+			{
+				inv_det = 1.0 / det;
+				tri = true;
+			}
+		}
+	}
+
+	size_t size() const { return pos.size(); }
+
+	// The corner at exactly p, or npos.
+	size_t corner(const vector_t& p) const
+	{
+		for (size_t i = 0; i < pos.size(); ++i)
+		{
+			if (pos[i] == p)
+			{
+				return i;
+			}
+		}
+		return npos;
+	}
+
+	void weights(const vector_t& p, std::vector<double>& w)
+	{
+		const carve::geom2d::P2 q = project(p);
+		if (tri)
+		{
+			const carve::geom2d::P2 d = q - proj[0];
+			w.resize(3);
+			w[1] = carve::geom::cross(d, e2) * inv_det;
+			w[2] = carve::geom::cross(e1, d) * inv_det;
+			w[0] = 1.0 - w[1] - w[2];
+			return;
+		}
+		polyInterpolate(proj, q, w, r, A, D);
+	}
+
+private:
+	const face_t* face{nullptr};
+	face_t::project_t project{nullptr};
+	std::vector<vector_t> pos;
+	std::vector<carve::geom2d::P2> proj;
+	bool tri{false};
+	carve::geom2d::P2 e1, e2;
+	double inv_det{0.0};
+	std::vector<double> r, A, D;
+
+	bool unchanged() const
+	{
+		if (face->nVertices() != pos.size())
+		{
+			return false;
+		}
+		size_t i = 0;
+		for (face_t::const_edge_iter_t e = face->begin(); e != face->end();
+				 ++e, ++i)
+		{
+			if (!(e->vert->v == pos[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+}
+
 class Interpolator
 {
 public:
@@ -249,71 +478,66 @@ public:
 	using key_t = std::pair<const meshset_t::face_t*, unsigned int>;
 
 protected:
-	using attrvmap_t = std::unordered_map<const meshset_t::vertex_t*, attr_t>;
-	using attrmap_t = std::unordered_map<key_t, attr_t, carve::hash_pair>;
+	using store_t = detail::FaceStore<attr_t>;
 
-	attrmap_t attrs;
+	store_t attrs;
+	detail::FaceProjection projection;
+	std::vector<double> weights;
 
 	void resultFace(const carve::csg::CSG& csg, const meshset_t::face_t* new_face,
 			const meshset_t::face_t* orig_face, bool flipped) override
 	{
-		std::vector<attr_t> vertex_attrs;
-		attrvmap_t base_attrs;
-		vertex_attrs.reserve(orig_face->nVertices());
-
-		for (meshset_t::face_t::const_edge_iter_t e = orig_face->begin();
-				 e != orig_face->end(); ++e)
+		const uint32_t orig = attrs.find(orig_face);
+		if (orig == store_t::npos || !attrs.complete(orig) ||
+				attrs.size(orig) != orig_face->nVertices())
 		{
-			typename attrmap_t::const_iterator a =
-					attrs.find(key_t(orig_face, e.idx()));
-			if (a == attrs.end())
-			{
-				return;
-			}
-			vertex_attrs.push_back((*a).second);
-			base_attrs[e->vert] = vertex_attrs.back();
+			return;
 		}
+		projection.set(orig_face);
 
+		const uint32_t id = attrs.insert(new_face, new_face->nVertices());
+		const attr_t* base = attrs.values(orig);
 		for (meshset_t::face_t::const_edge_iter_t e = new_face->begin();
 				 e != new_face->end(); ++e)
 		{
-			const meshset_t::vertex_t* vertex = e->vert;
-			typename attrvmap_t::const_iterator b = base_attrs.find(vertex);
-			if (b != base_attrs.end())
+			const size_t c = projection.corner(e->vert->v);
+			if (c != detail::FaceProjection::npos)
 			{
-				attrs[key_t(new_face, e.idx())] = (*b).second;
+				attrs.put(id, e.idx(), base[c]);
+				continue;
 			}
-			else
+			projection.weights(e->vert->v, weights);
+			attr_t attr = weights[0] * base[0];
+			for (size_t z = 1; z < weights.size(); ++z)
 			{
-				carve::geom2d::P2 p = orig_face->project(e->vert->v);
-				attr_t attr = interp(orig_face->begin(), orig_face->end(),
-						orig_face->projector(), vertex_attrs, p.x, p.y);
-				attrs[key_t(new_face, e.idx())] = attr;
+				attr += weights[z] * base[z];
 			}
+			attrs.put(id, e.idx(), attr);
 		}
 	}
 
 public:
 	bool hasAttribute(const meshset_t::face_t* f, unsigned v)
 	{
-		return attrs.find(key_t(f, v)) != attrs.end();
+		return attrs.get(f, v) != nullptr;
 	}
 
 	attr_t getAttribute(const meshset_t::face_t* f, unsigned v,
 			const attr_t& def = attr_t())
 	{
-		typename attrmap_t::const_iterator fv = attrs.find(key_t(f, v));
-		if (fv != attrs.end())
-		{
-			return (*fv).second;
-		}
-		return def;
+		const attr_t* a = attrs.get(f, v);
+		return a ? *a : def;
 	}
 
+	// Corners past the end of f are ignored.
 	void setAttribute(const meshset_t::face_t* f, unsigned v,
 			const attr_t& attr)
 	{
-		attrs[key_t(f, v)] = attr;
+		if (v >= f->nVertices())
+		{
+			return;
+		}
+		attrs.put(attrs.insert(f, f->nVertices()), v, attr);
 	}
 
 	FaceVertexAttr() : Interpolator() {}
@@ -321,6 +545,130 @@ public:
 	~FaceVertexAttr() override = default;
 };
 
+// Several per-corner attributes (texture coordinates, normals, colours
+// and so on) carried through a single hook. Each channel is a fixed
+// number of doubles, and the channels of a corner are packed into one
+// row, so the weights of a new vertex are computed once and applied to
+// the whole row. Channels must be added before any values are set.
+class FaceVertexChannels : public Interpolator
+{
+protected:
+	using store_t = detail::FaceStore<double>;
+
+	store_t attrs;
+	// channel c occupies [offsets[c], offsets[c + 1]) of each row.
+	std::vector<size_t> offsets{ 0 };
+	detail::FaceProjection projection;
+	std::vector<double> weights;
+
+	void resultFace(const carve::csg::CSG& csg, const meshset_t::face_t* new_face,
+			const meshset_t::face_t* orig_face, bool flipped) override
+	{
+		const uint32_t orig = attrs.find(orig_face);
+		if (orig == store_t::npos || !attrs.complete(orig) ||
+				attrs.size(orig) != orig_face->nVertices())
+		{
+			return;
+		}
+		projection.set(orig_face);
+
+		const size_t w = attrs.width();
+		const uint32_t id = attrs.insert(new_face, new_face->nVertices());
+		const double* base = attrs.values(orig);
+		for (meshset_t::face_t::const_edge_iter_t e = new_face->begin();
+				 e != new_face->end(); ++e)
+		{
+			double* out = attrs.put(id, e.idx());
+			const size_t c = projection.corner(e->vert->v);
+			if (c != detail::FaceProjection::npos)
+			{
+				std::copy(base + c * w, base + (c + 1) * w, out);
+				continue;
+			}
+			projection.weights(e->vert->v, weights);
+			for (size_t k = 0; k < w; ++k)
+			{
+				out[k] = weights[0] * base[k];
+			}
+			for (size_t z = 1; z < weights.size(); ++z)
+			{
+				const double wz = weights[z];
+				const double* b = base + z * w;
+				for (size_t k = 0; k < w; ++k)
+				{
+					out[k] += wz * b[k];
+				}
+			}
+		}
+	}
+
+public:
+	// Add a channel of width doubles, returning its index.
+	size_t addChannel(size_t width)
+	{
+		offsets.push_back(offsets.back() + width);
+		attrs.setWidth(offsets.back());
+		return offsets.size() - 2;
+	}
+
+	size_t nChannels() const { return offsets.size() - 1; }
+
+	size_t channelWidth(size_t ch) const { return offsets[ch + 1] - offsets[ch]; }
+
+	bool hasAttribute(const meshset_t::face_t* f, unsigned v) const
+	{
+		return attrs.get(f, v) != nullptr;
+	}
+
+	// The values of channel ch at corner v of f, or nullptr.
+	const double* getAttribute(const meshset_t::face_t* f, unsigned v,
+			size_t ch) const
+	{
+		const double* row = attrs.get(f, v);
+		return row ? row + offsets[ch] : nullptr;
+	}
+
+	template<unsigned ndim>
+	carve::geom::vector<ndim> getAttribute(const meshset_t::face_t* f,
+			unsigned v, size_t ch, const carve::geom::vector<ndim>& def) const
+	{
+		CARVE_ASSERT(channelWidth(ch) == ndim);
+		const double* vals = getAttribute(f, v, ch);
+		if (!vals)
+		{
+			return def;
+		}
+		carve::geom::vector<ndim> r;
+		std::copy(vals, vals + ndim, r.v);
+		return r;
+	}
+
+	// Channels of a corner that are never set are zero. Corners past the
+	// end of f are ignored.
+	void setAttribute(const meshset_t::face_t* f, unsigned v, size_t ch,
+			const double* vals)
+	{
+		if (v >= f->nVertices())
+		{
+			return;
+		}
+		double* row = attrs.put(attrs.insert(f, f->nVertices()), v);
+		std::copy(vals, vals + channelWidth(ch), row + offsets[ch]);
+	}
+
+	template<unsigned ndim>
+	void setAttribute(const meshset_t::face_t* f, unsigned v, size_t ch,
+			const carve::geom::vector<ndim>& val)
+	{
+		CARVE_ASSERT(channelWidth(ch) == ndim);
+		setAttribute(f, v, ch, val.v);
+	}
+
+	FaceVertexChannels() : Interpolator() {}
+
+	~FaceVertexChannels() override = default;
+};
+
 template<typename attr_t>
 class FaceEdgeAttr : public Interpolator
 {
@@ -330,11 +678,14 @@ public:
 protected:
 	using vpair_t = std::pair<const meshset_t::vertex_t*, const meshset_t::vertex_t*>;
 
-	using attrmap_t = std::unordered_map<key_t, attr_t, carve::hash_pair>;
-	using edgedivmap_t = std::unordered_map<vpair_t, key_t, carve::hash_pair>;
+	using store_t = detail::FaceStore<attr_t>;
+	// a face id in the store, and an edge index within it.
+	using slot_t = std::pair<uint32_t, unsigned>;
+	using edgedivmap_t = std::unordered_map<vpair_t, slot_t, carve::hash_pair>;
 
-	attrmap_t attrs;
+	store_t attrs;
 	edgedivmap_t edgediv;
+	std::vector<std::pair<vpair_t, unsigned>> undiv;
 
 	struct Hook : public Interpolator::Hook
 	{
@@ -359,13 +710,12 @@ protected:
 			const meshset_t::vertex_t* v1,
 			const meshset_t::vertex_t* v2) override
 	{
-		key_t k(orig_edge->face, orig_edge_idx);
-		typename attrmap_t::const_iterator attr_i = attrs.find(k);
-		if (attr_i == attrs.end())
+		const uint32_t id = attrs.find(orig_edge->face);
+		if (id == store_t::npos || !attrs.get(id, orig_edge_idx))
 		{
 			return;
 		}
-		edgediv[vpair_t(v1, v2)] = k;
+		edgediv[vpair_t(v1, v2)] = slot_t(id, unsigned(orig_edge_idx));
 	}
 
 	void processOutputFace(
@@ -373,31 +723,30 @@ protected:
 			std::vector<carve::mesh::MeshSet<3>::face_t*>& new_faces,
 			const meshset_t::face_t* orig_face, bool flipped) override
 	{
-		edgedivmap_t undiv;
+		const uint32_t orig = attrs.find(orig_face);
 
-		for (meshset_t::face_t::const_edge_iter_t e = orig_face->begin();
-				 e != orig_face->end(); ++e)
+		// the undivided edges of orig_face, sorted for lookup.
+		undiv.clear();
+		if (orig != store_t::npos)
 		{
-			key_t k(orig_face, e.idx());
-			typename attrmap_t::const_iterator attr_i = attrs.find(k);
-			if (attr_i == attrs.end())
-			{
-				continue;
-			}
-			else
+			for (meshset_t::face_t::const_edge_iter_t e = orig_face->begin();
+					 e != orig_face->end(); ++e)
 			{
-				undiv[vpair_t(e->v1(), e->v2())] = k;
+				if (attrs.get(orig, e.idx()))
+				{
+					undiv.push_back(std::make_pair(vpair_t(e->v1(), e->v2()), e.idx()));
+				}
 			}
+			std::sort(undiv.begin(), undiv.end());
 		}
 
 		for (size_t fnum = 0; fnum < new_faces.size(); ++fnum)
 		{
 			const carve::mesh::MeshSet<3>::face_t* new_face = new_faces[fnum];
+			uint32_t id = store_t::npos;
 			for (meshset_t::face_t::const_edge_iter_t e = new_face->begin();
 					 e != new_face->end(); ++e)
 			{
-				key_t k(new_face, e.idx());
-
 				vpair_t vp;
 				if (!flipped)
 				{
@@ -407,15 +756,32 @@ protected:
 				{
 					vp = vpair_t(e->v2(), e->v1());
 				}
-				typename edgedivmap_t::const_iterator vp_i;
-				if ((vp_i = undiv.find(vp)) != undiv.end())
+
+				slot_t src(store_t::npos, 0);
+				typename std::vector<std::pair<vpair_t, unsigned>>::const_iterator u =
+						std::lower_bound(undiv.begin(), undiv.end(),
+								std::make_pair(vp, unsigned(0)));
+				if (u != undiv.end() && (*u).first == vp)
 				{
-					attrs[k] = attrs[vp_i->second];
+					src = slot_t(orig, (*u).second);
 				}
-				else if ((vp_i = edgediv.find(vp)) != edgediv.end())
+				else
 				{
-					attrs[k] = attrs[vp_i->second];
+					typename edgedivmap_t::const_iterator vp_i = edgediv.find(vp);
+					if (vp_i == edgediv.end())
+					{
+						continue;
+					}
+					src = (*vp_i).second;
 				}
+
+				if (id == store_t::npos)
+				{
+					id = attrs.insert(new_face, new_face->nVertices());
+				}
+				// copied first: insert() may have moved the values.
+				const attr_t attr = *attrs.get(src.first, src.second);
+				attrs.put(id, e.idx(), attr);
 			}
 		}
 	}
@@ -423,24 +789,25 @@ protected:
 public:
 	bool hasAttribute(const meshset_t::face_t* f, unsigned e)
 	{
-		return attrs.find(std::make_pair(f, e)) != attrs.end();
+		return attrs.get(f, e) != nullptr;
 	}
 
 	attr_t getAttribute(const meshset_t::face_t* f, unsigned e,
 			const attr_t& def = attr_t())
 	{
-		typename attrmap_t::const_iterator fv = attrs.find(std::make_pair(f, e));
-		if (fv != attrs.end())
-		{
-			return (*fv).second;
-		}
-		return def;
+		const attr_t* a = attrs.get(f, e);
+		return a ? *a : def;
 	}
 
+	// Edges past the end of f are ignored.
 	void setAttribute(const meshset_t::face_t* f, unsigned e,
 			const attr_t& attr)
 	{
-		attrs[std::make_pair(f, e)] = attr;
+		if (e >= f->nVertices())
+		{
+			return;
+		}
+		attrs.put(attrs.insert(f, f->nVertices()), e, attr);
 	}
 
 	FaceEdgeAttr() : Interpolator() {}
@@ -455,45 +822,37 @@ public:
 	using key_t = const meshset_t::face_t*;
 
 protected:
-	struct key_hash
-	{
-		size_t operator()(const key_t& f) const { return size_t(f); }
-	};
-
-	using attrmap_t = std::unordered_map<key_t, attr_t, key_hash>;
+	using store_t = detail::FaceStore<attr_t>;
 
-	attrmap_t attrs;
+	store_t attrs;
 
 	void resultFace(const carve::csg::CSG& csg, const meshset_t::face_t* new_face,
 			const meshset_t::face_t* orig_face, bool flipped) override
 	{
-		typename attrmap_t::const_iterator i = attrs.find(key_t(orig_face));
-		if (i != attrs.end())
+		const uint32_t orig = attrs.find(orig_face);
+		if (orig != store_t::npos)
 		{
-			attrs[key_t(new_face)] = (*i).second;
+			const attr_t attr = *attrs.values(orig);
+			attrs.put(attrs.insert(new_face, 1), 0, attr);
 		}
 	}
 
 public:
 	bool hasAttribute(const meshset_t::face_t* f)
 	{
-		return attrs.find(key_t(f)) != attrs.end();
+		return attrs.get(f, 0) != nullptr;
 	}
 
 	attr_t getAttribute(const meshset_t::face_t* f,
 			const attr_t& def = attr_t())
 	{
-		typename attrmap_t::const_iterator i = attrs.find(key_t(f));
-		if (i != attrs.end())
-		{
-			return (*i).second;
-		}
-		return def;
+		const attr_t* a = attrs.get(f, 0);
+		return a ? *a : def;
 	}
 
 	void setAttribute(const meshset_t::face_t* f, const attr_t& attr)
 	{
-		attrs[key_t(f)] = attr;
+		attrs.put(attrs.insert(f, 1), 0, attr);
 	}
 
 	FaceAttr() : Interpolator() {}
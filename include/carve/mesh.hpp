@@ -30,6 +30,7 @@
 #include <carve/djset.hpp>
 #include <carve/geom.hpp>
 #include <carve/geom3d.hpp>
+#include <carve/parallel.hpp>
 #include <carve/rtree.hpp>
 #include <carve/tag.hpp>
 
@@ -373,6 +374,10 @@ public:
 
 	bool recalc();
 
+	// flip a freshly fitted plane so that it agrees with the winding
+	// of the edge loop, and set up the 2d projection.
+	void orientPlane();
+
 	void clearEdges();
 
 	// build an edge loop in forward orientation from an iterator pair
@@ -433,6 +438,24 @@ public:
 		recalc();
 	}
 
+	// Construct a face from an existing edge loop, and a previously
+	// computed plane (for example, one that has been deserialized),
+	// without refitting the plane.
+	Face(edge_t* e, const plane_t& _plane)
+			: edge(e), n_edges(0), mesh(nullptr), plane(_plane)
+	{
+		do
+		{
+			e->face = this;
+			n_edges++;
+			e = e->next;
+		} while (e != edge);
+
+		int da = carve::geom::largestAxis(plane.N);
+		project = getProjector(plane.N.v[da] > 0, da);
+		unproject = getUnprojector(plane.N.v[da] > 0, da);
+	}
+
 	Face(vertex_t* a, vertex_t* b, vertex_t* c)
 			: edge(nullptr), n_edges(0), mesh(nullptr)
 	{
@@ -551,7 +574,7 @@ class CARVE_API FaceStitcher
 	edge_map_t edges;
 	edge_map_t complex_edges;
 
-	carve::djset::djset face_groups;
+	carve::djset::concurrent_djset face_groups;
 	std::vector<bool> is_open;
 
 	edge_graph_t edge_graph;
@@ -655,6 +678,12 @@ public:
 };
 } // namespace detail
 
+// Recalculate the planes of a number of faces, in parallel. For
+// ndim == 3 the planes of triangles are computed in batches, which
+// gives the same result as Face::recalc() at a fraction of the cost.
+template<unsigned ndim>
+void recalcFaces(Face<ndim>* const* faces, size_t n_faces);
+
 // A Mesh is a connected set of faces. It may be open (some edges
 // have nullptr rev members), or closed. On destruction, a Mesh
 // should free its Faces (which will in turn free Edges, but not
@@ -690,11 +719,11 @@ public:
 
 	meshset_t* meshset;
 
-protected:
+	// Construct a mesh from faces whose edge lists and orientation
+	// are already known. Takes posession of the face pointers.
 	Mesh(std::vector<face_t*>& _faces, std::vector<edge_t*>& _open_edges,
 			std::vector<edge_t*>& _closed_edges, bool _is_negative);
 
-public:
 	explicit Mesh(std::vector<face_t*>& _faces);
 	~Mesh();
 
@@ -749,10 +778,7 @@ public:
 
 	void recalc()
 	{
-		for (size_t i = 0; i < faces.size(); ++i)
-		{
-			faces[i]->recalc();
-		}
+		recalcFaces(faces.data(), faces.size());
 		calcOrientation();
 	}
 
@@ -358,6 +358,13 @@ bool Face<ndim>::recalc()
 		return false;
 	}
 
+	orientPlane();
+	return true;
+}
+
+template<unsigned ndim>
+void Face<ndim>::orientPlane()
+{
 	int da = carve::geom::largestAxis(plane.N);
 	double A = carve::geom2d::signedArea(
 			begin(), end(), projection_mapping(getProjector(false, da)));
@@ -369,8 +376,78 @@ bool Face<ndim>::recalc()
 
 	project = getProjector(plane.N.v[da] > 0, da);
 	unproject = getUnprojector(plane.N.v[da] > 0, da);
+}
 
-	return true;
+template<unsigned ndim>
+void recalcFaces(Face<ndim>* const* faces, size_t n_faces)
+{
+	carve::parallel::for_each_index(0, n_faces, 1024, [&](size_t i) {
+		faces[i]->recalc();
+	});
+}
+
+template<>
+inline void recalcFaces(Face<3>* const* faces, size_t n_faces)
+{
+	carve::parallel::for_chunks(0, n_faces, 1024, [&](size_t lo, size_t hi, size_t) {
+		// triangle coordinates are gathered into separate arrays, so
+		// that the plane computation below vectorises. The arithmetic
+		// follows carve::geom3d::fitPlane() step for step.
+		const size_t B = 64;
+		double x[3][B], y[3][B], z[3][B];
+		double nx[B], ny[B], nz[B], d[B];
+		Face<3>* tri[B];
+
+		size_t i = lo;
+		while (i < hi)
+		{
+			size_t n = 0;
+			for (; i < hi && n < B; ++i)
+			{
+				Face<3>* f = faces[i];
+				if (f->n_edges != 3)
+				{
+					f->recalc();
+					continue;
+				}
+				const Edge<3>* e = f->edge;
+				for (size_t k = 0; k < 3; ++k, e = e->next)
+				{
+					x[k][n] = e->vert->v.x;
+					y[k][n] = e->vert->v.y;
+					z[k][n] = e->vert->v.z;
+				}
+				tri[n++] = f;
+			}
+
+			for (size_t j = 0; j < n; ++j)
+			{
+				const double ax = x[1][j] - x[0][j], ay = y[1][j] - y[0][j], az = z[1][j] - z[0][j];
+				const double bx = x[2][j] - x[0][j], by = y[2][j] - y[0][j], bz = z[2][j] - z[0][j];
+				double Nx = +(ay * bz - az * by);
+				double Ny = -(ax * bz - az * bx);
+				double Nz = +(ax * by - ay * bx);
+				const double l = std::sqrt(0.0 + Nx * Nx + Ny * Ny + Nz * Nz);
+				Nx = l == 0.0 ? 1.0 : Nx / l;
+				Ny = l == 0.0 ? 0.0 : Ny / l;
+				Nz = l == 0.0 ? 0.0 : Nz / l;
+				const double Cx = (0.0 + x[0][j] + x[1][j] + x[2][j]) / 3.0;
+				const double Cy = (0.0 + y[0][j] + y[1][j] + y[2][j]) / 3.0;
+				const double Cz = (0.0 + z[0][j] + z[1][j] + z[2][j]) / 3.0;
+				nx[j] = Nx;
+				ny[j] = Ny;
+				nz[j] = Nz;
+				d[j] = -(0.0 + Nx * Cx + Ny * Cy + Nz * Cz);
+			}
+
+			for (size_t j = 0; j < n; ++j)
+			{
+				tri[j]->plane.N = carve::geom::VECTOR(nx[j], ny[j], nz[j]);
+				tri[j]->plane.d = d[j];
+				tri[j]->orientPlane();
+			}
+		}
+	});
 }
 
 template<unsigned ndim>
@@ -667,12 +744,13 @@ void FaceStitcher::build(iter_t begin, iter_t end,
 		mesh_faces[index_set[face->id]].push_back(face);
 	}
 
+	// meshes are independent of each other, so they can be
+	// constructed concurrently.
 	meshes.clear();
-	meshes.reserve(mesh_faces.size());
-	for (size_t i = 0; i < mesh_faces.size(); ++i)
-	{
-		meshes.push_back(new Mesh<3>(mesh_faces[i]));
-	}
+	meshes.resize(mesh_faces.size());
+	carve::parallel::for_each_index(0, mesh_faces.size(), 16, [&](size_t i) {
+		meshes[i] = new Mesh<3>(mesh_faces[i]);
+	});
 }
 
 template<typename iter_t>
@@ -790,22 +868,32 @@ void Mesh<ndim>::calcOrientation()
 		return;
 	}
 
-	edge_t* emin = closed_edges[0];
-
-	if (emin->rev->v1()->v < emin->v1()->v)
-	{
-		emin = emin->rev;
-	}
-
-	for (size_t i = 1; i < closed_edges.size(); ++i)
-	{
-		if (closed_edges[i]->v1()->v < emin->v1()->v)
+	// find the first edge starting at the lexicographically smallest
+	// vertex. Each chunk finds its own first minimum, and combining
+	// them in order gives the same edge as a serial scan.
+	std::vector<edge_t*> chunk_min(carve::parallel::chunkCount(closed_edges.size(), 16384));
+	carve::parallel::for_chunks(0, closed_edges.size(), 16384, [&](size_t lo, size_t hi, size_t c) {
+		edge_t* e_min = closed_edges[lo];
+		for (size_t i = lo; i < hi; ++i)
 		{
-			emin = closed_edges[i];
+			if (closed_edges[i]->v1()->v < e_min->v1()->v)
+			{
+				e_min = closed_edges[i];
+			}
+			if (closed_edges[i]->rev->v1()->v < e_min->v1()->v)
+			{
+				e_min = closed_edges[i]->rev;
+			}
 		}
-		if (closed_edges[i]->rev->v1()->v < emin->v1()->v)
+		chunk_min[c] = e_min;
+	});
+
+	edge_t* emin = chunk_min[0];
+	for (size_t c = 1; c < chunk_min.size(); ++c)
+	{
+		if (chunk_min[c]->v1()->v < emin->v1()->v)
 		{
-			emin = closed_edges[i]->rev;
+			emin = chunk_min[c];
 		}
 	}
 
@@ -937,22 +1025,29 @@ MeshSet<ndim>::MeshSet(
 		vertex_storage.push_back(vertex_t(points[i]));
 	}
 
-	std::vector<vertex_t*> v;
+	// locate each face in face_indices, then build the faces (and fit
+	// their planes) in parallel.
+	std::vector<size_t> offsets;
+	offsets.reserve(n_faces);
 	size_t p = 0;
 	for (size_t i = 0; i < n_faces; ++i)
 	{
 		CARVE_ASSERT(face_indices[p] > 1);
+		offsets.push_back(p);
+		p += (size_t)face_indices[p] + 1;
+	}
+	CARVE_ASSERT(p == face_indices.size());
 
-		const size_t N = (size_t)face_indices[p++];
-		v.clear();
-		v.reserve(N);
-		for (size_t j = 0; j < N; ++j)
+	faces.resize(n_faces);
+	carve::parallel::for_each_index(0, n_faces, 1024, [&](size_t i) {
+		const int* idx = &face_indices[offsets[i]];
+		std::vector<vertex_t*> v(idx[0]);
+		for (int j = 0; j < idx[0]; ++j)
 		{
-			v.push_back(&vertex_storage[face_indices[p++]]);
+			v[j] = &vertex_storage[idx[j + 1]];
 		}
-		faces.push_back(new face_t(v.begin(), v.end()));
-	}
-	CARVE_ASSERT(p == face_indices.size());
+		faces[i] = new face_t(v.begin(), v.end());
+	});
 	mesh_t::create(faces.begin(), faces.end(), meshes, opts);
 
 	for (size_t i = 0; i < meshes.size(); ++i)
@@ -1249,40 +1344,56 @@ void MeshSet<ndim>::canonicalize()
 template<unsigned ndim>
 void MeshSet<ndim>::separateMeshes()
 {
-	size_t n;
-	using vmap_t = std::unordered_map<std::pair<mesh_t*, vertex_t*>, vertex_t*, carve::hash_pair>;
-	vmap_t vmap;
-	typename vmap_t::iterator vmap_iter;
-
-	for (face_iter i = faceBegin(); i != faceEnd(); ++i)
-	{
-		face_t* f = *i;
-		for (typename face_t::edge_iter_t j = f->begin(); j != f->end(); ++j)
+	// each mesh gets its own copy of the vertices it uses, in order of
+	// first use. the meshes are processed in parallel: first to find
+	// their vertices, and then (once each mesh knows where its
+	// vertices start in the new storage) to copy and relink them.
+	using vmap_t = std::unordered_map<vertex_t*, size_t>;
+	std::vector<std::vector<vertex_t*>> mesh_verts(meshes.size());
+	std::vector<vmap_t> mesh_vmap(meshes.size());
+
+	carve::parallel::for_each_index(0, meshes.size(), 1, [&](size_t m) {
+		vmap_t& vmap = mesh_vmap[m];
+		mesh_t* mesh = meshes[m];
+		for (size_t i = 0; i < mesh->faces.size(); ++i)
 		{
-			edge_t& e = *j;
-			vmap[std::make_pair(f->mesh, e.vert)] = e.vert;
+			face_t* f = mesh->faces[i];
+			for (typename face_t::edge_iter_t j = f->begin(); j != f->end(); ++j)
+			{
+				if (vmap.insert(std::make_pair(j->vert, vmap.size())).second)
+				{
+					mesh_verts[m].push_back(j->vert);
+				}
+			}
 		}
-	}
-
-	std::vector<vertex_t> vout;
-	vout.reserve(vmap.size());
+	});
 
-	for (n = 0, vmap_iter = vmap.begin(); vmap_iter != vmap.end();
-			 ++vmap_iter, ++n)
+	std::vector<size_t> base(meshes.size() + 1, 0);
+	for (size_t m = 0; m < meshes.size(); ++m)
 	{
-		vout.push_back(*(*vmap_iter).second);
-		(*vmap_iter).second = &vout.back();
+		base[m + 1] = base[m] + mesh_verts[m].size();
 	}
 
-	for (face_iter i = faceBegin(); i != faceEnd(); ++i)
-	{
-		face_t* f = *i;
-		for (typename face_t::edge_iter_t j = f->begin(); j != f->end(); ++j)
+	std::vector<vertex_t> vout(base.back());
+
+	carve::parallel::for_each_index(0, meshes.size(), 1, [&](size_t m) {
+		vertex_t* mesh_vout = vout.data() + base[m];
+		for (size_t i = 0; i < mesh_verts[m].size(); ++i)
 		{
-			edge_t& e = *j;
-			e.vert = vmap[std::make_pair(f->mesh, e.vert)];
+			mesh_vout[i] = *mesh_verts[m][i];
 		}
-	}
+		const vmap_t& vmap = mesh_vmap[m];
+		mesh_t* mesh = meshes[m];
+		for (size_t i = 0; i < mesh->faces.size(); ++i)
+		{
+			face_t* f = mesh->faces[i];
+			for (typename face_t::edge_iter_t j = f->begin(); j != f->end(); ++j)
+			{
+				j->vert = mesh_vout + vmap.find(j->vert)->second;
+			}
+		}
+		vmap_t().swap(mesh_vmap[m]);
+	});
 
 	vertex_storage.swap(vout);
 }
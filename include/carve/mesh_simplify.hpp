@@ -26,18 +26,22 @@
 
 #include <carve/carve.hpp>
 
+#include <carve/bvh.hpp>
 #include <carve/geom2d.hpp>
 #include <carve/heap.hpp>
 #include <carve/mesh.hpp>
 #include <carve/mesh_ops.hpp>
+#include <carve/parallel.hpp>
 #include <carve/rtree.hpp>
 #include <carve/triangle_intersection.hpp>
 
 #include <algorithm>
 #include <fstream>
 #include <functional>
+#include <limits>
 #include <set>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -57,16 +61,23 @@ class MeshSimplifier
 	using aabb_t = face_t::aabb_t;
 
 	using face_rtree_t = carve::geom::RTreeNode<3, carve::mesh::Face<3>*>;
+	using face_bvh_t = carve::geom::DynamicBVH<3, face_t*>;
 
 	struct EdgeInfo
 	{
 		edge_t* edge{nullptr};
+		// ids of the ends of the edge, while edges are being collapsed.
+		uint32_t vert_id[2];
 		double delta_v;
 
 		double c[4];
 		double l[2], t1[2], t2[2];
 		size_t heap_idx = 0;
 
+		// quadric error of collapsing the edge, and the point to collapse to.
+		double cost{0.0};
+		vector_t target;
+
 		void update()
 		{
 			const vertex_t* v1 = edge->vert;
@@ -291,26 +302,14 @@ class MeshSimplifier
 		explicit EdgeMerger(double _min_edgelen) : min_edgelen(_min_edgelen) {}
 
 		double score(const EdgeInfo* e) const { return min_edgelen - e->l[0]; }
-
-		class Priority
-		{
-			Priority& operator=(const Priority&) = delete;
-
-		public:
-			const EdgeMerger& merger;
-			explicit Priority(const EdgeMerger& _merger) : merger(_merger) {}
-			bool operator()(const EdgeInfo* a, const EdgeInfo* b) const
-			{
-				// collapse edges in order from shortest to longest.
-				return merger.score(a) < merger.score(b);
-			}
-		};
-
-		Priority priority() const { return Priority(*this); }
 	};
 
-	using edge_info_map_t = std::unordered_map<edge_t*, EdgeInfo*>;
-	std::unordered_map<edge_t*, EdgeInfo*> edge_info;
+	// Edge info is kept contiguously, in the order edges were added.
+	// While edges are collapsed it is indexed by position (the edge id),
+	// and the info of removed edges is left in place with a null edge.
+	// edge_index maps edges to their info, for edge flipping.
+	std::vector<EdgeInfo> edge_info;
+	std::unordered_map<edge_t*, EdgeInfo*> edge_index;
 
 	void initEdgeInfo(mesh_t* mesh)
 	{
@@ -319,12 +318,25 @@ class MeshSimplifier
 			edge_t* e = mesh->faces[i]->edge;
 			do
 			{
-				edge_info[e] = new EdgeInfo(e);
+				edge_info.emplace_back(e);
 				e = e->next;
 			} while (e != mesh->faces[i]->edge);
 		}
 	}
 
+	void initEdgeInfo(const std::vector<face_t*>& faces)
+	{
+		for (size_t i = 0; i < faces.size(); ++i)
+		{
+			edge_t* e = faces[i]->edge;
+			do
+			{
+				edge_info.emplace_back(e);
+				e = e->next;
+			} while (e != faces[i]->edge);
+		}
+	}
+
 	void initEdgeInfo(meshset_t* meshset)
 	{
 		for (size_t m = 0; m < meshset->meshes.size(); ++m)
@@ -336,19 +348,59 @@ class MeshSimplifier
 
 	void clearEdgeInfo()
 	{
-		for (edge_info_map_t::iterator i = edge_info.begin(); i != edge_info.end();
-				 ++i)
+		edge_info.clear();
+		edge_index.clear();
+	}
+
+	// Drop the info of removed edges, which renumbers the rest.
+	void compactEdgeInfo()
+	{
+		edge_info.erase(std::remove_if(edge_info.begin(), edge_info.end(),
+												[](const EdgeInfo& e) { return e.edge == nullptr; }),
+				edge_info.end());
+	}
+
+	void indexEdgeInfo()
+	{
+		edge_index.clear();
+		edge_index.reserve(edge_info.size());
+		for (EdgeInfo& e : edge_info)
+		{
+			edge_index[e.edge] = &e;
+		}
+	}
+
+	// The faces being simplified, kept up to date by the passes that
+	// modify them, and shared between passes.
+	face_bvh_t face_index;
+
+	template<typename iter_t>
+	void initFaceIndex(iter_t begin, iter_t end)
+	{
+		std::vector<face_t*> faces;
+		for (iter_t i = begin; i != end; ++i)
 		{
-			delete (*i).second;
+			if ((*i)->nEdges() != 0)
+			{
+				faces.push_back(*i);
+			}
 		}
+		face_index.build(faces.begin(), faces.end());
+	}
+
+	void initFaceIndex(meshset_t* meshset)
+	{
+		initFaceIndex(meshset->faceBegin(), meshset->faceEnd());
 	}
 
+	void clearFaceIndex() { face_index.clear(); }
+
 	void updateEdgeFlipHeap(std::vector<EdgeInfo*>& edge_heap, edge_t* edge,
 			const FlippableBase& flipper)
 	{
 		std::unordered_map<edge_t*, EdgeInfo*>::const_iterator i =
-				edge_info.find(edge);
-		CARVE_ASSERT(i != edge_info.end());
+				edge_index.find(edge);
+		CARVE_ASSERT(i != edge_index.end());
 		EdgeInfo* e = (*i).second;
 
 		bool heap_pre = e->heap_idx != ~0U;
@@ -617,19 +669,16 @@ class MeshSimplifier
 
 	size_t flipEdges(meshset_t* mesh, const FlippableBase& flipper)
 	{
-		face_rtree_t* tree =
-				face_rtree_t::construct_STR(mesh->faceBegin(), mesh->faceEnd(), 4, 4);
-
 		size_t n_mods = 0;
 
 		std::vector<EdgeInfo*> edge_heap;
 
 		edge_heap.reserve(edge_info.size());
+		indexEdgeInfo();
 
-		for (edge_info_map_t::iterator i = edge_info.begin(); i != edge_info.end();
-				 ++i)
+		for (EdgeInfo& info : edge_info)
 		{
-			EdgeInfo* e = (*i).second;
+			EdgeInfo* e = &info;
 			e->update();
 			if (e->edge->v1() < e->edge->v2() && flipper.canFlip(e))
 			{
@@ -667,7 +716,7 @@ class MeshSimplifier
 			aabb.unionAABB(e->edge->rev->face->getAABB());
 
 			std::vector<face_t*> overlapping;
-			tree->search(aabb, std::back_inserter(overlapping));
+			face_index.search(aabb, std::back_inserter(overlapping));
 
 			// overlapping.erase(e->edge->face);
 			// overlapping.erase(e->edge->rev->face);
@@ -692,12 +741,13 @@ class MeshSimplifier
 
 			n_mods++;
 			CARVE_ASSERT(flipper.canFlip(e));
-			edge_info[e->edge]->update();
-			edge_info[e->edge->rev]->update();
+			e->update();
+			edge_index[e->edge->rev]->update();
 
 			carve::mesh::flipTriEdge(e->edge);
 
-			tree->updateExtents(aabb);
+			face_index.update(e->edge->face);
+			face_index.update(e->edge->rev->face);
 
 			updateEdgeFlipHeap(edge_heap, e->edge, flipper);
 			updateEdgeFlipHeap(edge_heap, e->edge->rev, flipper);
@@ -714,192 +764,354 @@ class MeshSimplifier
 			updateEdgeFlipHeap(edge_heap, e->edge->rev->next->next->rev, flipper);
 		}
 
-		delete tree;
-
 		return n_mods;
 	}
 
-	void removeFromEdgeMergeHeap(std::vector<EdgeInfo*>& edge_heap,
-			EdgeInfo* edge, const EdgeMerger& merger)
+	using edge_heap_t = carve::heap::indexed_heap<double>;
+
+	// The edges incident to each vertex, by id, in CSR form: each vertex
+	// has a range of ids. Removed edges are deleted lazily, by dropping
+	// them when the range is next read. Merging a vertex into another
+	// appends its range, moving the result to the end of ids if it does
+	// not fit.
+	struct VertexEdges
 	{
-		if (edge->heap_idx != ~0U)
+		struct Range
 		{
-			CARVE_ASSERT(edge_heap[edge->heap_idx] == edge);
-			carve::heap::remove_heap(edge_heap.begin(), edge_heap.end(),
-					edge_heap.begin() + edge->heap_idx,
-					merger.priority(), EdgeInfo::NotifyPos());
-			CARVE_ASSERT(edge_heap.back() == edge);
-			edge_heap.pop_back();
-			edge->heap_idx = ~0U;
+			uint32_t begin, size, capacity;
+		};
+
+		std::vector<Range> ranges;
+		std::vector<uint32_t> ids;
+
+		// The edges still incident to v, valid until the next merge.
+		std::pair<uint32_t*, uint32_t*> live(uint32_t v,
+				const std::vector<EdgeInfo>& info)
+		{
+			Range& r = ranges[v];
+			uint32_t* p = ids.data() + r.begin;
+			uint32_t n = 0;
+			for (uint32_t i = 0; i < r.size; ++i)
+			{
+				if (info[p[i]].edge != nullptr)
+				{
+					p[n++] = p[i];
+				}
+			}
+			r.size = n;
+			return std::make_pair(p, p + n);
 		}
-	}
 
-	void updateEdgeMergeHeap(std::vector<EdgeInfo*>& edge_heap, EdgeInfo* edge,
-			const EdgeMerger& merger)
+		void merge(uint32_t from, uint32_t to, const std::vector<EdgeInfo>& info)
+		{
+			live(from, info);
+			live(to, info);
+			Range& f = ranges[from];
+			Range& t = ranges[to];
+			if (t.size + f.size > t.capacity)
+			{
+				const uint32_t begin = uint32_t(ids.size());
+				t.capacity = 2 * (t.size + f.size);
+				ids.resize(ids.size() + t.capacity);
+				std::copy(ids.begin() + t.begin, ids.begin() + t.begin + t.size,
+						ids.begin() + begin);
+				t.begin = begin;
+			}
+			std::copy(ids.begin() + f.begin, ids.begin() + f.begin + f.size,
+					ids.begin() + t.begin + t.size);
+			t.size += f.size;
+			f.size = 0;
+		}
+	};
+
+	// Number the ends of the edges that have edge info, and build their
+	// adjacency. Returns the vertices by id.
+	std::vector<vertex_t*> initVertexEdges(VertexEdges& adj)
 	{
-		bool heap_pre = edge->heap_idx != ~0U;
-		edge->update();
-		bool heap_post = merger.canMerge(edge);
+		std::unordered_map<vertex_t*, uint32_t> vert_ids;
+		std::vector<vertex_t*> verts;
+		vert_ids.reserve(edge_info.size() / 2);
+		for (EdgeInfo& e : edge_info)
+		{
+			for (unsigned k = 0; k < 2; ++k)
+			{
+				vertex_t* v = k ? e.edge->v2() : e.edge->v1();
+				auto i = vert_ids.emplace(v, uint32_t(verts.size()));
+				if (i.second)
+				{
+					verts.push_back(v);
+				}
+				e.vert_id[k] = i.first->second;
+			}
+		}
 
-		if (!heap_pre && heap_post)
+		adj.ranges.assign(verts.size(), VertexEdges::Range{0, 0, 0});
+		for (const EdgeInfo& e : edge_info)
 		{
-			edge_heap.push_back(edge);
-			carve::heap::push_heap(edge_heap.begin(), edge_heap.end(),
-					merger.priority(), EdgeInfo::NotifyPos());
+			adj.ranges[e.vert_id[0]].capacity++;
+			adj.ranges[e.vert_id[1]].capacity++;
 		}
-		else if (heap_pre && !heap_post)
+		uint32_t n = 0;
+		for (auto& r : adj.ranges)
 		{
-			CARVE_ASSERT(edge_heap[edge->heap_idx] == edge);
-			carve::heap::remove_heap(edge_heap.begin(), edge_heap.end(),
-					edge_heap.begin() + edge->heap_idx,
-					merger.priority(), EdgeInfo::NotifyPos());
-			CARVE_ASSERT(edge_heap.back() == edge);
-			edge_heap.pop_back();
-			edge->heap_idx = ~0U;
+			r.begin = n;
+			n += r.capacity;
 		}
-		else if (heap_pre && heap_post)
+		adj.ids.resize(n);
+		for (uint32_t i = 0; i < edge_info.size(); ++i)
 		{
-			CARVE_ASSERT(edge_heap[edge->heap_idx] == edge);
-			carve::heap::adjust_heap(edge_heap.begin(), edge_heap.end(),
-					edge_heap.begin() + edge->heap_idx,
-					merger.priority(), EdgeInfo::NotifyPos());
-			CARVE_ASSERT(edge_heap[edge->heap_idx] == edge);
+			for (unsigned k = 0; k < 2; ++k)
+			{
+				auto& r = adj.ranges[edge_info[i].vert_id[k]];
+				adj.ids[r.begin + r.size++] = i;
+			}
 		}
+		return verts;
 	}
 
-	// collapse edges edges based upon the predicate implemented by EdgeMerger.
-	size_t collapseEdges(meshset_t* mesh, const EdgeMerger& merger)
+	uint32_t edgeId(const EdgeInfo* e) const
 	{
-		face_rtree_t* tree =
-				face_rtree_t::construct_STR(mesh->faceBegin(), mesh->faceEnd(), 4, 4);
-
-		size_t n_mods = 0;
+		return uint32_t(e - edge_info.data());
+	}
 
-		std::vector<EdgeInfo*> edge_heap;
-		std::unordered_map<vertex_t*, std::set<EdgeInfo*>> vert_to_edges;
+	// The state of a candidate collapse of v1 into v2, reused between
+	// collapses.
+	struct Collapse
+	{
+		vertex_t *v1, *v2;
+		uint32_t v1_id, v2_id;
+		std::vector<EdgeInfo*> edges_to_merge;
+		std::vector<EdgeInfo*> v1_incident;
+		std::vector<EdgeInfo*> v2_incident;
+		std::vector<face_t*> affected_faces;
+		std::vector<face_t*> near_faces;
+		std::vector<const vertex_t*> n1, n2;
+		std::vector<edge_t*> removed;
+	};
 
-		edge_heap.reserve(edge_info.size());
+	// Split the edges around the ends of e into those joining them, and
+	// those incident to one end only.
+	void gatherCollapse(Collapse& c, const EdgeInfo* e, VertexEdges& adj)
+	{
+		c.v1 = e->edge->v1();
+		c.v2 = e->edge->v2();
+		c.v1_id = e->vert_id[0];
+		c.v2_id = e->vert_id[1];
+		c.edges_to_merge.clear();
+		c.v1_incident.clear();
+		c.v2_incident.clear();
 
-		for (edge_info_map_t::iterator i = edge_info.begin(); i != edge_info.end();
-				 ++i)
+		auto r1 = adj.live(c.v1_id, edge_info);
+		for (const uint32_t* i = r1.first; i != r1.second; ++i)
+		{
+			EdgeInfo* f = &edge_info[*i];
+			const uint32_t other = f->vert_id[f->vert_id[0] == c.v1_id ? 1 : 0];
+			(other == c.v2_id ? c.edges_to_merge : c.v1_incident).push_back(f);
+		}
+		auto r2 = adj.live(c.v2_id, edge_info);
+		for (const uint32_t* i = r2.first; i != r2.second; ++i)
 		{
-			EdgeInfo* e = (*i).second;
+			EdgeInfo* f = &edge_info[*i];
+			const uint32_t other = f->vert_id[f->vert_id[0] == c.v2_id ? 1 : 0];
+			if (other != c.v1_id)
+			{
+				c.v2_incident.push_back(f);
+			}
+		}
+	}
 
-			vert_to_edges[e->edge->v1()].insert(e);
-			vert_to_edges[e->edge->v2()].insert(e);
+	// The faces of the edges around the ends of a collapse, sorted.
+	static void collectAffectedFaces(Collapse& c, bool with_rev)
+	{
+		c.affected_faces.clear();
+		for (const std::vector<EdgeInfo*>* v :
+				{ &c.edges_to_merge, &c.v1_incident, &c.v2_incident })
+		{
+			for (const EdgeInfo* f : *v)
+			{
+				c.affected_faces.push_back(f->edge->face);
+				if (with_rev && f->edge->rev != nullptr)
+				{
+					c.affected_faces.push_back(f->edge->rev->face);
+				}
+			}
+		}
+		std::sort(c.affected_faces.begin(), c.affected_faces.end());
+		c.affected_faces.erase(
+				std::unique(c.affected_faces.begin(), c.affected_faces.end()),
+				c.affected_faces.end());
+	}
 
-			if (merger.canMerge(e))
+	EdgeInfo* findEdgeInfo(VertexEdges& adj, uint32_t v, const edge_t* edge)
+	{
+		auto r = adj.live(v, edge_info);
+		for (const uint32_t* i = r.first; i != r.second; ++i)
+		{
+			if (edge_info[*i].edge == edge)
 			{
-				edge_heap.push_back(e);
+				return &edge_info[*i];
 			}
-			else
+		}
+		return nullptr;
+	}
+
+	// Carry out a collapse, once v2 has been moved into place: point the
+	// edges of v1 at v2, remove the edges joining them, along with the
+	// faces that are left with two edges, from the mesh, edge_heap and
+	// the face index, and refit the faces that remain. Returns the number
+	// of faces removed.
+	size_t applyCollapse(Collapse& c, VertexEdges& adj, edge_heap_t& edge_heap)
+	{
+		for (EdgeInfo* e : c.v1_incident)
+		{
+			if (e->edge->vert == c.v1)
 			{
-				e->heap_idx = ~0U;
+				e->edge->vert = c.v2;
 			}
+			e->vert_id[e->vert_id[0] == c.v1_id ? 0 : 1] = c.v2_id;
 		}
 
-		carve::heap::make_heap(edge_heap.begin(), edge_heap.end(),
-				merger.priority(), EdgeInfo::NotifyPos());
+		c.removed.clear();
+		for (EdgeInfo* e : c.edges_to_merge)
+		{
+			edge_heap.remove(edgeId(e));
+			c.removed.push_back(e->edge);
+			e->edge = nullptr;
+		}
+		adj.merge(c.v1_id, c.v2_id, edge_info);
 
-		while (!edge_heap.empty())
+		size_t n_removed = 0;
+		for (edge_t* edge : c.removed)
 		{
-			//           std::cerr << "test" << std::endl;
-			//           for (size_t m = 0; m < mesh->meshes.size(); ++m) {
-			//             for (size_t f = 0; f < mesh->meshes[m]->faces.size(); ++f)
-			//             {
-			//               if (mesh->meshes[m]->faces[f]->edge)
-			//               mesh->meshes[m]->faces[f]->edge->validateLoop();
-			//             }
-			//           }
-			carve::heap::pop_heap(edge_heap.begin(), edge_heap.end(),
-					merger.priority(), EdgeInfo::NotifyPos());
-			EdgeInfo* e_current = edge_heap.back();
-			edge_heap.pop_back();
-			e_current->heap_idx = ~0U;
+			face_t* f1 = edge->face;
 
-			edge_t* edge = e_current->edge;
-			vertex_t* v1 = edge->v1();
-			vertex_t* v2 = edge->v2();
+			edge->removeHalfEdge();
 
-			std::set<face_t*> affected_faces;
-			for (std::set<EdgeInfo*>::iterator f = vert_to_edges[v1].begin();
-					 f != vert_to_edges[v1].end(); ++f)
+			if (f1->n_edges == 2)
 			{
-				affected_faces.insert((*f)->edge->face);
-				affected_faces.insert((*f)->edge->rev->face);
+				edge_t* e1 = f1->edge;
+				edge_t* e2 = f1->edge->next;
+				if (e1->rev)
+				{
+					e1->rev->rev = e2->rev;
+				}
+				if (e2->rev)
+				{
+					e2->rev->rev = e1->rev;
+				}
+				EdgeInfo* e1i = findEdgeInfo(adj, c.v2_id, e1);
+				EdgeInfo* e2i = findEdgeInfo(adj, c.v2_id, e2);
+				CARVE_ASSERT(e1i != nullptr);
+				CARVE_ASSERT(e2i != nullptr);
+				edge_heap.remove(edgeId(e1i));
+				edge_heap.remove(edgeId(e2i));
+				e1i->edge = nullptr;
+				e2i->edge = nullptr;
+				face_index.remove(f1);
+				f1->clearEdges();
+				++n_removed;
 			}
-			for (std::set<EdgeInfo*>::iterator f = vert_to_edges[v2].begin();
-					 f != vert_to_edges[v2].end(); ++f)
+		}
+
+		for (face_t* face : c.affected_faces)
+		{
+			if (face->nEdges() != 0)
+			{
+				face_index.update(face);
+			}
+		}
+		return n_removed;
+	}
+
+	void updateEdgeMergeHeap(edge_heap_t& edge_heap, uint32_t id,
+			const EdgeMerger& merger)
+	{
+		EdgeInfo* edge = &edge_info[id];
+		edge->update();
+		if (merger.canMerge(edge))
+		{
+			// collapse edges in order from shortest to longest.
+			edge_heap.update(id, -merger.score(edge));
+		}
+		else
+		{
+			edge_heap.remove(id);
+		}
+	}
+
+	// collapse edges edges based upon the predicate implemented by EdgeMerger.
+	size_t collapseEdges(meshset_t* mesh, const EdgeMerger& merger)
+	{
+		size_t n_mods = 0;
+
+		VertexEdges adj;
+		initVertexEdges(adj);
+
+		edge_heap_t edge_heap(edge_info.size());
+		std::vector<edge_heap_t::entry_t> entries;
+		for (uint32_t i = 0; i < edge_info.size(); ++i)
+		{
+			if (merger.canMerge(&edge_info[i]))
 			{
-				affected_faces.insert((*f)->edge->face);
-				affected_faces.insert((*f)->edge->rev->face);
+				entries.emplace_back(-merger.score(&edge_info[i]), i);
 			}
+		}
+		edge_heap.assign(std::move(entries));
 
-			std::vector<EdgeInfo*> edges_to_merge;
-			std::vector<EdgeInfo*> v1_incident;
-			std::vector<EdgeInfo*> v2_incident;
+		Collapse c;
 
-			std::set_intersection(vert_to_edges[v1].begin(), vert_to_edges[v1].end(),
-					vert_to_edges[v2].begin(), vert_to_edges[v2].end(),
-					std::back_inserter(edges_to_merge));
+		while (!edge_heap.empty())
+		{
+			EdgeInfo* e_current = &edge_info[edge_heap.pop()];
 
-			CARVE_ASSERT(!edges_to_merge.empty());
+			gatherCollapse(c, e_current, adj);
+			collectAffectedFaces(c, true);
+			vertex_t* v1 = c.v1;
+			vertex_t* v2 = c.v2;
 
-			std::set_difference(vert_to_edges[v1].begin(), vert_to_edges[v1].end(),
-					edges_to_merge.begin(), edges_to_merge.end(),
-					std::back_inserter(v1_incident));
-			std::set_difference(vert_to_edges[v2].begin(), vert_to_edges[v2].end(),
-					edges_to_merge.begin(), edges_to_merge.end(),
-					std::back_inserter(v2_incident));
+			CARVE_ASSERT(!c.edges_to_merge.empty());
 
 			vector_t aabb_min, aabb_max;
 			assign_op(aabb_min, v1->v, v2->v, carve::util::min_functor());
 			assign_op(aabb_max, v1->v, v2->v, carve::util::max_functor());
 
-			for (size_t i = 0; i < v1_incident.size(); ++i)
+			for (const std::vector<EdgeInfo*>* incident :
+					{ &c.v1_incident, &c.v2_incident })
 			{
-				assign_op(aabb_min, aabb_min, v1_incident[i]->edge->v1()->v,
-						carve::util::min_functor());
-				assign_op(aabb_max, aabb_max, v1_incident[i]->edge->v1()->v,
-						carve::util::max_functor());
-				assign_op(aabb_min, aabb_min, v1_incident[i]->edge->v2()->v,
-						carve::util::min_functor());
-				assign_op(aabb_max, aabb_max, v1_incident[i]->edge->v2()->v,
-						carve::util::max_functor());
-			}
-
-			for (size_t i = 0; i < v2_incident.size(); ++i)
-			{
-				assign_op(aabb_min, aabb_min, v2_incident[i]->edge->v1()->v,
-						carve::util::min_functor());
-				assign_op(aabb_max, aabb_max, v2_incident[i]->edge->v1()->v,
-						carve::util::max_functor());
-				assign_op(aabb_min, aabb_min, v2_incident[i]->edge->v2()->v,
-						carve::util::min_functor());
-				assign_op(aabb_max, aabb_max, v2_incident[i]->edge->v2()->v,
-						carve::util::max_functor());
+				for (const EdgeInfo* e : *incident)
+				{
+					assign_op(aabb_min, aabb_min, e->edge->v1()->v,
+							carve::util::min_functor());
+					assign_op(aabb_max, aabb_max, e->edge->v1()->v,
+							carve::util::max_functor());
+					assign_op(aabb_min, aabb_min, e->edge->v2()->v,
+							carve::util::min_functor());
+					assign_op(aabb_max, aabb_max, e->edge->v2()->v,
+							carve::util::max_functor());
+				}
 			}
 
 			aabb_t aabb;
 			aabb.fit(aabb_min, aabb_max);
 
-			std::vector<face_t*> near_faces;
-			tree->search(aabb, std::back_inserter(near_faces));
+			c.near_faces.clear();
+			face_index.search(aabb, std::back_inserter(c.near_faces));
 
 			double frac =
 					0.5; // compute this based upon v1_incident and v2_incident?
 			vector_t merge = frac * v1->v + (1 - frac) * v2->v;
 
 			int i1 = countIntersectionPairs(
-					affected_faces.begin(), affected_faces.end(), near_faces.begin(),
-					near_faces.end(), nullptr, nullptr, merge);
-			int i2 = countIntersectionPairs(affected_faces.begin(),
-					affected_faces.end(), near_faces.begin(),
-					near_faces.end(), v1, v2, merge);
+					c.affected_faces.begin(), c.affected_faces.end(),
+					c.near_faces.begin(), c.near_faces.end(), nullptr, nullptr, merge);
+			int i2 = countIntersectionPairs(c.affected_faces.begin(),
+					c.affected_faces.end(), c.near_faces.begin(),
+					c.near_faces.end(), v1, v2, merge);
 			if (i2 != i1)
 			{
-				std::cerr << "near faces: " << near_faces.size()
-									<< " affected faces: " << affected_faces.size() << std::endl;
+				std::cerr << "near faces: " << c.near_faces.size()
+									<< " affected faces: " << c.affected_faces.size()
+									<< std::endl;
 				std::cerr << "merge delta[ints] = " << i2 - i1 << " pre: " << i1
 									<< " post: " << i2 << std::endl;
 				if (i2 > i1)
@@ -913,79 +1125,528 @@ class MeshSimplifier
 			v2->v = merge;
 			++n_mods;
 
-			for (size_t i = 0; i < v1_incident.size(); ++i)
+			applyCollapse(c, adj, edge_heap);
+
+			auto r = adj.live(c.v2_id, edge_info);
+			for (const uint32_t* i = r.first; i != r.second; ++i)
+			{
+				updateEdgeMergeHeap(edge_heap, *i, merger);
+			}
+		}
+
+		compactEdgeInfo();
+
+		return n_mods;
+	}
+
+	// The quadric error metric of Garland and Heckbert: the weighted sum
+	// of squared distances to a set of planes, as a symmetric 4x4 matrix
+	// of which the upper triangle is stored.
+	struct Quadric
+	{
+		double q[10];
+
+		Quadric() { std::fill(q, q + 10, 0.0); }
+
+		Quadric(const vector_t& n, double d, double w)
+		{
+			q[0] = w * n.x * n.x;
+			q[1] = w * n.x * n.y;
+			q[2] = w * n.x * n.z;
+			q[3] = w * n.x * d;
+			q[4] = w * n.y * n.y;
+			q[5] = w * n.y * n.z;
+			q[6] = w * n.y * d;
+			q[7] = w * n.z * n.z;
+			q[8] = w * n.z * d;
+			q[9] = w * d * d;
+		}
+
+		Quadric& operator+=(const Quadric& o)
+		{
+			for (size_t i = 0; i < 10; ++i)
+			{
+				q[i] += o.q[i];
+			}
+			return *this;
+		}
+
+		Quadric operator+(const Quadric& o) const
+		{
+			Quadric r(*this);
+			return r += o;
+		}
+
+		double error(const vector_t& v) const
+		{
+			return q[0] * v.x * v.x + 2.0 * q[1] * v.x * v.y + 2.0 * q[2] * v.x * v.z +
+					2.0 * q[3] * v.x + q[4] * v.y * v.y + 2.0 * q[5] * v.y * v.z +
+					2.0 * q[6] * v.y + q[7] * v.z * v.z + 2.0 * q[8] * v.z + q[9];
+		}
+
+		// The point of least error, unless the planes do not determine one.
+		bool minimize(vector_t& v) const
+		{
+			const double c0 = q[4] * q[7] - q[5] * q[5];
+			const double c1 = q[2] * q[5] - q[1] * q[7];
+			const double c2 = q[1] * q[5] - q[2] * q[4];
+			const double det = q[0] * c0 + q[1] * c1 + q[2] * c2;
+			const double tr = q[0] + q[4] + q[7];
+			if (fabs(det) <= 1e-9 * tr * tr * tr)
+			{
+				return false;
+			}
+			const double c4 = q[0] * q[7] - q[2] * q[2];
+			const double c5 = q[1] * q[2] - q[0] * q[5];
+			const double c8 = q[0] * q[4] - q[1] * q[1];
+			v.x = -(c0 * q[3] + c1 * q[6] + c2 * q[8]) / det;
+			v.y = -(c1 * q[3] + c4 * q[6] + c5 * q[8]) / det;
+			v.z = -(c2 * q[3] + c5 * q[6] + c8 * q[8]) / det;
+			return true;
+		}
+	};
+
+	using quadric_map_t = std::unordered_map<const vertex_t*, Quadric>;
+
+	// Accumulate the planes of the triangles of \a faces, weighted by
+	// area, into the quadrics of their vertices. Open edges also add a
+	// plane through the edge, perpendicular to the face, so that the
+	// boundary is preserved.
+	size_t initQuadrics(const std::vector<face_t*>& faces, quadric_map_t& quadrics)
+	{
+		const double boundary_weight = 1000.0;
+		size_t n_faces = 0;
+		for (face_t* face : faces)
+		{
+			if (face->nEdges() == 0)
+			{
+				continue;
+			}
+			++n_faces;
+			if (face->nEdges() != 3)
+			{
+				continue;
+			}
+			const vector_t& a = face->edge->vert->v;
+			const vector_t& b = face->edge->next->vert->v;
+			const vector_t& c = face->edge->next->next->vert->v;
+			vector_t n = carve::geom::cross(b - a, c - a);
+			const double len = n.length();
+			if (len == 0.0)
+			{
+				continue;
+			}
+			n /= len;
+			const Quadric q(n, -carve::geom::dot(n, a), len / 2.0);
+
+			edge_t* e = face->edge;
+			do
 			{
-				if (v1_incident[i]->edge->vert == v1)
+				quadrics[e->vert] += q;
+				if (e->rev == nullptr)
 				{
-					v1_incident[i]->edge->vert = v2;
+					const vector_t d = e->v2()->v - e->v1()->v;
+					vector_t m = carve::geom::cross(d, n);
+					if (m.length() > 0.0)
+					{
+						m.normalize();
+						const Quadric qb(m, -carve::geom::dot(m, e->v1()->v),
+								boundary_weight * d.length2());
+						quadrics[e->v1()] += qb;
+						quadrics[e->v2()] += qb;
+					}
+				}
+				e = e->next;
+			} while (e != face->edge);
+		}
+		return n_faces;
+	}
+
+	// A cell of a spatial partition of a mesh, which is decimated
+	// independently of the others. The cell is half open, and holds the
+	// faces that lie inside it. Faces that straddle cells are locked,
+	// along with their vertices, and are only read while the cells are
+	// decimated.
+	struct Partition
+	{
+		vector_t lo, hi;
+		std::vector<face_t*> faces;
+		const std::unordered_set<const vertex_t*>* locked_vertices{nullptr};
+		const face_bvh_t* locked_index{nullptr};
+
+		bool contains(const vector_t& v) const
+		{
+			for (unsigned k = 0; k < 3; ++k)
+			{
+				if (v[k] < lo[k] || v[k] >= hi[k])
+				{
+					return false;
 				}
 			}
+			return true;
+		}
+
+		bool contains(const aabb_t& aabb) const
+		{
+			return contains(aabb.min()) && contains(aabb.max());
+		}
+
+		bool locked(const vertex_t* v) const
+		{
+			return locked_vertices->find(v) != locked_vertices->end();
+		}
+	};
 
-			for (size_t i = 0; i < v1_incident.size(); ++i)
+	// Split faces into at most n_parts cells, by repeatedly splitting
+	// the most populous cell at the median face centre along its longest
+	// axis. Faces that do not lie inside their cell are returned in
+	// locked.
+	void partitionFaces(const std::vector<face_t*>& faces, size_t n_parts,
+			std::vector<Partition>& parts, std::vector<face_t*>& locked)
+	{
+		const double inf = std::numeric_limits<double>::infinity();
+		parts.resize(1);
+		parts[0].lo = carve::geom::VECTOR(-inf, -inf, -inf);
+		parts[0].hi = carve::geom::VECTOR(inf, inf, inf);
+		parts[0].faces = faces;
+
+		while (parts.size() < n_parts)
+		{
+			size_t k = 0;
+			for (size_t i = 1; i < parts.size(); ++i)
+			{
+				if (parts[i].faces.size() > parts[k].faces.size())
+				{
+					k = i;
+				}
+			}
+			std::vector<face_t*>& f = parts[k].faces;
+			if (f.size() < 2)
 			{
-				updateEdgeMergeHeap(edge_heap, v1_incident[i], merger);
+				break;
 			}
 
-			for (size_t i = 0; i < v2_incident.size(); ++i)
+			aabb_t bounds(f[0]->getAABB().pos);
+			for (size_t i = 1; i < f.size(); ++i)
 			{
-				updateEdgeMergeHeap(edge_heap, v2_incident[i], merger);
+				bounds.unionAABB(aabb_t(f[i]->getAABB().pos));
+			}
+			unsigned axis = 0;
+			for (unsigned a = 1; a < 3; ++a)
+			{
+				if (bounds.extent[a] > bounds.extent[axis])
+				{
+					axis = a;
+				}
 			}
 
-			vert_to_edges[v2].insert(vert_to_edges[v1].begin(),
-					vert_to_edges[v1].end());
-			vert_to_edges.erase(v1);
+			std::nth_element(f.begin(), f.begin() + f.size() / 2, f.end(),
+					[axis](const face_t* a, const face_t* b) {
+						return a->getAABB().pos[axis] < b->getAABB().pos[axis];
+					});
+			const double split = f[f.size() / 2]->getAABB().pos[axis];
 
-			for (size_t i = 0; i < edges_to_merge.size(); ++i)
+			Partition upper;
+			upper.lo = parts[k].lo;
+			upper.hi = parts[k].hi;
+			upper.lo[axis] = split;
+			std::vector<face_t*> lower;
+			for (size_t i = 0; i < f.size(); ++i)
 			{
-				EdgeInfo* e = edges_to_merge[i];
+				if (f[i]->getAABB().pos[axis] < split)
+				{
+					lower.push_back(f[i]);
+				}
+				else
+				{
+					upper.faces.push_back(f[i]);
+				}
+			}
+			if (lower.empty())
+			{
+				break;
+			}
+			f.swap(lower);
+			parts[k].hi[axis] = split;
+			parts.push_back(std::move(upper));
+		}
 
-				removeFromEdgeMergeHeap(edge_heap, e, merger);
-				edge_info.erase(e->edge);
+		for (size_t i = 0; i < parts.size(); ++i)
+		{
+			std::vector<face_t*>& f = parts[i].faces;
+			size_t n = 0;
+			for (size_t j = 0; j < f.size(); ++j)
+			{
+				if (parts[i].contains(f[j]->getAABB()))
+				{
+					f[n++] = f[j];
+				}
+				else
+				{
+					locked.push_back(f[j]);
+				}
+			}
+			f.resize(n);
+		}
+	}
 
-				vert_to_edges[v1].erase(e);
-				vert_to_edges[v2].erase(e);
+	// Only one half of each edge between two triangles is queued, and
+	// none that moves a locked vertex.
+	static bool collapsible(const EdgeInfo* e, const Partition* part)
+	{
+		const edge_t* edge = e->edge;
+		return (edge->rev == nullptr || edge < edge->rev) &&
+				edge->face->nEdges() == 3 &&
+				(edge->rev == nullptr || edge->rev->face->nEdges() == 3) &&
+				(part == nullptr ||
+						(!part->locked(edge->v1()) && !part->locked(edge->v2())));
+	}
 
-				face_t* f1 = e->edge->face;
+	void updateCost(EdgeInfo* e, const std::vector<Quadric>& quadrics)
+	{
+		const vertex_t* v1 = e->edge->v1();
+		const vertex_t* v2 = e->edge->v2();
+		const Quadric q = quadrics[e->vert_id[0]] + quadrics[e->vert_id[1]];
 
-				e->edge->removeHalfEdge();
+		vector_t cand[4] = { v1->v, v2->v, (v1->v + v2->v) / 2.0, vector_t() };
+		const size_t n_cand = q.minimize(cand[3]) ? 4 : 3;
+		e->cost = std::numeric_limits<double>::max();
+		for (size_t i = 0; i < n_cand; ++i)
+		{
+			const double err = std::max(q.error(cand[i]), 0.0);
+			if (err < e->cost)
+			{
+				e->cost = err;
+				e->target = cand[i];
+			}
+		}
+	}
 
-				if (f1->n_edges == 2)
+	// Collapse edges in order of increasing cost.
+	void updateEdgeCostHeap(edge_heap_t& edge_heap, uint32_t id,
+			const std::vector<Quadric>& quadrics, const Partition* part)
+	{
+		EdgeInfo* edge = &edge_info[id];
+		if (collapsible(edge, part))
+		{
+			updateCost(edge, quadrics);
+			edge_heap.update(id, edge->cost);
+		}
+		else
+		{
+			edge_heap.remove(id);
+		}
+	}
+
+	// Whether collapsing edge keeps the mesh manifold: the vertices
+	// adjacent to both ends must be exactly the apexes of the faces of the
+	// edge, an interior edge may not join two boundary vertices, and the
+	// collapse may not flatten a tetrahedron.
+	static bool linkConditionHolds(const edge_t* edge, Collapse& c)
+	{
+		const vertex_t* v1 = edge->v1();
+		const vertex_t* v2 = edge->v2();
+		std::vector<const vertex_t*>& n1 = c.n1;
+		std::vector<const vertex_t*>& n2 = c.n2;
+		n1.clear();
+		n2.clear();
+		bool v1_open = false, v2_open = false;
+		for (const EdgeInfo* e : c.v1_incident)
+		{
+			n1.push_back(e->edge->v1() == v1 ? e->edge->v2() : e->edge->v1());
+			v1_open |= e->edge->rev == nullptr;
+		}
+		for (const EdgeInfo* e : c.v2_incident)
+		{
+			n2.push_back(e->edge->v1() == v2 ? e->edge->v2() : e->edge->v1());
+			v2_open |= e->edge->rev == nullptr;
+		}
+		const vertex_t* apex[2] = { edge->next->v2(), nullptr };
+		size_t n_apex = 1;
+		if (edge->rev != nullptr)
+		{
+			apex[n_apex++] = edge->rev->next->v2();
+			if (v1_open && v2_open)
+			{
+				return false;
+			}
+			if (apex[1] < apex[0])
+			{
+				std::swap(apex[0], apex[1]);
+			}
+		}
+
+		std::sort(n1.begin(), n1.end());
+		n1.erase(std::unique(n1.begin(), n1.end()), n1.end());
+		std::sort(n2.begin(), n2.end());
+		n2.erase(std::unique(n2.begin(), n2.end()), n2.end());
+
+		size_t n_common = 0, n_all = 0;
+		bool apexes = true;
+		for (size_t i = 0, j = 0; i < n1.size() || j < n2.size(); ++n_all)
+		{
+			if (j == n2.size() || (i < n1.size() && n1[i] < n2[j]))
+			{
+				++i;
+			}
+			else if (i == n1.size() || n2[j] < n1[i])
+			{
+				++j;
+			}
+			else
+			{
+				apexes &= n_common < n_apex && n1[i] == apex[n_common];
+				++n_common;
+				++i;
+				++j;
+			}
+		}
+		return apexes && n_common == n_apex && n_all > n_apex;
+	}
+
+	// Whether moving the ends of edge to target turns over, or
+	// degenerates, any of the faces that survive the collapse.
+	bool foldsOver(const edge_t* edge, const vector_t& target,
+			const std::vector<face_t*>& affected_faces)
+	{
+		for (face_t* face : affected_faces)
+		{
+			if (face == edge->face || (edge->rev && face == edge->rev->face) ||
+					face->nEdges() != 3)
+			{
+				continue;
+			}
+			vector_t pre[3], post[3];
+			mapTriangle(face, nullptr, nullptr, target, pre);
+			mapTriangle(face, edge->v1(), edge->v2(), target, post);
+			const vector_t n_pre = carve::geom::cross(pre[1] - pre[0], pre[2] - pre[0]);
+			const vector_t n_post =
+					carve::geom::cross(post[1] - post[0], post[2] - post[0]);
+			if (carve::geom::dot(n_pre, n_post) <= 0.0 ||
+					n_post.length2() <= 1e-12 * n_pre.length2())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Collapse edges of faces, whose edge info has been initialised, in
+	// order of least quadric error, until no more than target_faces of
+	// them remain, or the next collapse would cost more than max_error.
+	// Collapses that would make the mesh non-manifold, turn over a face
+	// or, if check_intersections is set, add a self intersection with a
+	// face of the face index are skipped. Given a partition cell,
+	// collapses are kept inside it, and are also checked against the
+	// locked faces.
+	size_t collapseEdgesQEM(const std::vector<face_t*>& faces,
+			size_t target_faces, double max_error, bool check_intersections,
+			const Partition* part = nullptr)
+	{
+		VertexEdges adj;
+		const std::vector<vertex_t*> verts = initVertexEdges(adj);
+
+		std::vector<Quadric> quadrics(verts.size());
+		size_t n_faces;
+		{
+			quadric_map_t quadric_map;
+			n_faces = initQuadrics(faces, quadric_map);
+			for (size_t i = 0; i < verts.size(); ++i)
+			{
+				quadric_map_t::const_iterator q = quadric_map.find(verts[i]);
+				if (q != quadric_map.end())
 				{
-					edge_t* e1 = f1->edge;
-					edge_t* e2 = f1->edge->next;
-					if (e1->rev)
-					{
-						e1->rev->rev = e2->rev;
-					}
-					if (e2->rev)
-					{
-						e2->rev->rev = e1->rev;
-					}
-					EdgeInfo* e1i = edge_info[e1];
-					EdgeInfo* e2i = edge_info[e2];
-					CARVE_ASSERT(e1i != nullptr);
-					CARVE_ASSERT(e2i != nullptr);
-					vert_to_edges[e1->v1()].erase(e1i);
-					vert_to_edges[e1->v2()].erase(e1i);
-					vert_to_edges[e2->v1()].erase(e2i);
-					vert_to_edges[e2->v2()].erase(e2i);
-					removeFromEdgeMergeHeap(edge_heap, e1i, merger);
-					removeFromEdgeMergeHeap(edge_heap, e2i, merger);
-					edge_info.erase(e1);
-					edge_info.erase(e2);
-					f1->clearEdges();
-					tree->remove(f1, aabb);
-
-					delete e1i;
-					delete e2i;
+					quadrics[i] = (*q).second;
 				}
-				delete e;
 			}
+		}
+
+		size_t n_mods = 0;
 
-			tree->updateExtents(aabb);
+		edge_heap_t edge_heap(edge_info.size());
+		std::vector<edge_heap_t::entry_t> entries;
+		entries.reserve(edge_info.size() / 2);
+		for (uint32_t i = 0; i < edge_info.size(); ++i)
+		{
+			EdgeInfo* e = &edge_info[i];
+			if (collapsible(e, part))
+			{
+				updateCost(e, quadrics);
+				entries.emplace_back(e->cost, i);
+			}
 		}
+		edge_heap.assign(std::move(entries));
 
-		delete tree;
+		Collapse c;
+
+		while (!edge_heap.empty() && n_faces > target_faces &&
+				edge_heap.top_key() <= max_error)
+		{
+			EdgeInfo* e_current = &edge_info[edge_heap.pop()];
+
+			edge_t* edge = e_current->edge;
+			const vector_t target = e_current->target;
+
+			gatherCollapse(c, e_current, adj);
+
+			if (!linkConditionHolds(edge, c) ||
+					(part != nullptr && !part->contains(target)))
+			{
+				continue;
+			}
+
+			collectAffectedFaces(c, false);
+			aabb_t aabb(target);
+			for (face_t* f : c.affected_faces)
+			{
+				aabb.unionAABB(f->getAABB());
+			}
+
+			if (foldsOver(edge, target, c.affected_faces))
+			{
+				continue;
+			}
+
+			if (check_intersections)
+			{
+				c.near_faces.clear();
+				face_index.search(aabb, std::back_inserter(c.near_faces));
+				if (part != nullptr && part->locked_index != nullptr)
+				{
+					part->locked_index->search(aabb, std::back_inserter(c.near_faces));
+				}
+
+				// existing intersections only need counting if there are some after.
+				int i2 = countIntersectionPairs(c.affected_faces.begin(),
+						c.affected_faces.end(), c.near_faces.begin(),
+						c.near_faces.end(), c.v1, c.v2, target);
+				if (i2 > 0 &&
+						i2 > countIntersectionPairs(c.affected_faces.begin(),
+								c.affected_faces.end(), c.near_faces.begin(),
+								c.near_faces.end(), nullptr, nullptr, target))
+				{
+					continue;
+				}
+			}
+
+			c.v2->v = target;
+			quadrics[c.v2_id] += quadrics[c.v1_id];
+			++n_mods;
+
+			n_faces -= applyCollapse(c, adj, edge_heap);
+
+			auto r = adj.live(c.v2_id, edge_info);
+			for (const uint32_t* i = r.first; i != r.second; ++i)
+			{
+				edge_info[*i].edge->face->recalc();
+			}
+			for (const uint32_t* i = r.first; i != r.second; ++i)
+			{
+				updateEdgeCostHeap(edge_heap, *i, quadrics, part);
+			}
+		}
+
+		compactEdgeInfo();
 
 		return n_mods;
 	}
@@ -1379,7 +2040,9 @@ public:
 	size_t improveMesh_conservative(meshset_t* meshset)
 	{
 		initEdgeInfo(meshset);
+		initFaceIndex(meshset);
 		size_t modifications = flipEdges(meshset, FlippableConservative());
+		clearFaceIndex();
 		clearEdgeInfo();
 		return modifications;
 	}
@@ -1388,8 +2051,10 @@ public:
 			double min_delta_v, double min_normal_angle)
 	{
 		initEdgeInfo(meshset);
+		initFaceIndex(meshset);
 		size_t modifications = flipEdges(
 				meshset, Flippable(min_colinearity, min_delta_v, min_normal_angle));
+		clearFaceIndex();
 		clearEdgeInfo();
 		return modifications;
 	}
@@ -1397,12 +2062,120 @@ public:
 	size_t eliminateShortEdges(meshset_t* meshset, double min_length)
 	{
 		initEdgeInfo(meshset);
+		initFaceIndex(meshset);
 		size_t modifications = collapseEdges(meshset, EdgeMerger(min_length));
 		removeRemnantFaces(meshset);
+		clearFaceIndex();
 		clearEdgeInfo();
 		return modifications;
 	}
 
+	// Decimate triangle meshes by collapsing edges of least quadric
+	// error, until no more than target_faces faces remain, or every
+	// remaining collapse would cost more than max_error (a sum of
+	// squared, area weighted, distances). With check_intersections,
+	// collapses that would add self intersections are skipped. Faces
+	// that are not triangles are left alone. Unused vertices are
+	// removed from the vertex storage afterwards.
+	size_t decimate(meshset_t* meshset, size_t target_faces,
+			double max_error = std::numeric_limits<double>::max(),
+			bool check_intersections = true)
+	{
+		std::vector<face_t*> faces(meshset->faceBegin(), meshset->faceEnd());
+		initEdgeInfo(meshset);
+		if (check_intersections)
+		{
+			initFaceIndex(faces.begin(), faces.end());
+		}
+		size_t modifications = collapseEdgesQEM(faces, target_faces, max_error,
+				check_intersections);
+		removeRemnantFaces(meshset);
+		clearFaceIndex();
+		clearEdgeInfo();
+		for (size_t i = 0; i < meshset->meshes.size(); ++i)
+		{
+			meshset->meshes[i]->cacheEdges();
+		}
+		if (modifications)
+		{
+			meshset->collectVertices();
+		}
+		return modifications;
+	}
+
+	// Decimate as decimate() does, but first split the mesh spatially
+	// into n_parts cells, which are decimated concurrently, each towards
+	// its share of target_faces. Faces that straddle cells are left
+	// alone until a final pass over the whole mesh, which joins the
+	// seams and finishes the decimation. n_parts = 0 uses four cells
+	// per thread.
+	size_t decimatePartitioned(meshset_t* meshset, size_t target_faces,
+			double max_error = std::numeric_limits<double>::max(),
+			bool check_intersections = true, size_t n_parts = 0)
+	{
+		if (n_parts == 0)
+		{
+			n_parts = 4 * carve::parallel::threadCount();
+		}
+		std::vector<face_t*> faces(meshset->faceBegin(), meshset->faceEnd());
+
+		size_t modifications = 0;
+		if (n_parts > 1 && faces.size() > target_faces)
+		{
+			std::vector<Partition> parts;
+			std::vector<face_t*> locked;
+			partitionFaces(faces, n_parts, parts, locked);
+
+			std::unordered_set<const vertex_t*> locked_vertices;
+			for (face_t* face : locked)
+			{
+				edge_t* e = face->edge;
+				do
+				{
+					locked_vertices.insert(e->vert);
+					e = e->next;
+				} while (e != face->edge);
+			}
+			face_bvh_t locked_index;
+			if (check_intersections)
+			{
+				locked_index.build(locked.begin(), locked.end());
+			}
+
+			std::vector<size_t> n_mods(parts.size(), 0);
+			carve::parallel::for_each_index(0, parts.size(), 1, [&](size_t i) {
+				Partition& part = parts[i];
+				part.locked_vertices = &locked_vertices;
+				part.locked_index = &locked_index;
+				MeshSimplifier simplifier;
+				simplifier.initEdgeInfo(part.faces);
+				if (check_intersections)
+				{
+					simplifier.initFaceIndex(part.faces.begin(), part.faces.end());
+				}
+				n_mods[i] = simplifier.collapseEdgesQEM(part.faces,
+						target_faces * part.faces.size() / faces.size(), max_error,
+						check_intersections, &part);
+				simplifier.clearFaceIndex();
+				simplifier.clearEdgeInfo();
+			});
+
+			for (size_t i = 0; i < n_mods.size(); ++i)
+			{
+				modifications += n_mods[i];
+			}
+			removeRemnantFaces(meshset);
+		}
+
+		const size_t n_seam = decimate(meshset, target_faces, max_error,
+				check_intersections);
+		if (n_seam == 0 && modifications != 0)
+		{
+			meshset->collectVertices();
+		}
+		return modifications + n_seam;
+	}
+
 	// Snap vertices to grid, aligning almost flat axis-aligned
 	// faces to the axis, and flattening other faces as much as is
 	// possible. Passing a number less than DBL_MIN_EXPONENT (-1021)
@@ -1592,6 +2365,7 @@ public:
 		size_t n_flip, n_merge;
 
 		initEdgeInfo(meshset);
+		initFaceIndex(meshset);
 
 		std::cerr << "initial merge" << std::endl;
 		modifications = collapseEdges(meshset, EdgeMerger(0.0));
@@ -1626,6 +2400,7 @@ public:
 			std::cerr << "stats:" << n_flip << " " << n_merge << std::endl;
 		} while (n_flip || n_merge);
 
+		clearFaceIndex();
 		clearEdgeInfo();
 
 		for (size_t i = 0; i < meshset->meshes.size(); ++i)
@@ -1812,8 +2587,7 @@ public:
 			}
 		}
 
-		face_rtree_t* tree = face_rtree_t::construct_STR(meshset->faceBegin(),
-				meshset->faceEnd(), 4, 4);
+		initFaceIndex(meshset);
 
 		for (vfsmap_t::iterator i = vertex_qinfo.begin(); i != vertex_qinfo.end();
 				 ++i)
@@ -1838,7 +2612,7 @@ public:
 				aabb.unionAABB(aabb_t(q_pt));
 
 				std::vector<face_t*> overlapping;
-				tree->search(aabb, std::back_inserter(overlapping));
+				face_index.search(aabb, std::back_inserter(overlapping));
 
 				int n_intersections = countIntersectionPairs(
 						qi.faces.begin(), qi.faces.end(), overlapping.begin(),
@@ -1848,7 +2622,10 @@ public:
 				{
 					vert->v = q_pt;
 					quantized.push_back((*i).first);
-					tree->updateExtents(aabb);
+					for (face_t* face : qi.faces)
+					{
+						face_index.update(face);
+					}
 				}
 			}
 			for (size_t i = 0; i < quantized.size(); ++i)
@@ -1861,6 +2638,8 @@ public:
 				break;
 			}
 		}
+
+		clearFaceIndex();
 	}
 };
 }
@@ -0,0 +1,175 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <carve/carve.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <vector>
+
+#if defined(CARVE_WITH_THREADS)
+#	include <thread>
+#endif
+
+namespace carve {
+namespace parallel {
+
+/**
+ * \brief Set the maximum number of threads used by carve's parallel
+ * algorithms.
+ *
+ * A value of 0 (the default) uses the hardware concurrency of the
+ * machine. A value of 1 makes every parallel algorithm run serially
+ * on the calling thread.
+ */
+CARVE_API void setThreadCount(unsigned n);
+
+/**
+ * \brief The number of threads parallel algorithms will use (always >= 1).
+ *
+ * Inside a chunk of a parallel algorithm this is 1, so that nested
+ * parallel algorithms run serially rather than oversubscribing the
+ * machine.
+ */
+CARVE_API unsigned threadCount();
+
+/**
+ * \brief True while the calling thread is running a chunk of a
+ * parallel algorithm, and so may be sharing data with other threads.
+ */
+CARVE_API bool inRegion();
+
+namespace detail {
+// Marks the calling thread as running a chunk of a parallel algorithm
+// for the lifetime of the guard.
+struct CARVE_API region_guard
+{
+	region_guard();
+	~region_guard();
+	region_guard(const region_guard&) = delete;
+	region_guard& operator=(const region_guard&) = delete;
+};
+} // namespace detail
+
+/**
+ * \brief The number of chunks that for_chunks() will split a range
+ * of \a n elements into, given a minimum chunk size of \a grain.
+ */
+inline size_t chunkCount(size_t n, size_t grain)
+{
+	if (n == 0)
+	{
+		return 0;
+	}
+	grain = std::max<size_t>(grain, 1);
+	return std::max<size_t>(1, std::min<size_t>(threadCount(), (n + grain - 1) / grain));
+}
+
+/**
+ * \brief Split [\a begin, \a end) into contiguous chunks of at least
+ * \a grain elements, and call func(chunk_begin, chunk_end, chunk) for
+ * each of them concurrently.
+ *
+ * Chunk numbers are dense and follow the order of the range, so a
+ * caller may write into per-chunk buffers and concatenate them
+ * afterwards to get a result that does not depend on scheduling.
+ * The first chunk runs on the calling thread. An exception thrown by
+ * any chunk is rethrown once all chunks have finished.
+ */
+template<typename func_t>
+void for_chunks(size_t begin, size_t end, size_t grain, func_t func)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+	const size_t n = end - begin;
+	const size_t n_chunks = chunkCount(n, grain);
+
+	if (n_chunks == 1)
+	{
+		func(begin, end, size_t(0));
+		return;
+	}
+
+#if defined(CARVE_WITH_THREADS)
+	std::vector<std::exception_ptr> errors(n_chunks);
+	std::vector<std::thread> workers;
+	workers.reserve(n_chunks - 1);
+
+	auto run = [&](size_t c) {
+		detail::region_guard guard;
+		try
+		{
+			func(begin + n * c / n_chunks, begin + n * (c + 1) / n_chunks, c);
+		}
+		catch (...)
+		{
+			errors[c] = std::current_exception();
+		}
+	};
+
+	for (size_t c = 1; c < n_chunks; ++c)
+	{
+		workers.emplace_back(run, c);
+	}
+	run(0);
+	for (size_t c = 0; c < workers.size(); ++c)
+	{
+		workers[c].join();
+	}
+	for (size_t c = 0; c < n_chunks; ++c)
+	{
+		if (errors[c])
+		{
+			std::rethrow_exception(errors[c]);
+		}
+	}
+#else
+	for (size_t c = 0; c < n_chunks; ++c)
+	{
+		func(begin + n * c / n_chunks, begin + n * (c + 1) / n_chunks, c);
+	}
+#endif
+}
+
+/**
+ * \brief Call func(i) for every i in [\a begin, \a end), concurrently
+ * in chunks of at least \a grain indices.
+ */
+template<typename func_t>
+void for_each_index(size_t begin, size_t end, size_t grain, func_t func)
+{
+	for_chunks(begin, end, grain, [&func](size_t lo, size_t hi, size_t) {
+		for (size_t i = lo; i < hi; ++i)
+		{
+			func(i);
+		}
+	});
+}
+}
+} // namespace carve::parallel
@@ -30,18 +30,252 @@
 #include <carve/csg.hpp>
 #include <carve/mesh.hpp>
 #include <carve/matrix.hpp>
+#include <carve/parallel.hpp>
 #include <carve/rescale.hpp>
 #include <carve/timing.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#if defined(CARVE_WITH_THREADS)
+#	include <condition_variable>
+#	include <mutex>
+#endif
+
 namespace carve {
 namespace csg {
+namespace detail {
+
+inline size_t hashCombine(size_t seed, size_t v)
+{
+	return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+inline size_t hashMatrix(const carve::math::Matrix& m)
+{
+	size_t h = 0;
+	for (size_t i = 0; i < 16; ++i)
+	{
+		h = hashCombine(h, std::hash<double>()(m.v[i]));
+	}
+	return h;
+}
+
+// An operand of a tree node that may be transformed for the node's
+// evaluation. A mesh set the node owns is transformed in place (and
+// deleted when the view is released). One it does not own is never
+// written to: the first transformation makes a copy whose vertices are
+// transformed as they are copied, with the faces and edges rebased
+// onto them, so a chain of transformations costs a single copy.
+class TransformedView
+{
+	using meshset_t = carve::mesh::MeshSet<3>;
+
+	meshset_t* poly;
+	bool is_temp;
+
+	TransformedView(const TransformedView&) = delete;
+	TransformedView& operator=(const TransformedView&) = delete;
+
+	template<typename func_t>
+	static meshset_t* transformedCopy(const meshset_t* src, func_t func)
+	{
+		std::vector<meshset_t::vertex_t> vertex_storage;
+		vertex_storage.reserve(src->vertex_storage.size());
+		for (size_t i = 0; i < src->vertex_storage.size(); ++i)
+		{
+			vertex_storage.push_back(
+					meshset_t::vertex_t(func(src->vertex_storage[i].v)));
+		}
+		std::vector<meshset_t::mesh_t*> meshes;
+		meshes.reserve(src->meshes.size());
+		for (size_t i = 0; i < src->meshes.size(); ++i)
+		{
+			meshes.push_back(src->meshes[i]->clone(src->vertex_storage.data(),
+					vertex_storage.data()));
+		}
+		meshset_t* result = new meshset_t(vertex_storage, meshes);
+		for (size_t i = 0; i < result->meshes.size(); ++i)
+		{
+			result->meshes[i]->recalc();
+		}
+		return result;
+	}
+
+public:
+	TransformedView() : poly(nullptr), is_temp(false) {}
+	~TransformedView() { reset(); }
+
+	meshset_t* get() const { return poly; }
+	bool isTemp() const { return is_temp; }
+
+	void reset(meshset_t* _poly = nullptr, bool _is_temp = false)
+	{
+		if (is_temp)
+		{
+			delete poly;
+		}
+		poly = _poly;
+		is_temp = _is_temp;
+	}
+
+	// Hand an owned mesh set over to the caller.
+	meshset_t* take()
+	{
+		CARVE_ASSERT(is_temp);
+		meshset_t* result = poly;
+		poly = nullptr;
+		is_temp = false;
+		return result;
+	}
+
+	template<typename func_t>
+	void transform(func_t func)
+	{
+		if (!is_temp)
+		{
+			poly = transformedCopy(poly, func);
+			is_temp = true;
+			return;
+		}
+		poly->transform(func);
+	}
+};
+
+// The inverse of the affine transformation m, if m keeps orientation,
+// so that it does not turn closed meshes inside out.
+inline bool invertProper(const carve::math::Matrix& m, carve::math::Matrix& inv)
+{
+	const double c00 = m._22 * m._33 - m._32 * m._23;
+	const double c01 = m._31 * m._23 - m._21 * m._33;
+	const double c02 = m._21 * m._32 - m._31 * m._22;
+	const double det = m._11 * c00 + m._12 * c01 + m._13 * c02;
+	if (!(det > 0.0))
+	{
+		return false;
+	}
+	const double a00 = c00 / det, a01 = c01 / det, a02 = c02 / det;
+	const double a10 = (m._32 * m._13 - m._12 * m._33) / det;
+	const double a11 = (m._11 * m._33 - m._31 * m._13) / det;
+	const double a12 = (m._31 * m._12 - m._11 * m._32) / det;
+	const double a20 = (m._12 * m._23 - m._22 * m._13) / det;
+	const double a21 = (m._21 * m._13 - m._11 * m._23) / det;
+	const double a22 = (m._11 * m._22 - m._21 * m._12) / det;
+	inv = carve::math::Matrix(a00, a01, a02, -(a00 * m._41 + a01 * m._42 + a02 * m._43),
+			a10, a11, a12, -(a10 * m._41 + a11 * m._42 + a12 * m._43),
+			a20, a21, a22, -(a20 * m._41 + a21 * m._42 + a22 * m._43),
+			0.0, 0.0, 0.0, 1.0);
+	return true;
+}
+
+// Operands of a node that still have a transformation pending[i] to be
+// applied are normally moved into the node's frame, which copies those
+// the node does not own. The node may instead combine them in the frame
+// given by one of their pending transformations, and then move its own
+// result back out: operands that share that transformation are used as
+// they are. This picks the frame that saves copying the most vertices
+// (or keeps the node's own), sets frame to the transformation to apply
+// to the result, and replaces pending[i] with what is still to be
+// applied to operand i.
+inline void chooseFrame(const std::vector<const carve::mesh::MeshSet<3>*>& polys,
+		const std::vector<bool>& owned, std::vector<carve::math::Matrix>& pending,
+		carve::math::Matrix& frame)
+{
+	const carve::math::Matrix ident = carve::math::Matrix::IDENT();
+	frame = ident;
+
+	// the vertices of unowned operands that are saved from copying by
+	// each candidate frame; operands with the same transformation count
+	// together.
+	size_t best_saved = 0;
+	for (size_t i = 0; i < polys.size(); ++i)
+	{
+		if (!owned[i] && pending[i] == ident)
+		{
+			best_saved += polys[i]->vertex_storage.size();
+		}
+	}
+	std::unordered_map<size_t, std::vector<size_t>> candidates;
+	for (size_t i = 0; i < polys.size(); ++i)
+	{
+		if (!owned[i] && pending[i] != ident)
+		{
+			candidates[hashMatrix(pending[i])].push_back(i);
+		}
+	}
+	size_t best = polys.size();
+	carve::math::Matrix inv, best_inv;
+	for (auto& c : candidates)
+	{
+		const std::vector<size_t>& idx = c.second;
+		for (size_t j = 0; j < idx.size(); ++j)
+		{
+			size_t saved = 0;
+			bool first = true;
+			for (size_t k = 0; k < idx.size(); ++k)
+			{
+				if (pending[idx[k]] == pending[idx[j]])
+				{
+					first = first && k >= j;
+					saved += polys[idx[k]]->vertex_storage.size();
+				}
+			}
+			if (first && saved > best_saved && invertProper(pending[idx[j]], inv))
+			{
+				best_saved = saved;
+				best = idx[j];
+				best_inv = inv;
+			}
+		}
+	}
+	if (best == polys.size())
+	{
+		return;
+	}
+
+	frame = pending[best];
+	for (size_t i = 0; i < polys.size(); ++i)
+	{
+		pending[i] = pending[i] == frame ? ident : best_inv * pending[i];
+	}
+}
+} // namespace detail
 
 class CSG_TreeNode
 {
+	// hash() is looked up for every node of a tree, and so is computed
+	// once per node rather than once per lookup.
+	mutable size_t hash_value = 0;
+	mutable bool hash_valid = false;
+
 	CSG_TreeNode(const CSG_TreeNode&) = delete;
 	CSG_TreeNode& operator=(const CSG_TreeNode&) = delete;
 
 protected:
+	// The structural hash returned by hash(); see there.
+	virtual size_t computeHash() const { return std::hash<const CSG_TreeNode*>()(this); }
+
+	// Forget the hash of a node whose expression has changed.
+	void resetHash() { hash_valid = false; }
+
+	// true for nodes whose results are worth sharing through a
+	// CSG_TreeCache.
+	virtual bool isCacheable() const { return false; }
+
+	// Evaluate a child, taking its result from csg.tree_cache if there
+	// is one.
+	static carve::mesh::MeshSet<3>* evalChild(CSG_TreeNode* child,
+			bool& is_temp, CSG& csg);
+
+	static carve::mesh::MeshSet<3>* evalChildDeferred(CSG_TreeNode* child,
+			bool& is_temp, carve::math::Matrix& pending, CSG& csg);
+
+	// The face R-tree of an operand, if csg.tree_cache has one for it.
+	static const CSG::face_rtree_t* faceTree(const detail::TransformedView& view,
+			CSG& csg);
+
 public:
 	CSG_TreeNode() = default;
 
@@ -49,6 +283,47 @@ public:
 
 	virtual carve::mesh::MeshSet<3>* eval(bool& is_temp, CSG& csg) = 0;
 
+	/**
+	 * \brief Evaluate the node, leaving a transformation that is still to
+	 * be applied to the result in \a pending.
+	 *
+	 * Transformation nodes use this to hand their matrix on to the
+	 * consumer of their result. That can apply it while making the one
+	 * copy it needs of a mesh set it does not own, or avoid the copy by
+	 * combining its operands in the frame the matrix gives.
+	 */
+	virtual carve::mesh::MeshSet<3>* evalDeferred(bool& is_temp,
+			carve::math::Matrix& pending, CSG& csg)
+	{
+		pending = carve::math::Matrix::IDENT();
+		return eval(is_temp, csg);
+	}
+
+	/**
+	 * \brief A hash of the expression rooted at this node. Nodes for
+	 * which equal() is true have the same hash.
+	 *
+	 * The hash is computed on first use and then kept, so a subtree must
+	 * not be changed once the hash of a node above it has been taken.
+	 * It is not synchronised; CSG_TreeCache only asks for it under its
+	 * lock.
+	 */
+	size_t hash() const
+	{
+		if (!hash_valid)
+		{
+			hash_value = computeHash();
+			hash_valid = true;
+		}
+		return hash_value;
+	}
+
+	/**
+	 * \brief True if \a other is an expression of the same form over the
+	 * same inputs, and so evaluates to the same result.
+	 */
+	virtual bool equal(const CSG_TreeNode& other) const { return this == &other; }
+
 	virtual carve::mesh::MeshSet<3>* eval(CSG& csg)
 	{
 		bool temp;
@@ -71,15 +346,35 @@ public:
 			: transform(_transform), child(_child) {}
 	~CSG_TransformNode() override { delete child; }
 
+	carve::mesh::MeshSet<3>* evalDeferred(bool& is_temp,
+			carve::math::Matrix& pending, CSG& csg) override
+	{
+		carve::mesh::MeshSet<3>* result = evalChildDeferred(child, is_temp, pending, csg);
+		pending = transform * pending;
+		return result;
+	}
+
+	size_t computeHash() const override
+	{
+		return detail::hashCombine(detail::hashMatrix(transform), child->hash());
+	}
+
+	bool equal(const CSG_TreeNode& other) const override
+	{
+		const CSG_TransformNode* o = dynamic_cast<const CSG_TransformNode*>(&other);
+		return o != nullptr && o->transform == transform && child->equal(*o->child);
+	}
+
 	carve::mesh::MeshSet<3>* eval(bool& is_temp, CSG& csg) override
 	{
-		carve::mesh::MeshSet<3>* result = child->eval(is_temp, csg);
+		carve::math::Matrix pending;
+		carve::mesh::MeshSet<3>* result = evalDeferred(is_temp, pending, csg);
 		if (!is_temp)
 		{
 			result = result->clone();
 			is_temp = true;
 		}
-		result->transform(carve::math::matrix_transformation(transform));
+		result->transform(carve::math::matrix_transformation(pending));
 		return result;
 	}
 };
@@ -89,6 +384,9 @@ class CSG_InvertNode : public CSG_TreeNode
 	std::vector<bool> selected_meshes;
 	CSG_TreeNode* child;
 
+protected:
+	bool isCacheable() const override { return true; }
+
 public:
 	explicit CSG_InvertNode(CSG_TreeNode* _child)
 			: selected_meshes(), child(_child) {}
@@ -116,10 +414,23 @@ public:
 		}
 	}
 
+	size_t computeHash() const override
+	{
+		return detail::hashCombine(
+				std::hash<std::vector<bool>>()(selected_meshes) + 1, child->hash());
+	}
+
+	bool equal(const CSG_TreeNode& other) const override
+	{
+		const CSG_InvertNode* o = dynamic_cast<const CSG_InvertNode*>(&other);
+		return o != nullptr && o->selected_meshes == selected_meshes &&
+				child->equal(*o->child);
+	}
+
 	carve::mesh::MeshSet<3>* eval(bool& is_temp, CSG& csg) override
 	{
 		bool c_temp;
-		carve::mesh::MeshSet<3>* c = child->eval(c_temp, csg);
+		carve::mesh::MeshSet<3>* c = evalChild(child, c_temp, csg);
 		if (!c_temp)
 		{
 			c = c->clone();
@@ -149,6 +460,9 @@ class CSG_SelectNode : public CSG_TreeNode
 	std::vector<bool> selected_meshes;
 	CSG_TreeNode* child;
 
+protected:
+	bool isCacheable() const override { return true; }
+
 public:
 	CSG_SelectNode(int m_id, CSG_TreeNode* _child)
 			: selected_meshes(), child(_child)
@@ -175,10 +489,23 @@ public:
 
 	~CSG_SelectNode() override { delete child; }
 
+	size_t computeHash() const override
+	{
+		return detail::hashCombine(
+				std::hash<std::vector<bool>>()(selected_meshes) + 2, child->hash());
+	}
+
+	bool equal(const CSG_TreeNode& other) const override
+	{
+		const CSG_SelectNode* o = dynamic_cast<const CSG_SelectNode*>(&other);
+		return o != nullptr && o->selected_meshes == selected_meshes &&
+				child->equal(*o->child);
+	}
+
 	carve::mesh::MeshSet<3>* eval(bool& is_temp, CSG& csg) override
 	{
 		bool c_temp;
-		carve::mesh::MeshSet<3>* c = child->eval(c_temp, csg);
+		carve::mesh::MeshSet<3>* c = evalChild(child, c_temp, csg);
 		if (!c_temp)
 		{
 			c = c->clone();
@@ -227,6 +554,17 @@ public:
 		is_temp = false;
 		return poly;
 	}
+
+	size_t computeHash() const override
+	{
+		return std::hash<const carve::mesh::MeshSet<3>*>()(poly);
+	}
+
+	bool equal(const CSG_TreeNode& other) const override
+	{
+		const CSG_PolyNode* o = dynamic_cast<const CSG_PolyNode*>(&other);
+		return o != nullptr && o->poly == poly;
+	}
 };
 
 class CSG_OPNode : public CSG_TreeNode
@@ -236,6 +574,9 @@ class CSG_OPNode : public CSG_TreeNode
 	bool rescale;
 	CSG::CLASSIFY_TYPE classify_type;
 
+protected:
+	bool isCacheable() const override { return true; }
+
 public:
 	CSG_OPNode(CSG_TreeNode* _left, CSG_TreeNode* _right, CSG::OP _op,
 			bool _rescale,
@@ -252,6 +593,22 @@ public:
 		delete right;
 	}
 
+	size_t computeHash() const override
+	{
+		size_t h = std::hash<int>()(op);
+		h = detail::hashCombine(h, classify_type * 2 + rescale);
+		h = detail::hashCombine(h, left->hash());
+		return detail::hashCombine(h, right->hash());
+	}
+
+	bool equal(const CSG_TreeNode& other) const override
+	{
+		const CSG_OPNode* o = dynamic_cast<const CSG_OPNode*>(&other);
+		return o != nullptr && o->op == op && o->rescale == rescale &&
+				o->classify_type == classify_type && left->equal(*o->left) &&
+				right->equal(*o->right);
+	}
+
 	void minmax(double& min_x, double& min_y, double& min_z, double& max_x,
 			double& max_y, double& max_z,
 			const std::vector<carve::geom3d::Vector>& points)
@@ -267,33 +624,54 @@ public:
 		}
 	}
 
-	virtual carve::mesh::MeshSet<3>* evalScaled(bool& is_temp, CSG& csg)
+	// Evaluate both children into l and r, with any transformation they
+	// leave pending applied. If \a frame is not null, the operands may
+	// be left in another frame (see detail::chooseFrame()), and *frame is
+	// set to the transformation to apply to the result.
+	void evalOperands(detail::TransformedView& l, detail::TransformedView& r,
+			CSG& csg, carve::math::Matrix* frame)
 	{
-		carve::mesh::MeshSet<3>*l, *r;
+		std::vector<carve::math::Matrix> pending(2);
 		bool l_temp, r_temp;
 
-		l = left->eval(l_temp, csg);
-		r = right->eval(r_temp, csg);
+		carve::mesh::MeshSet<3>* l_poly = evalChildDeferred(left, l_temp, pending[0], csg);
+		l.reset(l_poly, l_temp);
+		carve::mesh::MeshSet<3>* r_poly = evalChildDeferred(right, r_temp, pending[1], csg);
+		r.reset(r_poly, r_temp);
 
-		if (!l_temp)
+		if (frame != nullptr)
 		{
-			l = l->clone();
+			detail::chooseFrame({ l_poly, r_poly }, { l_temp, r_temp }, pending, *frame);
 		}
-		if (!r_temp)
+
+		const carve::math::Matrix ident = carve::math::Matrix::IDENT();
+		if (pending[0] != ident)
 		{
-			r = r->clone();
+			l.transform(carve::math::matrix_transformation(pending[0]));
 		}
+		if (pending[1] != ident)
+		{
+			r.transform(carve::math::matrix_transformation(pending[1]));
+		}
+	}
+
+	virtual carve::mesh::MeshSet<3>* evalScaled(bool& is_temp, CSG& csg)
+	{
+		// rescaling moves both operands anyway, so there is no frame to
+		// keep.
+		detail::TransformedView l, r;
+		evalOperands(l, r, csg, nullptr);
 
 		carve::geom3d::Vector min, max;
 		carve::geom3d::Vector min_l, max_l;
 		carve::geom3d::Vector min_r, max_r;
 
-		carve::geom::bounds<3>(l->vertex_storage.begin(), l->vertex_storage.end(),
-				carve::mesh::Face<3>::vector_mapping(), min_l,
-				max_l);
-		carve::geom::bounds<3>(r->vertex_storage.begin(), r->vertex_storage.end(),
-				carve::mesh::Face<3>::vector_mapping(), min_r,
-				max_r);
+		carve::geom::bounds<3>(l.get()->vertex_storage.begin(),
+				l.get()->vertex_storage.end(),
+				carve::mesh::Face<3>::vector_mapping(), min_l, max_l);
+		carve::geom::bounds<3>(r.get()->vertex_storage.begin(),
+				r.get()->vertex_storage.end(),
+				carve::mesh::Face<3>::vector_mapping(), min_r, max_r);
 
 		carve::geom::assign_op(min, min_l, min_r, carve::util::min_functor());
 		carve::geom::assign_op(max, max_l, max_r, carve::util::max_functor());
@@ -303,22 +681,22 @@ public:
 		carve::rescale::fwd fwd_r(scaler);
 		carve::rescale::rev rev_r(scaler);
 
-		l->transform(fwd_r);
-		r->transform(fwd_r);
+		l.transform(fwd_r);
+		r.transform(fwd_r);
 
 		carve::mesh::MeshSet<3>* result = nullptr;
 		{
 			static carve::TimingName FUNC_NAME("csg.compute()");
 			carve::TimingBlock block(FUNC_NAME);
-			result = csg.compute(l, r, op, nullptr, classify_type);
+			result = csg.compute(l.get(), r.get(), op, nullptr, classify_type);
 		}
 
 		{
 			static carve::TimingName FUNC_NAME("delete polyhedron");
 			carve::TimingBlock block(FUNC_NAME);
 
-			delete l;
-			delete r;
+			l.reset();
+			r.reset();
 		}
 
 		result->transform(rev_r);
@@ -329,31 +707,29 @@ public:
 
 	virtual carve::mesh::MeshSet<3>* evalUnscaled(bool& is_temp, CSG& csg)
 	{
-		carve::mesh::MeshSet<3>*l, *r;
-		bool l_temp, r_temp;
-
-		l = left->eval(l_temp, csg);
-		r = right->eval(r_temp, csg);
+		detail::TransformedView l, r;
+		carve::math::Matrix frame;
+		evalOperands(l, r, csg, &frame);
 
 		carve::mesh::MeshSet<3>* result = nullptr;
 		{
 			static carve::TimingName FUNC_NAME("csg.compute()");
 			carve::TimingBlock block(FUNC_NAME);
-			result = csg.compute(l, r, op, nullptr, classify_type);
+			result = csg.compute(l.get(), faceTree(l, csg), r.get(),
+					faceTree(r, csg), op, nullptr, classify_type);
 		}
 
 		{
 			static carve::TimingName FUNC_NAME("delete polyhedron");
 			carve::TimingBlock block(FUNC_NAME);
 
-			if (l_temp)
-			{
-				delete l;
-			}
-			if (r_temp)
-			{
-				delete r;
-			}
+			l.reset();
+			r.reset();
+		}
+
+		if (frame != carve::math::Matrix::IDENT())
+		{
+			result->transform(carve::math::matrix_transformation(frame));
 		}
 
 		is_temp = true;
@@ -372,5 +748,683 @@ public:
 		}
 	}
 };
+
+/**
+ * \class CSG_NaryOPNode
+ * \brief A union or intersection of any number of operands.
+ *
+ * Operands are ordered so that spatially close operands are adjacent,
+ * and are then combined pairwise in a balanced reduction. Operands whose
+ * bounding boxes are disjoint are combined without a boolean operation.
+ * Unless the CSG object passed to eval() has hooks registered (which
+ * may not be shared between threads), the children and the pairs of
+ * each level of the reduction are evaluated concurrently, each with its
+ * own CSG object.
+ */
+class CSG_NaryOPNode : public CSG_TreeNode
+{
+	using meshset_t = carve::mesh::MeshSet<3>;
+
+	std::vector<CSG_TreeNode*> children;
+	CSG::OP op;
+	bool rescale;
+	CSG::CLASSIFY_TYPE classify_type;
+
+protected:
+	bool isCacheable() const override { return true; }
+
+private:
+
+	struct operand_t
+	{
+		meshset_t* poly;
+		bool is_temp;
+		const CSG::face_rtree_t* rtree;
+		operand_t() : poly(nullptr), is_temp(false), rtree(nullptr) {}
+		operand_t(meshset_t* _poly, bool _is_temp,
+				const CSG::face_rtree_t* _rtree = nullptr)
+				: poly(_poly), is_temp(_is_temp), rtree(_rtree) {}
+	};
+
+	static void release(operand_t& o)
+	{
+		if (o.is_temp)
+		{
+			delete o.poly;
+		}
+		o = operand_t();
+	}
+
+	static void release(std::vector<operand_t>& operands)
+	{
+		for (size_t i = 0; i < operands.size(); ++i)
+		{
+			release(operands[i]);
+		}
+	}
+
+	// The operands held by views, with ownership of those that are
+	// temporary passed on; the others stay with their views.
+	static std::vector<operand_t> takeOperands(
+			std::vector<detail::TransformedView>& views, CSG& csg)
+	{
+		std::vector<operand_t> operands(views.size());
+		for (size_t i = 0; i < views.size(); ++i)
+		{
+			if (views[i].isTemp())
+			{
+				operands[i] = operand_t(views[i].take(), true);
+			}
+			else
+			{
+				operands[i] = operand_t(views[i].get(), false, faceTree(views[i], csg));
+			}
+		}
+		return operands;
+	}
+
+	// Give a CSG object that evaluates part of the node on another
+	// thread the settings, but not the hooks, of the one passed to eval().
+	static void copySettings(CSG& to, const CSG& from)
+	{
+		to.pass_through_shells = from.pass_through_shells;
+		to.tree_cache = from.tree_cache;
+	}
+
+	static bool hasHooks(CSG& csg)
+	{
+		for (unsigned i = 0; i < CSG::Hooks::HOOK_MAX; ++i)
+		{
+			if (csg.hooks.hasHook(i))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// true if every mesh of poly is a closed, positive solid, so that
+	// its bounding box bounds the volume it encloses.
+	static bool isBounded(const meshset_t* poly)
+	{
+		for (size_t i = 0; i < poly->meshes.size(); ++i)
+		{
+			if (!poly->meshes[i]->isClosed() || poly->meshes[i]->isNegative())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Order idx[lo, hi) by recursively splitting at the median of the box
+	// centres along their longest axis, so that neighbouring operands in
+	// the resulting order are close to each other.
+	static void spatialOrder(std::vector<size_t>& idx, size_t lo, size_t hi,
+			const std::vector<carve::geom3d::Vector>& centre)
+	{
+		if (hi - lo < 3)
+		{
+			return;
+		}
+		carve::geom3d::Vector min = centre[idx[lo]], max = centre[idx[lo]];
+		for (size_t i = lo + 1; i < hi; ++i)
+		{
+			carve::geom::assign_op(min, min, centre[idx[i]], carve::util::min_functor());
+			carve::geom::assign_op(max, max, centre[idx[i]], carve::util::max_functor());
+		}
+		const size_t axis = carve::geom::largestAxis(max - min);
+		const size_t mid = lo + (hi - lo) / 2;
+		std::nth_element(idx.begin() + lo, idx.begin() + mid, idx.begin() + hi,
+				[&](size_t a, size_t b) { return centre[a].v[axis] < centre[b].v[axis]; });
+		spatialOrder(idx, lo, mid, centre);
+		spatialOrder(idx, mid, hi, centre);
+	}
+
+	// The union of two operands with disjoint bounds: their meshes,
+	// gathered into one mesh set.
+	static meshset_t* concatenate(operand_t& a, operand_t& b)
+	{
+		std::vector<meshset_t::mesh_t*> meshes;
+		operand_t* o[2] = { &a, &b };
+		for (size_t i = 0; i < 2; ++i)
+		{
+			meshset_t* poly = o[i]->poly;
+			if (o[i]->is_temp)
+			{
+				for (size_t m = 0; m < poly->meshes.size(); ++m)
+				{
+					poly->meshes[m]->meshset = nullptr;
+					meshes.push_back(poly->meshes[m]);
+				}
+				poly->meshes.clear();
+			}
+			else if (!poly->vertex_storage.empty())
+			{
+				meshset_t::vertex_t* base = &poly->vertex_storage[0];
+				for (size_t m = 0; m < poly->meshes.size(); ++m)
+				{
+					meshes.push_back(poly->meshes[m]->clone(base, base));
+				}
+			}
+		}
+		// the meshes still refer to the vertices of a and b, which are
+		// copied here; a and b are released by the caller.
+		return new meshset_t(meshes);
+	}
+
+	meshset_t* combine(operand_t& a, operand_t& b, CSG& csg) const
+	{
+		// hooks (triangulators, interpolators and so on) must see every
+		// output face, so with any registered, disjoint operands also go
+		// through compute().
+		if (!hasHooks(csg) && isBounded(a.poly) && isBounded(b.poly))
+		{
+			bool disjoint = a.poly->meshes.empty() || b.poly->meshes.empty();
+			if (!disjoint)
+			{
+				meshset_t::aabb_t a_box = a.poly->getAABB();
+				a_box.expand(carve::EPSILON);
+				disjoint = !a_box.intersects(b.poly->getAABB());
+			}
+			if (disjoint)
+			{
+				if (op == CSG::UNION)
+				{
+					return concatenate(a, b);
+				}
+				std::vector<meshset_t::mesh_t*> none;
+				return new meshset_t(none);
+			}
+		}
+
+		static carve::TimingName FUNC_NAME("csg.compute()");
+		carve::TimingBlock block(FUNC_NAME);
+		return csg.compute(a.poly, a.rtree, b.poly, b.rtree, op, nullptr,
+				classify_type);
+	}
+
+	meshset_t* reduce(std::vector<operand_t>& operands, CSG& csg,
+			bool concurrent) const
+	{
+		const size_t n = operands.size();
+		std::vector<carve::geom3d::Vector> centre(n);
+		std::vector<size_t> idx(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			idx[i] = i;
+			if (!operands[i].poly->meshes.empty())
+			{
+				centre[i] = operands[i].poly->getAABB().pos;
+			}
+		}
+		spatialOrder(idx, 0, n, centre);
+
+		std::vector<operand_t> level(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			level[i] = operands[idx[i]];
+		}
+		operands.clear();
+
+		try
+		{
+			while (level.size() > 1)
+			{
+				std::vector<operand_t> next((level.size() + 1) / 2);
+				const size_t n_pairs = level.size() / 2;
+				if (level.size() % 2)
+				{
+					next.back() = level.back();
+					level.back() = operand_t();
+				}
+				try
+				{
+					if (concurrent)
+					{
+						carve::parallel::for_each_index(0, n_pairs, 1, [&](size_t i) {
+							CSG pair_csg;
+							copySettings(pair_csg, csg);
+							next[i] = operand_t(
+									combine(level[2 * i], level[2 * i + 1], pair_csg), true);
+						});
+					}
+					else
+					{
+						for (size_t i = 0; i < n_pairs; ++i)
+						{
+							next[i] = operand_t(
+									combine(level[2 * i], level[2 * i + 1], csg), true);
+						}
+					}
+				}
+				catch (...)
+				{
+					release(next);
+					throw;
+				}
+				release(level);
+				level.swap(next);
+			}
+		}
+		catch (...)
+		{
+			release(level);
+			throw;
+		}
+
+		if (!level[0].is_temp)
+		{
+			level[0] = operand_t(level[0].poly->clone(), true);
+		}
+		return level[0].poly;
+	}
+
+public:
+	CSG_NaryOPNode(CSG::OP _op, bool _rescale,
+			CSG::CLASSIFY_TYPE _classify_type = CSG::CLASSIFY_NORMAL)
+			: children(), op(_op), rescale(_rescale), classify_type(_classify_type)
+	{
+		CARVE_ASSERT(op == CSG::UNION || op == CSG::INTERSECTION);
+	}
+
+	template<typename T>
+	CSG_NaryOPNode(T start, T end, CSG::OP _op, bool _rescale,
+			CSG::CLASSIFY_TYPE _classify_type = CSG::CLASSIFY_NORMAL)
+			: children(start, end),
+				op(_op),
+				rescale(_rescale),
+				classify_type(_classify_type)
+	{
+		CARVE_ASSERT(op == CSG::UNION || op == CSG::INTERSECTION);
+	}
+
+	~CSG_NaryOPNode() override
+	{
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			delete children[i];
+		}
+	}
+
+	CSG::OP getOp() const { return op; }
+
+	size_t computeHash() const override
+	{
+		size_t h = std::hash<int>()(op);
+		h = detail::hashCombine(h, classify_type * 2 + rescale + 4);
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			h = detail::hashCombine(h, children[i]->hash());
+		}
+		return h;
+	}
+
+	bool equal(const CSG_TreeNode& other) const override
+	{
+		const CSG_NaryOPNode* o = dynamic_cast<const CSG_NaryOPNode*>(&other);
+		if (o == nullptr || o->op != op || o->rescale != rescale ||
+				o->classify_type != classify_type ||
+				o->children.size() != children.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < children.size(); ++i)
+		{
+			if (!children[i]->equal(*o->children[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/// Add an operand; the node takes ownership of \a child.
+	void addChild(CSG_TreeNode* child)
+	{
+		children.push_back(child);
+		resetHash();
+	}
+
+	carve::mesh::MeshSet<3>* eval(bool& is_temp, CSG& csg) override
+	{
+		CARVE_ASSERT(!children.empty());
+
+		const bool concurrent = !hasHooks(csg);
+		const size_t n = children.size();
+		std::vector<operand_t> operands(n);
+		std::vector<carve::math::Matrix> pending(n);
+
+		try
+		{
+			if (concurrent)
+			{
+				carve::parallel::for_each_index(0, n, 1, [&](size_t i) {
+					CSG child_csg;
+					copySettings(child_csg, csg);
+					bool temp;
+					meshset_t* poly = evalChildDeferred(children[i], temp, pending[i], child_csg);
+					operands[i] = operand_t(poly, temp);
+				});
+			}
+			else
+			{
+				for (size_t i = 0; i < n; ++i)
+				{
+					bool temp;
+					meshset_t* poly = evalChildDeferred(children[i], temp, pending[i], csg);
+					operands[i] = operand_t(poly, temp);
+				}
+			}
+		}
+		catch (...)
+		{
+			release(operands);
+			throw;
+		}
+
+		// rescaling moves every operand anyway, so only without it may
+		// the operands be combined in another frame.
+		const carve::math::Matrix ident = carve::math::Matrix::IDENT();
+		carve::math::Matrix frame = ident;
+		if (!rescale)
+		{
+			std::vector<const meshset_t*> polys(n);
+			std::vector<bool> owned(n);
+			for (size_t i = 0; i < n; ++i)
+			{
+				polys[i] = operands[i].poly;
+				owned[i] = operands[i].is_temp;
+			}
+			detail::chooseFrame(polys, owned, pending, frame);
+		}
+
+		// operands to be transformed; those that are not owned by this node
+		// are copied when first transformed, so several operands may share
+		// one input mesh set.
+		std::vector<detail::TransformedView> views(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			views[i].reset(operands[i].poly, operands[i].is_temp);
+		}
+		operands.clear();
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (pending[i] != ident)
+			{
+				views[i].transform(carve::math::matrix_transformation(pending[i]));
+			}
+		}
+
+		is_temp = true;
+
+		carve::geom3d::Vector min, max;
+		bool has_bounds = false;
+		for (size_t i = 0; rescale && i < n; ++i)
+		{
+			const std::vector<meshset_t::vertex_t>& vs = views[i].get()->vertex_storage;
+			if (vs.empty())
+			{
+				continue;
+			}
+			carve::geom3d::Vector o_min, o_max;
+			carve::geom::bounds<3>(vs.begin(), vs.end(),
+					carve::mesh::Face<3>::vector_mapping(), o_min, o_max);
+			if (!has_bounds)
+			{
+				min = o_min;
+				max = o_max;
+				has_bounds = true;
+			}
+			else
+			{
+				carve::geom::assign_op(min, min, o_min, carve::util::min_functor());
+				carve::geom::assign_op(max, max, o_max, carve::util::max_functor());
+			}
+		}
+
+		if (!has_bounds)
+		{
+			operands = takeOperands(views, csg);
+			meshset_t* result = reduce(operands, csg, concurrent);
+			if (frame != ident)
+			{
+				result->transform(carve::math::matrix_transformation(frame));
+			}
+			return result;
+		}
+
+		carve::rescale::rescale scaler(min.x, min.y, min.z, max.x, max.y, max.z);
+		carve::rescale::fwd fwd_r(scaler);
+		carve::rescale::rev rev_r(scaler);
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			views[i].transform(fwd_r);
+		}
+
+		operands = takeOperands(views, csg);
+		meshset_t* result = reduce(operands, csg, concurrent);
+		result->transform(rev_r);
+		return result;
+	}
+};
+
+/**
+ * \class CSG_TreeCache
+ * \brief Results of CSG tree nodes, shared between structurally equal
+ * subexpressions.
+ *
+ * When CSG::tree_cache points to a cache, the boolean, inversion and
+ * selection nodes of a tree evaluated with that CSG object are looked
+ * up here (by CSG_TreeNode::hash() and CSG_TreeNode::equal()) before
+ * they are computed. Each result is computed once, and is then kept
+ * read-only, together with its face R-tree, and handed out as a mesh
+ * set that the caller does not own. Leaf mesh sets get their face
+ * R-trees kept here too.
+ *
+ * The cache refers to the nodes and leaf mesh sets of the trees
+ * evaluated with it, and must be cleared before any of them are
+ * deleted or modified. It may be used by the threads of one
+ * evaluation, but not by several evaluations at once.
+ */
+class CSG_TreeCache
+{
+	using meshset_t = carve::mesh::MeshSet<3>;
+	using face_rtree_t = CSG::face_rtree_t;
+
+	struct entry_t
+	{
+		meshset_t* poly;
+		bool ready;
+		entry_t() : poly(nullptr), ready(false) {}
+	};
+
+	struct node_hash
+	{
+		size_t operator()(const CSG_TreeNode* node) const { return node->hash(); }
+	};
+
+	struct node_equal
+	{
+		bool operator()(const CSG_TreeNode* a, const CSG_TreeNode* b) const
+		{
+			return a->hash() == b->hash() && a->equal(*b);
+		}
+	};
+
+	std::unordered_map<const CSG_TreeNode*, entry_t, node_hash, node_equal> entries;
+	std::unordered_map<const meshset_t*, face_rtree_t*> rtrees;
+	size_t n_hits;
+
+#if defined(CARVE_WITH_THREADS)
+	std::mutex mutex;
+	std::condition_variable computed;
+#endif
+
+	CSG_TreeCache(const CSG_TreeCache&) = delete;
+	CSG_TreeCache& operator=(const CSG_TreeCache&) = delete;
+
+public:
+	CSG_TreeCache() : n_hits(0) {}
+	~CSG_TreeCache() { clear(); }
+
+	/// The number of cached node results.
+	size_t size() const { return entries.size(); }
+
+	/// The number of evaluations answered from the cache.
+	size_t hits() const { return n_hits; }
+
+	void clear()
+	{
+		for (auto& i : entries)
+		{
+			delete i.second.poly;
+		}
+		for (auto& i : rtrees)
+		{
+			delete i.second;
+		}
+		entries.clear();
+		rtrees.clear();
+		n_hits = 0;
+	}
+
+	/**
+	 * \brief The result of \a node (or of a node equal to it), computing
+	 * it with \a csg if it is not cached yet. The cache keeps ownership
+	 * of the result.
+	 */
+	meshset_t* eval(CSG_TreeNode* node, CSG& csg)
+	{
+		{
+#if defined(CARVE_WITH_THREADS)
+			std::unique_lock<std::mutex> lock(mutex);
+#endif
+			while (true)
+			{
+				auto i = entries.find(node);
+				if (i == entries.end())
+				{
+					entries.emplace(node, entry_t());
+					break;
+				}
+				if (i->second.ready)
+				{
+					++n_hits;
+					return i->second.poly;
+				}
+				// another thread is computing an equal subexpression.
+#if defined(CARVE_WITH_THREADS)
+				computed.wait(lock);
+#else
+				CARVE_FAIL("recursive evaluation of a cached node");
+#endif
+			}
+		}
+
+		meshset_t* poly = nullptr;
+		face_rtree_t* rtree = nullptr;
+		try
+		{
+			bool is_temp;
+			meshset_t* result = node->eval(is_temp, csg);
+			poly = is_temp ? result : result->clone();
+			rtree = face_rtree_t::construct_STR(poly->faceBegin(), poly->faceEnd(), 4, 4);
+		}
+		catch (...)
+		{
+			delete poly;
+			{
+#if defined(CARVE_WITH_THREADS)
+				std::lock_guard<std::mutex> lock(mutex);
+#endif
+				entries.erase(node);
+			}
+#if defined(CARVE_WITH_THREADS)
+			computed.notify_all();
+#endif
+			throw;
+		}
+
+		{
+#if defined(CARVE_WITH_THREADS)
+			std::lock_guard<std::mutex> lock(mutex);
+#endif
+			entry_t& entry = entries.find(node)->second;
+			entry.poly = poly;
+			entry.ready = true;
+			rtrees[poly] = rtree;
+		}
+#if defined(CARVE_WITH_THREADS)
+		computed.notify_all();
+#endif
+		return poly;
+	}
+
+	/**
+	 * \brief The face R-tree of \a poly, which is either a cached result
+	 * or a mesh set at a leaf of the tree, building and keeping it if
+	 * necessary.
+	 */
+	const face_rtree_t* faceTree(meshset_t* poly)
+	{
+		{
+#if defined(CARVE_WITH_THREADS)
+			std::lock_guard<std::mutex> lock(mutex);
+#endif
+			auto i = rtrees.find(poly);
+			if (i != rtrees.end())
+			{
+				return i->second;
+			}
+		}
+		face_rtree_t* rtree =
+				face_rtree_t::construct_STR(poly->faceBegin(), poly->faceEnd(), 4, 4);
+#if defined(CARVE_WITH_THREADS)
+		std::lock_guard<std::mutex> lock(mutex);
+#endif
+		auto i = rtrees.emplace(poly, rtree);
+		if (!i.second)
+		{
+			// built concurrently by another thread.
+			delete rtree;
+		}
+		return i.first->second;
+	}
+};
+
+inline carve::mesh::MeshSet<3>* CSG_TreeNode::evalChild(CSG_TreeNode* child,
+		bool& is_temp, CSG& csg)
+{
+	if (csg.tree_cache != nullptr && child->isCacheable())
+	{
+		is_temp = false;
+		return csg.tree_cache->eval(child, csg);
+	}
+	return child->eval(is_temp, csg);
+}
+
+inline carve::mesh::MeshSet<3>* CSG_TreeNode::evalChildDeferred(
+		CSG_TreeNode* child, bool& is_temp, carve::math::Matrix& pending, CSG& csg)
+{
+	if (csg.tree_cache != nullptr && child->isCacheable())
+	{
+		is_temp = false;
+		pending = carve::math::Matrix::IDENT();
+		return csg.tree_cache->eval(child, csg);
+	}
+	return child->evalDeferred(is_temp, pending, csg);
+}
+
+inline const CSG::face_rtree_t* CSG_TreeNode::faceTree(
+		const detail::TransformedView& view, CSG& csg)
+{
+	if (csg.tree_cache == nullptr || view.isTemp())
+	{
+		return nullptr;
+	}
+	return csg.tree_cache->faceTree(view.get());
+}
 }
 } // namespace carve::csg
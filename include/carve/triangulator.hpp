@@ -111,7 +111,8 @@ struct tri_idx
  *
  * Given a 2-dimensional polygon described as a vector of 2-d
  * points, with no holes and no self-crossings, produce a
- * triangulation using an ear-clipping algorithm.
+ * triangulation using an ear-clipping algorithm, or, for large
+ * polygons, triangulateMonotone().
  *
  * @param [in] poly A vector containing the input polygon.
  * @param [out] result A vector of triangles, represented as
@@ -121,6 +122,26 @@ struct tri_idx
 CARVE_API void triangulate(const std::vector<carve::geom2d::P2>& poly,
 		std::vector<tri_idx>& result);
 
+/**
+ * \brief Triangulate a 2-dimensional polygon in O(n log n) time.
+ *
+ * The polygon is partitioned into y-monotone pieces by a plane
+ * sweep, and the pieces are triangulated. triangulate() uses this
+ * for polygons of at least MONOTONE_TRIANGULATION_THRESHOLD
+ * vertices, falling back to ear clipping if it fails.
+ *
+ * @param [in] poly A vector containing the input polygon.
+ * @param [out] result A vector of triangles, represented as
+ *                     indices into poly.
+ *
+ * @return false if poly could not be triangulated, for example
+ *         because it is not simple. result is then empty.
+ */
+CARVE_API bool triangulateMonotone(const std::vector<carve::geom2d::P2>& poly,
+		std::vector<tri_idx>& result);
+
+const size_t MONOTONE_TRIANGULATION_THRESHOLD = 96;
+
 /**
  * \brief Triangulate a polygon (templated).
  *
@@ -176,6 +197,45 @@ static inline void improve(const std::vector<carve::geom2d::P2>& poly,
 {
 	improve(carve::geom2d::p2_adapt_ident(), poly, result);
 }
+
+/**
+ * \brief Improve a triangulation of poly by flipping internal edges
+ * towards the constrained Delaunay triangulation.
+ *
+ * Edges are checked from a work queue, and a flip requeues the four
+ * edges around it. The number of flips is limited to
+ * DELAUNAY_FLIPS_PER_TRIANGLE times the number of triangles, so the
+ * result may fall short of Delaunay for large, badly shaped inputs.
+ * Degenerate triangles are flipped away where possible.
+ *
+ * @param [in] poly A vector containing the input polygon.
+ * @param [inout] result A vector of triangles, represented as
+ *                       indicies into poly, all with the same
+ *                       winding.
+ *
+ * @return The number of flips made.
+ */
+CARVE_API size_t improveDelaunay(const std::vector<carve::geom2d::P2>& poly,
+		std::vector<tri_idx>& result);
+
+/**
+ * \brief Improve a triangulation of poly by flipping internal edges
+ * towards the constrained Delaunay triangulation. (templated)
+ *
+ * @tparam project_t A functor which converts vertices to a 2d
+ *                   projection.
+ * @tparam vert_t    The vertex type.
+ * @param [in] project The projection functor.
+ * @param [in] poly A vector containing the input polygon,
+ *                  represented as vert_t pointers.
+ * @param [inout] result A vector of triangles, represented as
+ *                       indicies into poly.
+ */
+template<typename project_t, typename vert_t>
+size_t improveDelaunay(const project_t& project, const std::vector<vert_t>& poly,
+		std::vector<tri_idx>& result);
+
+const size_t DELAUNAY_FLIPS_PER_TRIANGLE = 8;
 }
 } // namespace carve::triangulate
 
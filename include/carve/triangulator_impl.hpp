@@ -881,6 +881,20 @@ void triangulate(const project_t& project, const std::vector<vert_t>& poly,
 		return;
 	}
 
+	if (N >= MONOTONE_TRIANGULATION_THRESHOLD)
+	{
+		std::vector<carve::geom2d::P2> points;
+		points.reserve(N);
+		for (size_t i = 0; i < N; ++i)
+		{
+			points.push_back(project(poly[i]));
+		}
+		if (triangulateMonotone(points, result))
+		{
+			return;
+		}
+	}
+
 	vinfo.resize(N);
 
 	vinfo[0] = new detail::vertex_info(project(poly[0]), 0);
@@ -998,5 +1012,18 @@ void improve(const project_t& project, const std::vector<vert_t>& poly,
 {
 	improve(project, poly, carve::geom::distance_functor(), result);
 }
+
+template<typename project_t, typename vert_t>
+size_t improveDelaunay(const project_t& project, const std::vector<vert_t>& poly,
+		std::vector<tri_idx>& result)
+{
+	std::vector<carve::geom2d::P2> points;
+	points.reserve(poly.size());
+	for (size_t i = 0; i < poly.size(); ++i)
+	{
+		points.push_back(project(poly[i]));
+	}
+	return improveDelaunay(points, result);
+}
 }
 } // namespace carve::triangulate
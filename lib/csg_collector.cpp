@@ -24,7 +24,13 @@
 
 #include "intersect_debug.hpp"
 #include <carve/csg.hpp>
+#include <carve/csg_collector.hpp>
+#include <carve/parallel.hpp>
+
+#include <algorithm>
 #include <iostream>
+#include <limits>
+#include <unordered_map>
 
 #if defined(CARVE_DEBUG_WRITE_PLY_DATA)
 void writePLY(const std::string& out_file, const carve::mesh::MeshSet<3>* poly,
@@ -35,365 +41,313 @@ namespace carve {
 namespace csg {
 namespace {
 
-class BaseCollector : public CSG::Collector
+// Pair the edges of the collected faces, whose vertices are in
+// vertex_storage, and build a mesh for each connected set of faces.
+// Edges are matched through the outgoing edges of their end vertex,
+// which are indexed by vertex, so no edge hashing or stitching is
+// needed. Returns false, leaving the faces untouched, when some
+// vertex pair has more than one edge in either direction.
+bool assembleMeshes(std::vector<carve::mesh::MeshSet<3>::face_t*>& f,
+		const std::vector<carve::mesh::MeshSet<3>::vertex_t>& vertex_storage,
+		std::vector<carve::mesh::MeshSet<3>::mesh_t*>& meshes)
 {
-	BaseCollector() = delete;
-	BaseCollector(const BaseCollector&) = delete;
-	BaseCollector& operator=(const BaseCollector&) = delete;
+	using vertex_t = carve::mesh::MeshSet<3>::vertex_t;
+	using edge_t = carve::mesh::MeshSet<3>::edge_t;
+	using face_t = carve::mesh::MeshSet<3>::face_t;
 
-protected:
-	struct face_data_t
-	{
-		carve::mesh::MeshSet<3>::face_t* face;
-		const carve::mesh::MeshSet<3>::face_t* orig_face;
-		bool flipped;
-		face_data_t(carve::mesh::MeshSet<3>::face_t* _face,
-				const carve::mesh::MeshSet<3>::face_t* _orig_face,
-				bool _flipped)
-				: face(_face), orig_face(_orig_face), flipped(_flipped){};
-	};
-
-	std::list<face_data_t> faces;
-
-	const carve::mesh::MeshSet<3>* src_a;
-	const carve::mesh::MeshSet<3>* src_b;
-
-	BaseCollector(const carve::mesh::MeshSet<3>* _src_a,
-			const carve::mesh::MeshSet<3>* _src_b)
-			: CSG::Collector(), src_a(_src_a), src_b(_src_b) {}
-
-	~BaseCollector() override = default;
-
-	void FWD(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector /* normal */, bool /* poly_a */,
-			FaceClass /* face_class */, CSG::Hooks& hooks)
+	const vertex_t* base = vertex_storage.data();
+	std::vector<size_t> first(vertex_storage.size() + 1, 0);
+	for (face_t* face : f)
 	{
-		std::vector<carve::mesh::MeshSet<3>::face_t*> new_faces;
-		new_faces.reserve(1);
-		new_faces.push_back(
-				orig_face->create(vertices.begin(), vertices.end(), false));
-		hooks.processOutputFace(new_faces, orig_face, false);
-		for (size_t i = 0; i < new_faces.size(); ++i)
+		edge_t* e = face->edge;
+		do
 		{
-			faces.push_back(face_data_t(new_faces[i], orig_face, false));
-		}
-
-#if defined(CARVE_DEBUG) && defined(DEBUG_PRINT_RESULT_FACES)
-		std::cerr << "+" << ENUM(face_class) << " ";
-		for (unsigned i = 0; i < vertices.size(); ++i)
-			std::cerr << " " << vertices[i] << ":" << *vertices[i];
-		std::cerr << std::endl;
-#endif
+			++first[e->vert - base + 1];
+			e = e->next;
+		} while (e != face->edge);
 	}
-
-	void REV(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector /* normal */, bool /* poly_a */,
-			FaceClass /* face_class */, CSG::Hooks& hooks)
+	for (size_t i = 1; i < first.size(); ++i)
 	{
-		// normal = -normal;
-		std::vector<carve::mesh::MeshSet<3>::face_t*> new_faces;
-		new_faces.reserve(1);
-		new_faces.push_back(
-				orig_face->create(vertices.begin(), vertices.end(), true));
-		hooks.processOutputFace(new_faces, orig_face, true);
-		for (size_t i = 0; i < new_faces.size(); ++i)
-		{
-			faces.push_back(face_data_t(new_faces[i], orig_face, true));
-		}
-
-#if defined(CARVE_DEBUG) && defined(DEBUG_PRINT_RESULT_FACES)
-		std::cerr << "-" << ENUM(face_class) << " ";
-		for (unsigned i = 0; i < vertices.size(); ++i)
-			std::cerr << " " << vertices[i] << ":" << *vertices[i];
-		std::cerr << std::endl;
-#endif
+		first[i] += first[i - 1];
 	}
 
-	virtual void collect(
-			const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector normal, bool poly_a, FaceClass face_class,
-			CSG::Hooks& hooks) = 0;
-
-	void collect(FaceLoopGroup* grp, CSG::Hooks& hooks) override
+	std::vector<edge_t*> out(first.back());
+	std::vector<size_t> pos(first.begin(), first.end() - 1);
+	for (face_t* face : f)
 	{
-		std::list<ClassificationInfo>& cinfo = (grp->classification);
-
-		if (cinfo.empty())
+		edge_t* e = face->edge;
+		do
 		{
-			std::cerr << "WARNING! group " << grp << " has no classification info!"
-								<< std::endl;
-			return;
-		}
-
-		FaceClass fc = FACE_UNCLASSIFIED;
-
-		unsigned fc_closed_bits = 0;
-		unsigned fc_open_bits = 0;
-		unsigned fc_bits = 0;
+			out[pos[e->vert - base]++] = e;
+			e = e->next;
+		} while (e != face->edge);
+	}
 
-		for (std::list<ClassificationInfo>::const_iterator
-						 i = grp->classification.begin(),
-						 e = grp->classification.end();
-				 i != e; ++i)
+	std::vector<edge_t*> rev(out.size(), nullptr);
+	for (size_t a = 0; a + 1 < first.size(); ++a)
+	{
+		for (size_t i = first[a]; i < first[a + 1]; ++i)
 		{
-			if ((*i).intersected_mesh == nullptr)
-			{
-				// classifier only returns global info
-				fc_closed_bits = class_to_class_bit((*i).classification);
-				break;
-			}
-
-			if ((*i).classification == FACE_UNCLASSIFIED)
-			{
-				continue;
-			}
-			if ((*i).intersectedMeshIsClosed())
+			const vertex_t* v2 = out[i]->v2();
+			for (size_t j = first[a]; j < first[a + 1]; ++j)
 			{
-				fc_closed_bits |= class_to_class_bit((*i).classification);
+				if (j != i && out[j]->v2() == v2)
+				{
+					return false;
+				}
 			}
-			else
+			const size_t b = v2 - base;
+			for (size_t j = first[b]; j < first[b + 1]; ++j)
 			{
-				fc_open_bits |= class_to_class_bit((*i).classification);
+				if (out[j]->v2() == out[i]->vert)
+				{
+					if (rev[i] != nullptr)
+					{
+						return false;
+					}
+					rev[i] = out[j];
+				}
 			}
 		}
+	}
+	for (size_t i = 0; i < out.size(); ++i)
+	{
+		out[i]->rev = rev[i];
+	}
 
-		if (fc_closed_bits)
+	// connected sets of faces, numbered by their first face, as the
+	// stitcher numbers them.
+	const size_t none = std::numeric_limits<size_t>::max();
+	for (size_t i = 0; i < f.size(); ++i)
+	{
+		f[i]->id = i;
+	}
+	std::vector<size_t> set(f.size(), none);
+	size_t n_sets = 0;
+	std::vector<size_t> queue;
+	for (size_t i = 0; i < f.size(); ++i)
+	{
+		if (set[i] != none)
 		{
-			fc_bits = fc_closed_bits;
+			continue;
 		}
-		else
+		set[i] = n_sets;
+		queue.assign(1, i);
+		for (size_t q = 0; q < queue.size(); ++q)
 		{
-			fc_bits = fc_open_bits;
+			edge_t* e = f[queue[q]]->edge;
+			do
+			{
+				if (e->rev != nullptr && set[e->rev->face->id] == none)
+				{
+					set[e->rev->face->id] = n_sets;
+					queue.push_back(e->rev->face->id);
+				}
+				e = e->next;
+			} while (e != f[queue[q]]->edge);
 		}
+		++n_sets;
+	}
+	std::vector<std::vector<face_t*>> mesh_faces(n_sets);
+	for (size_t i = 0; i < f.size(); ++i)
+	{
+		mesh_faces[set[i]].push_back(f[i]);
+	}
 
-		fc = class_bit_to_class(fc_bits);
+	meshes.resize(mesh_faces.size());
+	carve::parallel::for_each_index(0, mesh_faces.size(), 16, [&](size_t i) {
+		meshes[i] = new carve::mesh::MeshSet<3>::mesh_t(mesh_faces[i]);
+	});
+	return true;
+}
+} // namespace
 
-		// handle the complex cases where a group is classified differently with
-		// respect to two or more closed manifolds.
-		if (fc == FACE_UNCLASSIFIED)
-		{
-			unsigned inout_bits = fc_bits & FACE_NOT_ON_BIT;
-			unsigned on_bits = fc_bits & FACE_ON_BIT;
+FaceClass CollectorBase::groupClass(FaceLoopGroup* grp) const
+{
+	if (grp->classification.empty())
+	{
+		std::cerr << "WARNING! group " << grp << " has no classification info!"
+							<< std::endl;
+		return FACE_UNCLASSIFIED;
+	}
 
-			// both in and out. indicates an invalid manifold embedding.
-			if (inout_bits == (FACE_IN_BIT | FACE_OUT_BIT))
-			{
-				goto out;
-			}
+	FaceClass fc = FACE_UNCLASSIFIED;
 
-			// on, both orientations. could be caused by two manifolds touching at a
-			// face.
-			if (on_bits == (FACE_ON_ORIENT_IN_BIT | FACE_ON_ORIENT_OUT_BIT))
-			{
-				goto out;
-			}
+	unsigned fc_closed_bits = 0;
+	unsigned fc_open_bits = 0;
+	unsigned fc_bits = 0;
 
-			// in or out, but also on (with orientation). the on classification takes
-			// precedence.
-			fc = class_bit_to_class(on_bits);
+	for (std::list<ClassificationInfo>::const_iterator
+					 i = grp->classification.begin(),
+					 e = grp->classification.end();
+			 i != e; ++i)
+	{
+		if ((*i).intersected_mesh == nullptr)
+		{
+			// classifier only returns global info
+			fc_closed_bits = class_to_class_bit((*i).classification);
+			break;
 		}
 
-	out:
-
-		if (fc == FACE_UNCLASSIFIED)
+		if ((*i).classification == FACE_UNCLASSIFIED)
 		{
-			std::cerr << "group " << grp << " is unclassified!" << std::endl;
-
-#if defined(CARVE_DEBUG_WRITE_PLY_DATA)
-			static int uc_count = 0;
-
-			std::vector<carve::mesh::MeshSet<3>::face_t*> faces;
-
-			for (FaceLoop* f = grp->face_loops.head; f; f = f->next)
-			{
-				carve::mesh::MeshSet<3>::face_t* temp =
-						f->orig_face->create(f->vertices.begin(), f->vertices.end(), false);
-				faces.push_back(temp);
-			}
-
-			carve::mesh::MeshSet<3>* p = new carve::mesh::MeshSet<3>(faces);
-
-			std::ostringstream filename;
-			filename << "classifier_fail_" << ++uc_count << ".ply";
-			std::string out(filename.str().c_str());
-			::writePLY(out, p, false);
-
-			delete p;
-#endif
-
-			return;
+			continue;
 		}
-
-		bool is_poly_a = grp->src == src_a;
-
-		for (FaceLoop* f = grp->face_loops.head; f; f = f->next)
+		if ((*i).intersectedMeshIsClosed())
+		{
+			fc_closed_bits |= class_to_class_bit((*i).classification);
+		}
+		else
 		{
-			collect(f->orig_face, f->vertices, f->orig_face->plane.N, is_poly_a, fc,
-					hooks);
+			fc_open_bits |= class_to_class_bit((*i).classification);
 		}
 	}
 
-	carve::mesh::MeshSet<3>* done(CSG::Hooks& hooks) override
+	if (fc_closed_bits)
+	{
+		fc_bits = fc_closed_bits;
+	}
+	else
+	{
+		fc_bits = fc_open_bits;
+	}
+
+	fc = class_bit_to_class(fc_bits);
+
+	// handle the complex cases where a group is classified differently with
+	// respect to two or more closed manifolds.
+	if (fc == FACE_UNCLASSIFIED)
 	{
-		std::vector<carve::mesh::MeshSet<3>::face_t*> f;
-		f.reserve(faces.size());
-		for (std::list<face_data_t>::iterator i = faces.begin(); i != faces.end();
-				 ++i)
+		unsigned inout_bits = fc_bits & FACE_NOT_ON_BIT;
+		unsigned on_bits = fc_bits & FACE_ON_BIT;
+
+		// both in and out. indicates an invalid manifold embedding.
+		if (inout_bits == (FACE_IN_BIT | FACE_OUT_BIT))
 		{
-			f.push_back((*i).face);
+			goto out;
 		}
 
-		carve::mesh::MeshSet<3>* p = new carve::mesh::MeshSet<3>(f);
-
-		if (hooks.hasHook(carve::csg::CSG::Hooks::RESULT_FACE_HOOK))
+		// on, both orientations. could be caused by two manifolds touching at a
+		// face.
+		if (on_bits == (FACE_ON_ORIENT_IN_BIT | FACE_ON_ORIENT_OUT_BIT))
 		{
-			for (std::list<face_data_t>::iterator i = faces.begin(); i != faces.end();
-					 ++i)
-			{
-				hooks.resultFace((*i).face, (*i).orig_face, (*i).flipped);
-			}
+			goto out;
 		}
 
-		return p;
+		// in or out, but also on (with orientation). the on classification takes
+		// precedence.
+		fc = class_bit_to_class(on_bits);
 	}
-};
 
-class AllCollector : public BaseCollector
-{
-public:
-	AllCollector(const carve::mesh::MeshSet<3>* _src_a,
-			const carve::mesh::MeshSet<3>* _src_b)
-			: BaseCollector(_src_a, _src_b) {}
-	~AllCollector() override = default;
-	void collect(FaceLoopGroup* grp, CSG::Hooks& hooks) override
+out:
+
+	if (fc == FACE_UNCLASSIFIED)
 	{
+		std::cerr << "group " << grp << " is unclassified!" << std::endl;
+
+#if defined(CARVE_DEBUG_WRITE_PLY_DATA)
+		static int uc_count = 0;
+
+		std::vector<carve::mesh::MeshSet<3>::face_t*> faces;
+
 		for (FaceLoop* f = grp->face_loops.head; f; f = f->next)
 		{
-			FWD(f->orig_face, f->vertices, f->orig_face->plane.N,
-					f->orig_face->mesh->meshset == src_a, FACE_OUT, hooks);
+			carve::mesh::MeshSet<3>::face_t* temp =
+					f->orig_face->create(f->vertices.begin(), f->vertices.end(), false);
+			faces.push_back(temp);
 		}
+
+		carve::mesh::MeshSet<3>* p = new carve::mesh::MeshSet<3>(faces);
+
+		std::ostringstream filename;
+		filename << "classifier_fail_" << ++uc_count << ".ply";
+		std::string out(filename.str().c_str());
+		::writePLY(out, p, false);
+
+		delete p;
+#endif
 	}
-	void collect(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector normal, bool poly_a, FaceClass face_class,
-			CSG::Hooks& hooks) override
-	{
-		FWD(orig_face, vertices, normal, poly_a, face_class, hooks);
-	}
-};
 
-class UnionCollector : public BaseCollector
+	return fc;
+}
+
+CSG::meshset_t* CollectorBase::assemble()
 {
-public:
-	UnionCollector(const carve::mesh::MeshSet<3>* _src_a,
-			const carve::mesh::MeshSet<3>* _src_b)
-			: BaseCollector(_src_a, _src_b) {}
-	~UnionCollector() override = default;
-	void collect(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector normal, bool poly_a, FaceClass face_class,
-			CSG::Hooks& hooks) override
+	using vertex_t = carve::mesh::MeshSet<3>::vertex_t;
+	using edge_t = carve::mesh::MeshSet<3>::edge_t;
+	using mesh_t = carve::mesh::MeshSet<3>::mesh_t;
+
+	std::vector<carve::mesh::MeshSet<3>::face_t*> f;
+	f.reserve(faces.size());
+	for (size_t i = 0; i < faces.size(); ++i)
 	{
-		if (face_class == FACE_OUT ||
-				(poly_a && face_class == FACE_ON_ORIENT_OUT))
-		{
-			FWD(orig_face, vertices, normal, poly_a, face_class, hooks);
-		}
+		f.push_back(faces[i].face);
 	}
-};
 
-class IntersectionCollector : public BaseCollector
-{
-public:
-	IntersectionCollector(const carve::mesh::MeshSet<3>* _src_a,
-			const carve::mesh::MeshSet<3>* _src_b)
-			: BaseCollector(_src_a, _src_b) {}
-	~IntersectionCollector() override = default;
-	void collect(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector normal, bool poly_a, FaceClass face_class,
-			CSG::Hooks& hooks) override
+	// shells are cloned with their half-edge structure intact, still
+	// pointing at the input vertices.
+	std::vector<mesh_t*> shell_meshes;
+	for (size_t i = 0; i < shells.size(); ++i)
 	{
-		if (face_class == FACE_IN || (poly_a && face_class == FACE_ON_ORIENT_OUT))
+		vertex_t* base = const_cast<vertex_t*>(
+				&shells[i].first->meshset->vertex_storage[0]);
+		mesh_t* shell = shells[i].first->clone(base, base);
+		if (shells[i].second)
 		{
-			FWD(orig_face, vertices, normal, poly_a, face_class, hooks);
+			// orient the reversed shell as stitching its faces would.
+			shell->invert();
+			shell->calcOrientation();
 		}
+		shell_meshes.push_back(shell);
 	}
-};
 
-class SymmetricDifferenceCollector : public BaseCollector
-{
-public:
-	SymmetricDifferenceCollector(const carve::mesh::MeshSet<3>* _src_a,
-			const carve::mesh::MeshSet<3>* _src_b)
-			: BaseCollector(_src_a, _src_b) {}
-	~SymmetricDifferenceCollector() override = default;
-	void collect(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector normal, bool poly_a, FaceClass face_class,
-			CSG::Hooks& hooks) override
+	// copy every vertex in use into the result, in order of first use,
+	// and repoint the edges at the copies.
+	std::vector<vertex_t> vertex_storage;
 	{
-		if (face_class == FACE_OUT)
+		std::unordered_map<const vertex_t*, size_t> vert_idx;
+		std::vector<std::pair<edge_t*, size_t>> edge_vert;
+		auto compact = [&](carve::mesh::MeshSet<3>::face_t* face) {
+			edge_t* e = face->edge;
+			do
+			{
+				auto r = vert_idx.emplace(e->vert, vertex_storage.size());
+				if (r.second)
+				{
+					vertex_storage.push_back(vertex_t(e->vert->v));
+				}
+				edge_vert.push_back(std::make_pair(e, (*r.first).second));
+				e = e->next;
+			} while (e != face->edge);
+		};
+		for (size_t i = 0; i < f.size(); ++i)
 		{
-			FWD(orig_face, vertices, normal, poly_a, face_class, hooks);
+			compact(f[i]);
 		}
-		else if (face_class == FACE_IN)
+		for (size_t m = 0; m < shell_meshes.size(); ++m)
 		{
-			REV(orig_face, vertices, normal, poly_a, face_class, hooks);
-		}
-	}
-};
-
-class AMinusBCollector : public BaseCollector
-{
-public:
-	AMinusBCollector(const carve::mesh::MeshSet<3>* _src_a,
-			const carve::mesh::MeshSet<3>* _src_b)
-			: BaseCollector(_src_a, _src_b) {}
-	~AMinusBCollector() override = default;
-	void collect(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector normal, bool poly_a, FaceClass face_class,
-			CSG::Hooks& hooks) override
-	{
-		if ((face_class == FACE_OUT || face_class == FACE_ON_ORIENT_IN) && poly_a)
-		{
-			FWD(orig_face, vertices, normal, poly_a, face_class, hooks);
+			for (size_t i = 0; i < shell_meshes[m]->faces.size(); ++i)
+			{
+				compact(shell_meshes[m]->faces[i]);
+			}
 		}
-		else if (face_class == FACE_IN && !poly_a)
+		for (size_t i = 0; i < edge_vert.size(); ++i)
 		{
-			REV(orig_face, vertices, normal, poly_a, face_class, hooks);
+			edge_vert[i].first->vert = &vertex_storage[edge_vert[i].second];
 		}
 	}
-};
 
-class BMinusACollector : public BaseCollector
-{
-public:
-	BMinusACollector(const carve::mesh::MeshSet<3>* _src_a,
-			const carve::mesh::MeshSet<3>* _src_b)
-			: BaseCollector(_src_a, _src_b) {}
-	~BMinusACollector() override = default;
-	void collect(const carve::mesh::MeshSet<3>::face_t* orig_face,
-			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& vertices,
-			carve::geom3d::Vector normal, bool poly_a, FaceClass face_class,
-			CSG::Hooks& hooks) override
+	std::vector<mesh_t*> meshes;
+	if (!assembleMeshes(f, vertex_storage, meshes))
 	{
-		if ((face_class == FACE_OUT || face_class == FACE_ON_ORIENT_IN) &&
-				!poly_a)
-		{
-			FWD(orig_face, vertices, normal, poly_a, face_class, hooks);
-		}
-		else if (face_class == FACE_IN && poly_a)
-		{
-			REV(orig_face, vertices, normal, poly_a, face_class, hooks);
-		}
+		// non-manifold output edges need the full stitcher.
+		mesh_t::create(f.begin(), f.end(), meshes, carve::mesh::MeshOptions());
 	}
-};
-} // namespace
+	n_stitched = meshes.size();
+	meshes.insert(meshes.end(), shell_meshes.begin(), shell_meshes.end());
+
+	return new carve::mesh::MeshSet<3>(vertex_storage, meshes);
+}
 
 CSG::Collector* makeCollector(CSG::OP op, const carve::mesh::MeshSet<3>* poly_a,
 		const carve::mesh::MeshSet<3>* poly_b)
@@ -401,17 +355,18 @@ CSG::Collector* makeCollector(CSG::OP op, const carve::mesh::MeshSet<3>* poly_a,
 	switch (op)
 	{
 	case CSG::UNION:
-		return new UnionCollector(poly_a, poly_b);
+		return new StaticCollector<OpSelect<CSG::UNION>>(poly_a, poly_b);
 	case CSG::INTERSECTION:
-		return new IntersectionCollector(poly_a, poly_b);
+		return new StaticCollector<OpSelect<CSG::INTERSECTION>>(poly_a, poly_b);
 	case CSG::A_MINUS_B:
-		return new AMinusBCollector(poly_a, poly_b);
+		return new StaticCollector<OpSelect<CSG::A_MINUS_B>>(poly_a, poly_b);
 	case CSG::B_MINUS_A:
-		return new BMinusACollector(poly_a, poly_b);
+		return new StaticCollector<OpSelect<CSG::B_MINUS_A>>(poly_a, poly_b);
 	case CSG::SYMMETRIC_DIFFERENCE:
-		return new SymmetricDifferenceCollector(poly_a, poly_b);
+		return new StaticCollector<OpSelect<CSG::SYMMETRIC_DIFFERENCE>>(poly_a,
+				poly_b);
 	case CSG::ALL:
-		return new AllCollector(poly_a, poly_b);
+		return new StaticCollector<OpSelect<CSG::ALL>>(poly_a, poly_b);
 	}
 	return nullptr;
 }
@@ -449,11 +449,6 @@ void facesForObject(const carve::csg::IObj& obj,
 }
 } // namespace
 
-bool carve::csg::CSG::Hooks::hasHook(unsigned hook_num)
-{
-	return !hooks[hook_num].empty();
-}
-
 void carve::csg::CSG::Hooks::intersectionVertex(
 		const meshset_t::vertex_t* vertex, const IObjPairSet& intersections)
 {
@@ -475,6 +470,15 @@ void carve::csg::CSG::Hooks::processOutputFace(
 	}
 }
 
+void carve::csg::CSG::Hooks::processOutputFaces(std::vector<OutputFace>& faces)
+{
+	for (std::list<Hook*>::iterator j = hooks[PROCESS_OUTPUT_FACES_HOOK].begin();
+			 j != hooks[PROCESS_OUTPUT_FACES_HOOK].end(); ++j)
+	{
+		(*j)->processOutputFaces(faces);
+	}
+}
+
 void carve::csg::CSG::Hooks::resultFace(const meshset_t::face_t* new_face,
 		const meshset_t::face_t* orig_face,
 		bool flipped)
@@ -1484,6 +1488,172 @@ static void checkFaceLoopIntegrity(carve::csg::FaceLoopList& fll)
 	}
 }
 
+namespace {
+// Classify a shell as a whole by the first of its vertices that is not on
+// the surface of \a other.
+carve::csg::FaceClass classifyShell(const carve::mesh::MeshSet<3>::mesh_t* shell,
+		const carve::mesh::MeshSet<3>* other,
+		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* other_rtree)
+{
+	for (size_t i = 0; i < shell->faces.size(); ++i)
+	{
+		const carve::mesh::MeshSet<3>::edge_t* e = shell->faces[i]->edge;
+		do
+		{
+			carve::PointClass pc =
+					carve::mesh::classifyPoint(other, other_rtree, e->vert->v);
+			if (pc == carve::POINT_IN)
+			{
+				return carve::csg::FACE_IN;
+			}
+			if (pc == carve::POINT_OUT)
+			{
+				return carve::csg::FACE_OUT;
+			}
+			e = e->next;
+		} while (e != shell->faces[i]->edge);
+	}
+	return carve::csg::FACE_UNCLASSIFIED;
+}
+
+// The class of a point outside the bounds of \a other, as
+// carve::mesh::classifyPoint() reports it.
+carve::csg::FaceClass outsideClass(const carve::mesh::MeshSet<3>* other)
+{
+	if (other->meshes.size() == 1 && other->meshes[0]->isNegative())
+	{
+		return carve::csg::FACE_IN;
+	}
+	return carve::csg::FACE_OUT;
+}
+
+bool boundsOverlap(const carve::mesh::MeshSet<3>* a,
+		const carve::mesh::MeshSet<3>* b)
+{
+	if (a->meshes.empty() || b->meshes.empty())
+	{
+		return false;
+	}
+	carve::mesh::MeshSet<3>::aabb_t a_box = a->getAABB();
+	a_box.expand(carve::EPSILON);
+	return a_box.intersects(b->getAABB());
+}
+
+void initShellVertexClassification(const carve::mesh::MeshSet<3>* poly,
+		const std::vector<bool>& skip_shells, const carve::csg::detail::Data& data,
+		carve::csg::VertexClassification& vclass, int poly_num)
+{
+	for (size_t m = 0; m < poly->meshes.size(); ++m)
+	{
+		if (skip_shells[m])
+		{
+			continue;
+		}
+		const carve::mesh::MeshSet<3>::mesh_t* mesh = poly->meshes[m];
+		for (size_t i = 0; i < mesh->faces.size(); ++i)
+		{
+			const carve::mesh::MeshSet<3>::edge_t* e = mesh->faces[i]->edge;
+			do
+			{
+				vclass[carve::csg::map_vertex(data.vmap, e->vert)].cls[poly_num] =
+						carve::POINT_ON;
+				e = e->next;
+			} while (e != mesh->faces[i]->edge);
+		}
+	}
+}
+} // namespace
+
+void carve::csg::CSG::classifyUntouchedShells(meshset_t* poly,
+		meshset_t* other, const face_rtree_t* other_rtree,
+		std::vector<bool>& skip_shells, ShellClassification& shells)
+{
+	static carve::TimingName FUNC_NAME("CSG::classifyUntouchedShells()");
+	carve::TimingBlock block(FUNC_NAME);
+
+	const size_t n_shells = poly->meshes.size();
+	skip_shells.assign(n_shells, false);
+	if (poly->vertex_storage.empty())
+	{
+		return;
+	}
+
+	// map each vertex of poly to the shell that uses it. Shells that share
+	// a vertex are not passed through, so that the shared vertex is not
+	// duplicated in the result.
+	const meshset_t::vertex_t* v_base = &poly->vertex_storage[0];
+	const size_t n_vertices = poly->vertex_storage.size();
+	std::vector<size_t> vertex_shell(n_vertices, n_shells);
+	std::vector<bool> touched(n_shells + 1, false);
+	std::unordered_map<const meshset_t::mesh_t*, size_t> shell_index;
+	for (size_t m = 0; m < n_shells; ++m)
+	{
+		const meshset_t::mesh_t* mesh = poly->meshes[m];
+		shell_index[mesh] = m;
+		for (size_t i = 0; i < mesh->faces.size(); ++i)
+		{
+			const meshset_t::edge_t* e = mesh->faces[i]->edge;
+			do
+			{
+				size_t& owner = vertex_shell[(size_t)(e->vert - v_base)];
+				if (owner != n_shells && owner != m)
+				{
+					touched[owner] = true;
+					touched[m] = true;
+				}
+				owner = m;
+				e = e->next;
+			} while (e != mesh->faces[i]->edge);
+		}
+	}
+
+	// a shell is touched if any of its vertices, edges or faces take part
+	// in an intersection. Intersections are recorded symmetrically, so the
+	// outer keys cover every intersecting object.
+	for (Intersections::const_iterator i = intersections.begin(),
+																		 e = intersections.end();
+			 i != e; ++i)
+	{
+		const IObj& obj = (*i).first;
+		const meshset_t::mesh_t* mesh = nullptr;
+		switch (obj.obtype)
+		{
+		case IObj::OBTYPE_VERTEX:
+			if (obj.vertex >= v_base && obj.vertex < v_base + n_vertices)
+			{
+				touched[vertex_shell[(size_t)(obj.vertex - v_base)]] = true;
+			}
+			break;
+		case IObj::OBTYPE_EDGE:
+			mesh = obj.edge->face->mesh;
+			break;
+		case IObj::OBTYPE_FACE:
+			mesh = obj.face->mesh;
+			break;
+		default:
+			break;
+		}
+		if (mesh != nullptr && mesh->meshset == poly)
+		{
+			touched[shell_index[mesh]] = true;
+		}
+	}
+
+	for (size_t m = 0; m < n_shells; ++m)
+	{
+		if (touched[m])
+		{
+			continue;
+		}
+		FaceClass fc = classifyShell(poly->meshes[m], other, other_rtree);
+		if (fc != FACE_UNCLASSIFIED)
+		{
+			skip_shells[m] = true;
+			shells.push_back(std::make_pair(poly->meshes[m], fc));
+		}
+	}
+}
+
 /**
  *
  *
@@ -1503,7 +1673,8 @@ void carve::csg::CSG::calc(meshset_t* a, const face_rtree_t* a_rtree,
 		carve::csg::EdgeClassification& eclass,
 		carve::csg::FaceLoopList& a_face_loops,
 		carve::csg::FaceLoopList& b_face_loops,
-		size_t& a_edge_count, size_t& b_edge_count)
+		size_t& a_edge_count, size_t& b_edge_count,
+		ShellClassification* shells)
 {
 	detail::Data data;
 
@@ -1514,6 +1685,26 @@ void carve::csg::CSG::calc(meshset_t* a, const face_rtree_t* a_rtree,
 
 	generateIntersections(a, a_rtree, b, b_rtree, data);
 
+	std::vector<bool> a_skip_shells;
+	std::vector<bool> b_skip_shells;
+	if (shells != nullptr)
+	{
+#if defined(CARVE_DEBUG)
+		std::cerr << "classifyUntouchedShells" << std::endl;
+#endif
+		classifyUntouchedShells(a, b, b_rtree, a_skip_shells, *shells);
+		classifyUntouchedShells(b, a, a_rtree, b_skip_shells, *shells);
+
+		// if nothing intersects, every shell has been classified whole, and
+		// there are no face loops to generate.
+		if (std::find(a_skip_shells.begin(), a_skip_shells.end(), false) == a_skip_shells.end() &&
+				std::find(b_skip_shells.begin(), b_skip_shells.end(), false) == b_skip_shells.end())
+		{
+			a_edge_count = b_edge_count = 0;
+			return;
+		}
+	}
+
 #if defined(CARVE_DEBUG)
 	std::cerr << "intersectingFacePairs" << std::endl;
 #endif
@@ -1550,8 +1741,10 @@ void carve::csg::CSG::calc(meshset_t* a, const face_rtree_t* a_rtree,
 #if defined(CARVE_DEBUG)
 	std::cerr << "generateFaceLoops" << std::endl;
 #endif
-	a_edge_count = generateFaceLoops(a, data, a_face_loops);
-	b_edge_count = generateFaceLoops(b, data, b_face_loops);
+	a_edge_count = generateFaceLoops(a, data, a_face_loops,
+			shells ? &a_skip_shells : nullptr);
+	b_edge_count = generateFaceLoops(b, data, b_face_loops,
+			shells ? &b_skip_shells : nullptr);
 
 #if defined(CARVE_DEBUG)
 	std::cerr << "generated " << a_edge_count << " edges for poly a" << std::endl;
@@ -1577,18 +1770,27 @@ void carve::csg::CSG::calc(meshset_t* a, const face_rtree_t* a_rtree,
 #if defined(CARVE_DEBUG)
 	std::cerr << "classify" << std::endl;
 #endif
-	// initialize some classification information.
-	for (std::vector<meshset_t::vertex_t>::iterator i = a->vertex_storage.begin(),
-																									e = a->vertex_storage.end();
-			 i != e; ++i)
+	// initialize some classification information. Vertices of shells
+	// that were classified whole never appear in a face loop.
+	if (shells != nullptr)
 	{
-		vclass[map_vertex(data.vmap, &(*i))].cls[0] = POINT_ON;
+		initShellVertexClassification(a, a_skip_shells, data, vclass, 0);
+		initShellVertexClassification(b, b_skip_shells, data, vclass, 1);
 	}
-	for (std::vector<meshset_t::vertex_t>::iterator i = b->vertex_storage.begin(),
-																									e = b->vertex_storage.end();
-			 i != e; ++i)
+	else
 	{
-		vclass[map_vertex(data.vmap, &(*i))].cls[1] = POINT_ON;
+		for (std::vector<meshset_t::vertex_t>::iterator i = a->vertex_storage.begin(),
+																										e = a->vertex_storage.end();
+				 i != e; ++i)
+		{
+			vclass[map_vertex(data.vmap, &(*i))].cls[0] = POINT_ON;
+		}
+		for (std::vector<meshset_t::vertex_t>::iterator i = b->vertex_storage.begin(),
+																										e = b->vertex_storage.end();
+				 i != e; ++i)
+		{
+			vclass[map_vertex(data.vmap, &(*i))].cls[1] = POINT_ON;
+		}
 	}
 	for (VertexIntersections::const_iterator i = vertex_intersections.begin(),
 																					 e = vertex_intersections.end();
@@ -1666,10 +1868,35 @@ void returnSharedEdges(carve::csg::V2Set& shared_edges,
 carve::mesh::MeshSet<3>* carve::csg::CSG::compute(
 		meshset_t* a, meshset_t* b, carve::csg::CSG::Collector& collector,
 		carve::csg::V2Set* shared_edges_ptr, CLASSIFY_TYPE classify_type)
+{
+	return compute(a, nullptr, b, nullptr, collector, shared_edges_ptr,
+			classify_type);
+}
+
+/**
+ *
+ *
+ * @param a
+ * @param a_rtree
+ * @param b
+ * @param b_rtree
+ * @param collector
+ * @param hooks
+ * @param shared_edges_ptr
+ * @param classify_type
+ *
+ * @return
+ */
+carve::mesh::MeshSet<3>* carve::csg::CSG::compute(meshset_t* a,
+		const face_rtree_t* a_rtree, meshset_t* b, const face_rtree_t* b_rtree,
+		carve::csg::CSG::Collector& collector,
+		carve::csg::V2Set* shared_edges_ptr, CLASSIFY_TYPE classify_type)
 {
 	static carve::TimingName FUNC_NAME("CSG::compute");
 	carve::TimingBlock block(FUNC_NAME);
 
+	n_group_classifications = 0;
+
 	VertexClassification vclass;
 	EdgeClassification eclass;
 
@@ -1682,16 +1909,59 @@ carve::mesh::MeshSet<3>* carve::csg::CSG::compute(
 	size_t a_edge_count;
 	size_t b_edge_count;
 
-	std::unique_ptr<face_rtree_t> a_rtree(
-			face_rtree_t::construct_STR(a->faceBegin(), a->faceEnd(), 4, 4));
-	std::unique_ptr<face_rtree_t> b_rtree(
-			face_rtree_t::construct_STR(b->faceBegin(), b->faceEnd(), 4, 4));
+	// shells that no intersection touches bypass face loop generation,
+	// grouping and stitching, if the collector can take them whole.
+	ShellClassification shells;
+	const bool pass_shells = pass_through_shells &&
+			classify_type != CLASSIFY_EDGE &&
+			collector.acceptsShells(hooks);
+
+	if (pass_shells && !boundsOverlap(a, b))
+	{
+		// nothing can intersect, and every shell lies outside the bounds
+		// of the other operand.
+		for (size_t i = 0; i < a->meshes.size(); ++i)
+		{
+			collector.collectShell(a->meshes[i], outsideClass(b), hooks);
+		}
+		for (size_t i = 0; i < b->meshes.size(); ++i)
+		{
+			collector.collectShell(b->meshes[i], outsideClass(a), hooks);
+		}
+		return collector.done(hooks);
+	}
+
+	std::unique_ptr<face_rtree_t> a_rtree_built;
+	std::unique_ptr<face_rtree_t> b_rtree_built;
+	if (a_rtree == nullptr)
+	{
+		a_rtree_built.reset(
+				face_rtree_t::construct_STR(a->faceBegin(), a->faceEnd(), 4, 4));
+		a_rtree = a_rtree_built.get();
+	}
+	if (b_rtree == nullptr)
+	{
+		b_rtree_built.reset(
+				face_rtree_t::construct_STR(b->faceBegin(), b->faceEnd(), 4, 4));
+		b_rtree = b_rtree_built.get();
+	}
 
 	{
 		static carve::TimingName FUNC_NAME1("CSG::compute - calc()");
 		carve::TimingBlock block(FUNC_NAME1);
-		calc(a, a_rtree.get(), b, b_rtree.get(), vclass, eclass, a_face_loops,
-				b_face_loops, a_edge_count, b_edge_count);
+		calc(a, a_rtree, b, b_rtree, vclass, eclass, a_face_loops,
+				b_face_loops, a_edge_count, b_edge_count,
+				pass_shells ? &shells : nullptr);
+	}
+
+	if (pass_shells && a_face_loops.size() == 0 && b_face_loops.size() == 0)
+	{
+		// every shell was classified whole.
+		for (size_t i = 0; i < shells.size(); ++i)
+		{
+			collector.collectShell(shells[i].first, shells[i].second, hooks);
+		}
+		return collector.done(hooks);
 	}
 
 	detail::LoopEdges a_edge_map;
@@ -1770,17 +2040,24 @@ carve::mesh::MeshSet<3>* carve::csg::CSG::compute(
 	switch (classify_type)
 	{
 	case CLASSIFY_EDGE:
-		classifyFaceGroupsEdge(shared_edges, vclass, a, a_rtree.get(),
-				a_loops_grouped, a_edge_map, b, b_rtree.get(),
+		classifyFaceGroupsEdge(shared_edges, vclass, a, a_rtree,
+				a_loops_grouped, a_edge_map, b, b_rtree,
 				b_loops_grouped, b_edge_map, collector);
 		break;
 	case CLASSIFY_NORMAL:
-		classifyFaceGroups(shared_edges, vclass, a, a_rtree.get(),
-				a_loops_grouped, a_edge_map, b, b_rtree.get(),
-				b_loops_grouped, b_edge_map, collector);
+	case CLASSIFY_FLOOD:
+		classifyFaceGroups(shared_edges, vclass, a, a_rtree,
+				a_loops_grouped, a_edge_map, b, b_rtree,
+				b_loops_grouped, b_edge_map, collector,
+				classify_type == CLASSIFY_FLOOD);
 		break;
 	}
 
+	for (size_t i = 0; i < shells.size(); ++i)
+	{
+		collector.collectShell(shells[i].first, shells[i].second, hooks);
+	}
+
 	meshset_t* result = collector.done(hooks);
 	if (result != nullptr && shared_edges_ptr != nullptr)
 	{
@@ -1806,6 +2083,28 @@ carve::mesh::MeshSet<3>* carve::csg::CSG::compute(
 carve::mesh::MeshSet<3>* carve::csg::CSG::compute(
 		meshset_t* a, meshset_t* b, carve::csg::CSG::OP op,
 		carve::csg::V2Set* shared_edges, CLASSIFY_TYPE classify_type)
+{
+	return compute(a, nullptr, b, nullptr, op, shared_edges, classify_type);
+}
+
+/**
+ *
+ *
+ * @param a
+ * @param a_rtree
+ * @param b
+ * @param b_rtree
+ * @param op
+ * @param hooks
+ * @param shared_edges
+ * @param classify_type
+ *
+ * @return
+ */
+carve::mesh::MeshSet<3>* carve::csg::CSG::compute(meshset_t* a,
+		const face_rtree_t* a_rtree, meshset_t* b, const face_rtree_t* b_rtree,
+		carve::csg::CSG::OP op, carve::csg::V2Set* shared_edges,
+		CLASSIFY_TYPE classify_type)
 {
 	Collector* coll = makeCollector(op, a, b);
 	if (!coll)
@@ -1813,7 +2112,8 @@ carve::mesh::MeshSet<3>* carve::csg::CSG::compute(
 		return nullptr;
 	}
 
-	meshset_t* result = compute(a, b, *coll, shared_edges, classify_type);
+	meshset_t* result = compute(a, a_rtree, b, b_rtree, *coll, shared_edges,
+			classify_type);
 
 	delete coll;
 
@@ -24,6 +24,11 @@
 
 #pragma once
 
+#include <carve/parallel.hpp>
+
+#include <functional>
+#include <limits>
+
 namespace carve {
 namespace csg {
 using GroupLookup = std::unordered_map<carve::mesh::MeshSet<3>::vertex_t*, std::list<FLGroupList::iterator>>;
@@ -152,23 +157,224 @@ inline void performClassifySimpleOnFaceGroups(FLGroupList& a_groups,
 	}
 }
 
+// For each face loop group, the groups of the same operand that it
+// meets across an intersection edge where the other operand crosses it
+// transversally. Such a pair of groups lies on opposite sides of the
+// other operand, so their classifications are opposite.
+using GroupFlips = std::unordered_map<const FaceLoopGroup*, std::vector<const FaceLoopGroup*>>;
+
+inline FaceClass oppositeClass(FaceClass fc)
+{
+	return fc == FACE_IN ? FACE_OUT : FACE_IN;
+}
+
+// Classify the connected regions of \a grps (under \a flips) by
+// calling classify() on a single seed group per region, and propagating
+// its result across the region. Where no seed decides a region, every
+// group of the region is tried, and the first decided one is propagated
+// instead. A region whose propagated classes are inconsistent falls
+// back to classifying each of its groups. Returns the number of
+// classify() calls made.
+template<typename func_t>
+inline size_t classifyGroupRegions(const std::vector<FLGroupList::iterator>& grps,
+		func_t& classify, const GroupFlips& flips, std::vector<FaceClass>& fc)
+{
+	const size_t n = grps.size();
+	std::unordered_map<const FaceLoopGroup*, size_t> index;
+	for (size_t i = 0; i < n; ++i)
+	{
+		index[&*grps[i]] = i;
+	}
+
+	auto forEachNeighbour = [&](size_t i, const std::function<void(size_t)>& f) {
+		GroupFlips::const_iterator j = flips.find(&*grps[i]);
+		if (j == flips.end())
+		{
+			return;
+		}
+		for (const FaceLoopGroup* g : (*j).second)
+		{
+			std::unordered_map<const FaceLoopGroup*, size_t>::const_iterator k = index.find(g);
+			if (k != index.end())
+			{
+				f((*k).second);
+			}
+		}
+	};
+
+	// label the regions, each starting from its first group in list order.
+	const size_t none = std::numeric_limits<size_t>::max();
+	std::vector<size_t> region(n, none);
+	std::vector<std::vector<size_t>> members;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (region[i] != none)
+		{
+			continue;
+		}
+		members.emplace_back();
+		std::vector<size_t>& m = members.back();
+		region[i] = members.size() - 1;
+		m.push_back(i);
+		for (size_t q = 0; q < m.size(); ++q)
+		{
+			forEachNeighbour(m[q], [&](size_t k) {
+				if (region[k] == none)
+				{
+					region[k] = region[i];
+					m.push_back(k);
+				}
+			});
+		}
+	}
+
+	size_t n_classified = 0;
+	auto classifyAll = [&](const std::vector<size_t>& todo) {
+		carve::parallel::for_each_index(0, todo.size(), 16,
+				[&](size_t i) { fc[todo[i]] = classify(*grps[todo[i]]); });
+		n_classified += todo.size();
+	};
+
+	std::vector<size_t> todo;
+	for (size_t r = 0; r < members.size(); ++r)
+	{
+		todo.push_back(members[r][0]);
+	}
+	classifyAll(todo);
+
+	todo.clear();
+	for (size_t r = 0; r < members.size(); ++r)
+	{
+		if (fc[members[r][0]] == FACE_UNCLASSIFIED)
+		{
+			todo.insert(todo.end(), members[r].begin() + 1, members[r].end());
+		}
+	}
+	classifyAll(todo);
+
+	todo.clear();
+	std::vector<FaceClass> prop(n, FACE_UNCLASSIFIED);
+	for (size_t r = 0; r < members.size(); ++r)
+	{
+		const std::vector<size_t>& m = members[r];
+		size_t s = 0;
+		while (s < m.size() && fc[m[s]] == FACE_UNCLASSIFIED)
+		{
+			++s;
+		}
+		if (s == m.size() || m.size() == 1)
+		{
+			continue;
+		}
+
+		// propagate breadth first from the decided group.
+		bool consistent = true;
+		std::vector<size_t> queue(1, m[s]);
+		prop[m[s]] = fc[m[s]];
+		for (size_t q = 0; q < queue.size(); ++q)
+		{
+			const FaceClass expect = oppositeClass(prop[queue[q]]);
+			forEachNeighbour(queue[q], [&](size_t k) {
+				if (prop[k] == FACE_UNCLASSIFIED)
+				{
+					prop[k] = expect;
+					queue.push_back(k);
+				}
+				else if (prop[k] != expect)
+				{
+					consistent = false;
+				}
+			});
+		}
+		for (size_t i : m)
+		{
+			if (fc[i] != FACE_UNCLASSIFIED && fc[i] != prop[i])
+			{
+				consistent = false;
+			}
+		}
+
+		if (consistent)
+		{
+			for (size_t i : m)
+			{
+				fc[i] = prop[i];
+			}
+		}
+		else
+		{
+			for (size_t i : m)
+			{
+				if (fc[i] == FACE_UNCLASSIFIED)
+				{
+					todo.push_back(i);
+				}
+			}
+		}
+	}
+	classifyAll(todo);
+	return n_classified;
+}
+
+// Classify the groups of \a groups concurrently with classify(group),
+// which returns FACE_UNCLASSIFIED for a group it cannot decide, and only
+// reads the group and the other operand. The groups that were decided
+// are then collected, in their original order, and removed. Given \a
+// flips, only one group per connected region is classified directly.
+// The number of classify() calls is added to \a n_classified.
+template<typename func_t>
+inline void collectClassifiedGroups(FLGroupList& groups, func_t classify,
+		CSG::Collector& collector, CSG::Hooks& hooks,
+		const GroupFlips* flips = nullptr, size_t* n_classified = nullptr)
+{
+	std::vector<FLGroupList::iterator> grps;
+	grps.reserve(groups.size());
+	for (FLGroupList::iterator i = groups.begin(); i != groups.end(); ++i)
+	{
+		grps.push_back(i);
+	}
+
+	std::vector<FaceClass> fc(grps.size(), FACE_UNCLASSIFIED);
+	size_t n = grps.size();
+	if (flips != nullptr)
+	{
+		n = classifyGroupRegions(grps, classify, *flips, fc);
+	}
+	else
+	{
+		carve::parallel::for_each_index(0, grps.size(), 16,
+				[&](size_t i) { fc[i] = classify(*grps[i]); });
+	}
+	if (n_classified != nullptr)
+	{
+		*n_classified += n;
+	}
+
+	for (size_t i = 0; i < grps.size(); ++i)
+	{
+		if (fc[i] == FACE_UNCLASSIFIED)
+		{
+			continue;
+		}
+		(*grps[i]).classification.push_back(ClassificationInfo(nullptr, fc[i]));
+		collector.collect(&*grps[i], hooks);
+		groups.erase(grps[i]);
+	}
+}
+
 template<typename CLASSIFIER>
 inline void performClassifyEasyFaceGroups(
 		FLGroupList& group, carve::mesh::MeshSet<3>* poly_a,
 		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* poly_a_rtree,
-		VertexClassification& vclass, const CLASSIFIER& classifier,
-		CSG::Collector& collector, CSG::Hooks& hooks)
+		const VertexClassification& vclass, const CLASSIFIER& classifier,
+		CSG::Collector& collector, CSG::Hooks& hooks,
+		const GroupFlips* flips = nullptr, size_t* n_classified = nullptr)
 {
-	for (FLGroupList::iterator i = group.begin(); i != group.end();)
-	{
+	collectClassifiedGroups(group, [&](FaceLoopGroup& grp) {
 #if defined(CARVE_DEBUG)
-		std::cerr << "............group " << &(*i) << std::endl;
+		std::cerr << "............group " << &grp << std::endl;
 #endif
-		FaceLoopGroup& grp = (*i);
-		FaceLoopList& curr = (grp.face_loops);
-		FaceClass fc;
-
-		for (FaceLoop* f = curr.head; f; f = f->next)
+		for (FaceLoop* f = grp.face_loops.head; f; f = f->next)
 		{
 			for (size_t j = 0; j < f->vertices.size(); ++j)
 			{
@@ -179,28 +385,13 @@ inline void performClassifyEasyFaceGroups(
 					if (pc == POINT_IN || pc == POINT_OUT)
 					{
 						classifier.explain(f, j, pc);
-					}
-					if (pc == POINT_IN)
-					{
-						fc = FACE_IN;
-						goto accept;
-					}
-					if (pc == POINT_OUT)
-					{
-						fc = FACE_OUT;
-						goto accept;
+						return pc == POINT_IN ? FACE_IN : FACE_OUT;
 					}
 				}
 			}
 		}
-		++i;
-		continue;
-	accept : {
-		grp.classification.push_back(ClassificationInfo(nullptr, fc));
-		collector.collect(&grp, hooks);
-		i = group.erase(i);
-	}
-	}
+		return FACE_UNCLASSIFIED;
+	}, collector, hooks, flips, n_classified);
 }
 
 template<typename CLASSIFIER>
@@ -208,17 +399,14 @@ inline void performClassifyHardFaceGroups(
 		FLGroupList& group, carve::mesh::MeshSet<3>* poly_a,
 		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* poly_a_rtree,
 		const CLASSIFIER& /* classifier */, CSG::Collector& collector,
-		CSG::Hooks& hooks)
+		CSG::Hooks& hooks, const GroupFlips* flips = nullptr,
+		size_t* n_classified = nullptr)
 {
-	for (FLGroupList::iterator i = group.begin(); i != group.end();)
-	{
+	collectClassifiedGroups(group, [&](FaceLoopGroup& grp) {
 		int n_in = 0, n_out = 0, n_on = 0;
-		FaceLoopGroup& grp = (*i);
-		FaceLoopList& curr = (grp.face_loops);
-		V2Set& perim = ((*i).perimeter);
-		FaceClass fc = FACE_UNCLASSIFIED;
+		const V2Set& perim = grp.perimeter;
 
-		for (FaceLoop* f = curr.head; f; f = f->next)
+		for (FaceLoop* f = grp.face_loops.head; f; f = f->next)
 		{
 			carve::mesh::MeshSet<3>::vertex_t *v1, *v2;
 			v1 = f->vertices.back();
@@ -255,25 +443,16 @@ inline void performClassifyHardFaceGroups(
 							<< " n_out: " << n_out << std::endl;
 #endif
 
-		if (!n_in && !n_out)
+		if (n_out)
 		{
-			++i;
-			continue;
+			return FACE_OUT;
 		}
-
 		if (n_in)
 		{
-			fc = FACE_IN;
-		}
-		if (n_out)
-		{
-			fc = FACE_OUT;
+			return FACE_IN;
 		}
-
-		grp.classification.push_back(ClassificationInfo(nullptr, fc));
-		collector.collect(&grp, hooks);
-		i = group.erase(i);
-	}
+		return FACE_UNCLASSIFIED;
+	}, collector, hooks, flips, n_classified);
 }
 
 template<typename CLASSIFIER>
@@ -281,21 +460,20 @@ void performFaceLoopWork(
 		carve::mesh::MeshSet<3>* poly_a,
 		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* poly_a_rtree,
 		FLGroupList& b_loops_grouped, const CLASSIFIER& classifier,
-		CSG::Collector& collector, CSG::Hooks& hooks)
+		CSG::Collector& collector, CSG::Hooks& hooks,
+		const GroupFlips* flips = nullptr, size_t* n_classified = nullptr)
 {
-	for (FLGroupList::iterator i = b_loops_grouped.begin(), e = b_loops_grouped.end(); i != e;)
-	{
+	collectClassifiedGroups(b_loops_grouped, [&](FaceLoopGroup& grp) {
 		FaceClass fc;
 
-		if (classifier.faceLoopSanityChecker(*i))
+		if (classifier.faceLoopSanityChecker(grp))
 		{
 			std::cerr << "UNEXPECTED face loop with size != 1." << std::endl;
-			++i;
-			continue;
+			return FACE_UNCLASSIFIED;
 		}
-		CARVE_ASSERT((*i).face_loops.size() == 1);
+		CARVE_ASSERT(grp.face_loops.size() == 1);
 
-		FaceLoop* fla = (*i).face_loops.head;
+		FaceLoop* fla = grp.face_loops.head;
 
 		const carve::mesh::MeshSet<3>::face_t* f = (fla->orig_face);
 		std::vector<carve::mesh::MeshSet<3>::vertex_t*>& loop = (fla->vertices);
@@ -338,11 +516,8 @@ void performFaceLoopWork(
 		std::cerr << "CLASS: " << (fc == FACE_IN ? "FACE_IN" : "FACE_OUT")
 							<< std::endl;
 #endif
-
-		(*i).classification.push_back(ClassificationInfo(nullptr, fc));
-		collector.collect(&*i, hooks);
-		i = b_loops_grouped.erase(i);
-	}
+		return fc;
+	}, collector, hooks, flips, n_classified);
 }
 
 template<typename CLASSIFIER>
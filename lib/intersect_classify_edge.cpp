@@ -29,6 +29,7 @@
 #include <carve/colour.hpp>
 #include <carve/csg.hpp>
 #include <carve/debug_hooks.hpp>
+#include <carve/parallel.hpp>
 
 #include <iostream>
 #include <list>
@@ -650,6 +651,76 @@ void generateCandidateOnSets(FLGroupList& a_grp, FLGroupList& b_grp,
 		}
 	}
 }
+
+// Classify the groups that no edge decided by the first of their
+// vertices that is IN or OUT of \a poly, looking the vertex up in
+// vclass.cls[cls] before classifying it. Groups are classified
+// concurrently, and the vertex classifications they compute are
+// recorded in vclass afterwards.
+void classifyNonIntersectingGroups(FLGroupList& groups,
+		VertexClassification& vclass, int cls, carve::mesh::MeshSet<3>* poly,
+		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* poly_rtree,
+		const char* error)
+{
+	using vertex_t = carve::mesh::MeshSet<3>::vertex_t;
+
+	std::vector<FaceLoopGroup*> grps;
+	for (FLGroupList::iterator i = groups.begin(); i != groups.end(); ++i)
+	{
+		if ((*i).classification.empty())
+		{
+			grps.push_back(&*i);
+		}
+	}
+
+	std::vector<FaceClass> fc(grps.size(), FACE_UNCLASSIFIED);
+	std::vector<std::vector<std::pair<const vertex_t*, PointClass>>> computed(
+			grps.size());
+
+	carve::parallel::for_each_index(0, grps.size(), 16, [&](size_t g) {
+#if defined(CARVE_DEBUG)
+		std::cerr << " non intersecting group (poly " << "ba"[cls]
+							<< "): " << grps[g] << std::endl;
+#endif
+		for (FaceLoop* fl = grps[g]->face_loops.head;
+				 fc[g] == FACE_UNCLASSIFIED && fl != nullptr; fl = fl->next)
+		{
+			for (size_t fli = 0; fc[g] == FACE_UNCLASSIFIED && fli < fl->vertices.size();
+					 ++fli)
+			{
+				const vertex_t* v = fl->vertices[fli];
+				VertexClassification::const_iterator vc = vclass.find(v);
+				PointClass pc = vc != vclass.end() ? (*vc).second.cls[cls] : POINT_UNK;
+				if (pc == POINT_UNK)
+				{
+					pc = carve::mesh::classifyPoint(poly, poly_rtree, v->v);
+					computed[g].push_back(std::make_pair(v, pc));
+				}
+				if (pc == POINT_IN)
+				{
+					fc[g] = FACE_IN;
+				}
+				else if (pc == POINT_OUT)
+				{
+					fc[g] = FACE_OUT;
+				}
+			}
+		}
+	});
+
+	for (size_t g = 0; g < grps.size(); ++g)
+	{
+		for (size_t i = 0; i < computed[g].size(); ++i)
+		{
+			vclass[computed[g][i].first].cls[cls] = computed[g][i].second;
+		}
+		if (fc[g] == FACE_UNCLASSIFIED)
+		{
+			throw carve::exception(error);
+		}
+		grps[g]->classification.push_back(ClassificationInfo(nullptr, fc[g]));
+	}
+}
 } // namespace
 
 void CSG::classifyFaceGroupsEdge(
@@ -943,93 +1014,10 @@ void CSG::classifyFaceGroupsEdge(
 		}
 	}
 
-	for (FLGroupList::iterator i = a_loops_grouped.begin();
-			 i != a_loops_grouped.end(); ++i)
-	{
-		if ((*i).classification.empty())
-		{
-#if defined(CARVE_DEBUG)
-			std::cerr << " non intersecting group (poly a): " << &(*i) << std::endl;
-#endif
-			bool classified = false;
-			for (FaceLoop* fl = (*i).face_loops.head; !classified && fl != nullptr;
-					 fl = fl->next)
-			{
-				for (size_t fli = 0; !classified && fli < fl->vertices.size(); ++fli)
-				{
-					if (vclass[fl->vertices[fli]].cls[1] == POINT_UNK)
-					{
-						vclass[fl->vertices[fli]].cls[1] = carve::mesh::classifyPoint(
-								poly_b, poly_b_rtree, fl->vertices[fli]->v);
-					}
-					switch (vclass[fl->vertices[fli]].cls[1])
-					{
-					case POINT_IN:
-						(*i).classification.push_back(
-								ClassificationInfo(nullptr, FACE_IN));
-						classified = true;
-						break;
-					case POINT_OUT:
-						(*i).classification.push_back(
-								ClassificationInfo(nullptr, FACE_OUT));
-						classified = true;
-						break;
-					default:
-						break;
-					}
-				}
-			}
-			if (!classified)
-			{
-				throw carve::exception(
-						"non intersecting group is not IN or OUT! (poly_a)");
-			}
-		}
-	}
-
-	for (FLGroupList::iterator i = b_loops_grouped.begin();
-			 i != b_loops_grouped.end(); ++i)
-	{
-		if ((*i).classification.empty())
-		{
-#if defined(CARVE_DEBUG)
-			std::cerr << " non intersecting group (poly b): " << &(*i) << std::endl;
-#endif
-			bool classified = false;
-			for (FaceLoop* fl = (*i).face_loops.head; !classified && fl != nullptr;
-					 fl = fl->next)
-			{
-				for (size_t fli = 0; !classified && fli < fl->vertices.size(); ++fli)
-				{
-					if (vclass[fl->vertices[fli]].cls[0] == POINT_UNK)
-					{
-						vclass[fl->vertices[fli]].cls[0] = carve::mesh::classifyPoint(
-								poly_a, poly_a_rtree, fl->vertices[fli]->v);
-					}
-					switch (vclass[fl->vertices[fli]].cls[0])
-					{
-					case POINT_IN:
-						(*i).classification.push_back(
-								ClassificationInfo(nullptr, FACE_IN));
-						classified = true;
-						break;
-					case POINT_OUT:
-						(*i).classification.push_back(
-								ClassificationInfo(nullptr, FACE_OUT));
-						classified = true;
-						break;
-					default:
-						break;
-					}
-				}
-			}
-			if (!classified)
-			{
-				throw carve::exception(
-						"non intersecting group is not IN or OUT! (poly_b)");
-			}
-		}
-	}
+	classifyNonIntersectingGroups(a_loops_grouped, vclass, 1, poly_b,
+			poly_b_rtree, "non intersecting group is not IN or OUT! (poly_a)");
+	classifyNonIntersectingGroups(b_loops_grouped, vclass, 0, poly_a,
+			poly_a_rtree, "non intersecting group is not IN or OUT! (poly_b)");
 
 #if defined(DISPLAY_GRP_GRAPH)
 #	define POLY(grp)                                                      \
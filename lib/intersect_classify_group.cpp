@@ -31,6 +31,7 @@
 
 #include <algorithm>
 
+#include "csg_detail.hpp"
 #include "intersect_classify_common.hpp"
 #include "intersect_classify_common_impl.hpp"
 #include "intersect_common.hpp"
@@ -51,9 +52,11 @@ public:
 	CSG::Hooks& hooks;
 
 	FaceMaker0(CSG::Collector& c, CSG::Hooks& h) : collector(c), hooks(h) {}
-	bool pointOn(VertexClassification& vclass, FaceLoop* f, size_t index) const
+	bool pointOn(const VertexClassification& vclass, FaceLoop* f,
+			size_t index) const
 	{
-		return vclass[f->vertices[index]].cls[1] == POINT_ON;
+		VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+		return i != vclass.end() && (*i).second.cls[1] == POINT_ON;
 	}
 	void explain(FaceLoop* f, size_t index, PointClass pc) const
 	{
@@ -71,9 +74,11 @@ public:
 	CSG::Hooks& hooks;
 
 	FaceMaker1(CSG::Collector& c, CSG::Hooks& h) : collector(c), hooks(h) {}
-	bool pointOn(VertexClassification& vclass, FaceLoop* f, size_t index) const
+	bool pointOn(const VertexClassification& vclass, FaceLoop* f,
+			size_t index) const
 	{
-		return vclass[f->vertices[index]].cls[0] == POINT_ON;
+		VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+		return i != vclass.end() && (*i).second.cls[0] == POINT_ON;
 	}
 	void explain(FaceLoop* f, size_t index, PointClass pc) const
 	{
@@ -96,9 +101,11 @@ public:
 
 	FaceMaker(CSG::Collector& c, CSG::Hooks& h) : collector(c), hooks(h) {}
 
-	bool pointOn(VertexClassification& vclass, FaceLoop* f, size_t index) const
+	bool pointOn(const VertexClassification& vclass, FaceLoop* f,
+			size_t index) const
 	{
-		return vclass[f->vertices[index]].cls[1 - poly_num] == POINT_ON;
+		VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+		return i != vclass.end() && (*i).second.cls[1 - poly_num] == POINT_ON;
 	}
 
 	void explain(FaceLoop* f, size_t index, PointClass pc) const
@@ -113,6 +120,87 @@ public:
 using FaceMaker0 = FaceMaker<0>;
 using FaceMaker1 = FaceMaker<1>;
 #endif
+// Whether the other operand crosses the edge (v1, v2), which the loop
+// a1 traverses forwards and a2 backwards, from one side of the surface
+// of a1 and a2 to the other. That is the case when the faces of b1
+// (forwards) and b2 (backwards) separate those of a1 and a2 around the
+// edge.
+bool crossesTransversally(const FaceLoop* a1, const FaceLoop* a2,
+		const FaceLoop* b1, const FaceLoop* b2,
+		const carve::mesh::MeshSet<3>::vertex_t* v1,
+		const carve::mesh::MeshSet<3>::vertex_t* v2)
+{
+	const carve::geom3d::Vector d = (v2->v - v1->v).normalized();
+	const carve::geom3d::Vector u = carve::geom::cross(a1->orig_face->plane.N, d);
+	const carve::geom3d::Vector w = carve::geom::cross(d, u);
+
+	// the angle about the edge of the face of a loop, measured from a1.
+	auto angle = [&](const FaceLoop* loop, const carve::geom3d::Vector& dir) {
+		const carve::geom3d::Vector i = carve::geom::cross(loop->orig_face->plane.N, dir);
+		const double t = atan2(carve::geom::dot(i, w), carve::geom::dot(i, u));
+		return t < 0.0 ? t + 2.0 * M_PI : t;
+	};
+	const double ta = angle(a2, -d);
+	const double tb1 = angle(b1, d);
+	const double tb2 = angle(b2, -d);
+
+	auto distinct = [](double t1, double t2) {
+		const double t = fabs(t1 - t2);
+		return t > carve::EPSILON && t < 2.0 * M_PI - carve::EPSILON;
+	};
+	if (!distinct(ta, 0.0) || !distinct(tb1, 0.0) || !distinct(tb2, 0.0) ||
+			!distinct(tb1, ta) || !distinct(tb2, ta))
+	{
+		return false;
+	}
+	return (tb1 < ta) != (tb2 < ta);
+}
+
+// Link the groups of \a groups that meet across a perimeter edge at
+// which a closed mesh of the other operand crosses them. Edges where
+// either operand is non-manifold, or where faces meet tangentially, are
+// not linked.
+void findGroupFlips(const FLGroupList& groups,
+		const detail::LoopEdges& edge_map,
+		const detail::LoopEdges& other_edge_map, GroupFlips& flips)
+{
+	auto single = [](const detail::LoopEdges& map, const V2& e) -> const FaceLoop* {
+		detail::LoopEdges::const_iterator i = map.find(e);
+		if (i == map.end() || (*i).second.size() != 1)
+		{
+			return nullptr;
+		}
+		return (*i).second.front();
+	};
+
+	for (const FaceLoopGroup& grp : groups)
+	{
+		std::vector<const FaceLoopGroup*>& adj = flips[&grp];
+		for (const V2& e : grp.perimeter)
+		{
+			const V2 r(e.second, e.first);
+			const FaceLoop* a1 = single(edge_map, e);
+			const FaceLoop* a2 = single(edge_map, r);
+			const FaceLoop* b1 = single(other_edge_map, e);
+			const FaceLoop* b2 = single(other_edge_map, r);
+			if (a1 == nullptr || a2 == nullptr || b1 == nullptr || b2 == nullptr ||
+					a1->group != &grp ||
+					a1->orig_face->mesh != a2->orig_face->mesh ||
+					b1->orig_face->mesh != b2->orig_face->mesh ||
+					!b1->orig_face->mesh->isClosed())
+			{
+				continue;
+			}
+			if (crossesTransversally(a1, a2, b1, b2, e.first, e.second))
+			{
+				adj.push_back(a2->group);
+			}
+		}
+		std::sort(adj.begin(), adj.end());
+		adj.erase(std::unique(adj.begin(), adj.end()), adj.end());
+	}
+}
+
 class ClassifyFaceGroups
 {
 	ClassifyFaceGroups& operator=(const ClassifyFaceGroups&) = delete;
@@ -120,9 +208,14 @@ class ClassifyFaceGroups
 public:
 	CSG::Collector& collector;
 	CSG::Hooks& hooks;
+	const GroupFlips* a_flips;
+	const GroupFlips* b_flips;
+	size_t* n_classified;
 
-	ClassifyFaceGroups(CSG::Collector& c, CSG::Hooks& h)
-			: collector(c), hooks(h) {}
+	ClassifyFaceGroups(CSG::Collector& c, CSG::Hooks& h,
+			const GroupFlips* a_f = nullptr, const GroupFlips* b_f = nullptr,
+			size_t* n = nullptr)
+			: collector(c), hooks(h), a_flips(a_f), b_flips(b_f), n_classified(n) {}
 
 	void classifySimple(FLGroupList& a_loops_grouped,
 			FLGroupList& b_loops_grouped,
@@ -158,10 +251,10 @@ public:
 	{
 		performClassifyEasyFaceGroups(a_loops_grouped, poly_b, poly_b_rtree, vclass,
 				FaceMaker0(collector, hooks), collector,
-				hooks);
+				hooks, a_flips, n_classified);
 		performClassifyEasyFaceGroups(b_loops_grouped, poly_a, poly_a_rtree, vclass,
 				FaceMaker1(collector, hooks), collector,
-				hooks);
+				hooks, b_flips, n_classified);
 #if defined(CARVE_DEBUG)
 		std::cerr << "after removal of easy groups: " << a_loops_grouped.size()
 							<< " a groups" << std::endl;
@@ -180,10 +273,10 @@ public:
 	{
 		performClassifyHardFaceGroups(a_loops_grouped, poly_b, poly_b_rtree,
 				FaceMaker0(collector, hooks), collector,
-				hooks);
+				hooks, a_flips, n_classified);
 		performClassifyHardFaceGroups(b_loops_grouped, poly_a, poly_a_rtree,
 				FaceMaker1(collector, hooks), collector,
-				hooks);
+				hooks, b_flips, n_classified);
 #if defined(CARVE_DEBUG)
 		std::cerr << "after removal of hard groups: " << a_loops_grouped.size()
 							<< " a groups" << std::endl;
@@ -201,9 +294,9 @@ public:
 			const
 	{
 		performFaceLoopWork(poly_b, poly_b_rtree, a_loops_grouped, *this, collector,
-				hooks);
+				hooks, a_flips, n_classified);
 		performFaceLoopWork(poly_a, poly_a_rtree, b_loops_grouped, *this, collector,
-				hooks);
+				hooks, b_flips, n_classified);
 	}
 
 	void postRemovalCheck(FLGroupList& a_loops_grouped,
@@ -238,13 +331,21 @@ void CSG::classifyFaceGroups(
 		const V2Set& /* shared_edges */, VertexClassification& vclass,
 		carve::mesh::MeshSet<3>* poly_a,
 		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* poly_a_rtree,
-		FLGroupList& a_loops_grouped, const detail::LoopEdges& /* a_edge_map */,
+		FLGroupList& a_loops_grouped, const detail::LoopEdges& a_edge_map,
 		carve::mesh::MeshSet<3>* poly_b,
 		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* poly_b_rtree,
-		FLGroupList& b_loops_grouped, const detail::LoopEdges& /* b_edge_map */,
-		CSG::Collector& collector)
+		FLGroupList& b_loops_grouped, const detail::LoopEdges& b_edge_map,
+		CSG::Collector& collector, bool propagate)
 {
-	ClassifyFaceGroups classifier(collector, hooks);
+	GroupFlips a_flips, b_flips;
+	if (propagate)
+	{
+		findGroupFlips(a_loops_grouped, a_edge_map, b_edge_map, a_flips);
+		findGroupFlips(b_loops_grouped, b_edge_map, a_edge_map, b_flips);
+	}
+	ClassifyFaceGroups classifier(collector, hooks,
+			propagate ? &a_flips : nullptr,
+			propagate ? &b_flips : nullptr, &n_group_classifications);
 #if defined(CARVE_DEBUG)
 	std::cerr << "initial groups: " << a_loops_grouped.size() << " a groups"
 						<< std::endl;
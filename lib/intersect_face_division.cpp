@@ -23,6 +23,7 @@
 // SOFTWARE.
 #include <carve/csg.hpp>
 #include <carve/debug_hooks.hpp>
+#include <carve/parallel.hpp>
 #include <carve/polyline.hpp>
 #include <carve/timing.hpp>
 #include <carve/triangulator.hpp>
@@ -1964,144 +1965,325 @@ void generateOneFaceLoop(
 		mergeFacesAndHoles(face, face_loops, hole_loops, hooks);
 	}
 }
-} // namespace
 
-/**
- * \brief Build a set of face loops for all (split) faces of a Polyhedron.
- *
- * @param[in] poly The polyhedron to process
- * @param[in] data Internal intersection data
- * @param[out] face_loops_out The resulting face loops
- *
- * @return The number of edges generated.
- */
-size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3>* poly,
-		const detail::Data& data,
-		FaceLoopList& face_loops_out)
+// Divide a single face, and append the resulting face loops to
+// face_loops_out. Returns the number of edges generated.
+size_t divideFace(carve::mesh::MeshSet<3>::face_t* face,
+		const carve::csg::detail::Data& data,
+		const carve::csg::VertexIntersections& vertex_intersections,
+		carve::csg::CSG::Hooks& hooks,
+		std::vector<carve::csg::FaceLoop*>& face_loops_out)
 {
-	static carve::TimingName FUNC_NAME("CSG::generateFaceLoops()");
-	carve::TimingBlock block(FUNC_NAME);
+	using namespace carve::csg;
+
 	size_t generated_edges = 0;
 	std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t*>> face_loops;
 
-	for (carve::mesh::MeshSet<3>::face_iter i = poly->faceBegin();
-			 i != poly->faceEnd(); ++i)
-	{
-		carve::mesh::MeshSet<3>::face_t* face = (*i);
-
 #if defined(CARVE_DEBUG)
-		double in_area = 0.0, out_area = 0.0;
+	double in_area = 0.0, out_area = 0.0;
 
-		{
-			carve::csg::CSG::Hooks no_hooks; // BL
-			std::vector<carve::mesh::MeshSet<3>::vertex_t*> base_loop;
-			assembleBaseLoop(face, data, base_loop, no_hooks);
+	{
+		carve::csg::CSG::Hooks no_hooks; // BL
+		std::vector<carve::mesh::MeshSet<3>::vertex_t*> base_loop;
+		assembleBaseLoop(face, data, base_loop, no_hooks);
 
+		{
+			std::vector<carve::geom2d::P2> projected;
+			projected.reserve(base_loop.size());
+			for (size_t n = 0; n < base_loop.size(); ++n)
 			{
-				std::vector<carve::geom2d::P2> projected;
-				projected.reserve(base_loop.size());
-				for (size_t n = 0; n < base_loop.size(); ++n)
-				{
-					projected.push_back(face->project(base_loop[n]->v));
-				}
-
-				in_area = carve::geom2d::signedArea(projected);
-				std::cerr << "### in_area=" << in_area << std::endl;
+				projected.push_back(face->project(base_loop[n]->v));
 			}
+
+			in_area = carve::geom2d::signedArea(projected);
+			std::cerr << "### in_area=" << in_area << std::endl;
 		}
+	}
 #endif
 
-		generateOneFaceLoop(face, data, vertex_intersections, hooks, face_loops);
+	generateOneFaceLoop(face, data, vertex_intersections, hooks, face_loops);
 
 #if defined(CARVE_DEBUG)
-		{
-			V2Set face_edges;
+	{
+		V2Set face_edges;
 
-			carve::csg::CSG::Hooks no_hooks; // BL
-			std::vector<carve::mesh::MeshSet<3>::vertex_t*> base_loop;
-			assembleBaseLoop(face, data, base_loop, no_hooks);
+		carve::csg::CSG::Hooks no_hooks; // BL
+		std::vector<carve::mesh::MeshSet<3>::vertex_t*> base_loop;
+		assembleBaseLoop(face, data, base_loop, no_hooks);
 
-			for (size_t j = 0, je = base_loop.size() - 1; j < je; ++j)
-			{
-				face_edges.insert(std::make_pair(base_loop[j + 1], base_loop[j]));
-			}
-			face_edges.insert(std::make_pair(base_loop[0], base_loop.back()));
-			for (std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t*>>::
-							 const_iterator fli = face_loops.begin();
-					 fli != face_loops.end(); ++fli)
+		for (size_t j = 0, je = base_loop.size() - 1; j < je; ++j)
+		{
+			face_edges.insert(std::make_pair(base_loop[j + 1], base_loop[j]));
+		}
+		face_edges.insert(std::make_pair(base_loop[0], base_loop.back()));
+		for (std::list<std::vector<carve::mesh::MeshSet<3>::vertex_t*>>::
+						 const_iterator fli = face_loops.begin();
+				 fli != face_loops.end(); ++fli)
+		{
 			{
+				std::vector<carve::geom2d::P2> projected;
+				projected.reserve((*fli).size());
+				for (size_t n = 0; n < (*fli).size(); ++n)
 				{
-					std::vector<carve::geom2d::P2> projected;
-					projected.reserve((*fli).size());
-					for (size_t n = 0; n < (*fli).size(); ++n)
-					{
-						projected.push_back(face->project((*fli)[n]->v));
-					}
-
-					double area = carve::geom2d::signedArea(projected);
-					std::cerr
-							<< "### loop_area["
-							<< std::distance(
-										 (std::list<std::vector<
-														 carve::mesh::MeshSet<3>::vertex_t*>>::const_iterator)
-												 face_loops.begin(),
-										 fli)
-							<< "]=" << area << std::endl;
-					out_area += area;
+					projected.push_back(face->project((*fli)[n]->v));
 				}
 
-				const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& fl = *fli;
-				for (size_t j = 0, je = fl.size() - 1; j < je; ++j)
-				{
-					face_edges.insert(std::make_pair(fl[j], fl[j + 1]));
-				}
-				face_edges.insert(std::make_pair(fl.back(), fl[0]));
+				double area = carve::geom2d::signedArea(projected);
+				std::cerr
+						<< "### loop_area["
+						<< std::distance(
+									 (std::list<std::vector<
+													 carve::mesh::MeshSet<3>::vertex_t*>>::const_iterator)
+											 face_loops.begin(),
+									 fli)
+						<< "]=" << area << std::endl;
+				out_area += area;
 			}
-			for (V2Set::const_iterator j = face_edges.begin(); j != face_edges.end();
-					 ++j)
+
+			const std::vector<carve::mesh::MeshSet<3>::vertex_t*>& fl = *fli;
+			for (size_t j = 0, je = fl.size() - 1; j < je; ++j)
 			{
-				if (face_edges.find(std::make_pair((*j).second, (*j).first)) ==
-						face_edges.end())
-				{
-					std::cerr << "### error: unmatched edge [" << (*j).first << "-"
-										<< (*j).second << "]" << std::endl;
-				}
+				face_edges.insert(std::make_pair(fl[j], fl[j + 1]));
 			}
-			std::cerr << "### out_area=" << out_area << std::endl;
-			if (out_area != in_area)
+			face_edges.insert(std::make_pair(fl.back(), fl[0]));
+		}
+		for (V2Set::const_iterator j = face_edges.begin(); j != face_edges.end();
+				 ++j)
+		{
+			if (face_edges.find(std::make_pair((*j).second, (*j).first)) ==
+					face_edges.end())
 			{
-				std::cerr << "### error: area does not match. delta = "
-									<< (out_area - in_area) << std::endl;
-				// CARVE_ASSERT(fabs(out_area - in_area) < 1e-5);
+				std::cerr << "### error: unmatched edge [" << (*j).first << "-"
+									<< (*j).second << "]" << std::endl;
 			}
 		}
+		std::cerr << "### out_area=" << out_area << std::endl;
+		if (out_area != in_area)
+		{
+			std::cerr << "### error: area does not match. delta = "
+								<< (out_area - in_area) << std::endl;
+			// CARVE_ASSERT(fabs(out_area - in_area) < 1e-5);
+		}
+	}
 #endif
 
 // now record all the resulting face loops.
 #if defined(CARVE_DEBUG)
-		std::cerr << "### ======" << std::endl;
+	std::cerr << "### ======" << std::endl;
 #endif
-		for (std::list<
-						 std::vector<carve::mesh::MeshSet<3>::vertex_t*>>::const_iterator
-						 f = face_loops.begin(),
-						 fe = face_loops.end();
-				 f != fe; ++f)
+	for (std::list<
+					 std::vector<carve::mesh::MeshSet<3>::vertex_t*>>::const_iterator
+					 f = face_loops.begin(),
+					 fe = face_loops.end();
+			 f != fe; ++f)
+	{
+#if defined(CARVE_DEBUG)
+		std::cerr << "### loop:";
+		for (size_t k = 0; k < (*f).size(); ++k)
 		{
+			std::cerr << " " << (*f)[k];
+		}
+		std::cerr << std::endl;
+#endif
+
+		face_loops_out.push_back(new carve::csg::FaceLoop(face, *f));
+		generated_edges += (*f).size();
+	}
 #if defined(CARVE_DEBUG)
-			std::cerr << "### loop:";
-			for (size_t k = 0; k < (*f).size(); ++k)
-			{
-				std::cerr << " " << (*f)[k];
-			}
-			std::cerr << std::endl;
+	std::cerr << "### ======" << std::endl;
 #endif
+	return generated_edges;
+}
+
+// Find the faces that are touched by the intersection: faces that
+// have been split, or that have a divided edge. The result is a
+// bitset over Face::id, and is only usable if the face ids are
+// distinct and less than N, the face count of the polyhedron, which
+// is the case for meshes built by FaceStitcher. Otherwise false is
+// returned.
+bool findTouchedFaces(
+		const std::vector<carve::mesh::MeshSet<3>::face_t*>& faces, size_t N,
+		const carve::csg::detail::Data& data, std::vector<bool>& touched)
+{
+	std::vector<const carve::mesh::MeshSet<3>::face_t*> by_id(N, nullptr);
+	for (size_t i = 0; i < faces.size(); ++i)
+	{
+		const size_t id = faces[i]->id;
+		if (id >= N || by_id[id] != nullptr)
+		{
+			return false;
+		}
+		by_id[id] = faces[i];
+	}
+
+	touched.assign(N, false);
+	for (carve::csg::detail::FV2SMap::const_iterator i = data.face_split_edges.begin();
+			 i != data.face_split_edges.end(); ++i)
+	{
+		const carve::mesh::MeshSet<3>::face_t* f = (*i).first;
+		if (f->id < N && by_id[f->id] == f)
+		{
+			touched[f->id] = true;
+		}
+	}
+	for (carve::csg::detail::EVVMap::const_iterator i = data.divided_edges.begin();
+			 i != data.divided_edges.end(); ++i)
+	{
+		const carve::mesh::MeshSet<3>::face_t* f = (*i).first->face;
+		if (f->id < N && by_id[f->id] == f)
+		{
+			touched[f->id] = true;
+		}
+	}
+	return true;
+}
+
+// The face loop of a face that is not touched by the intersection is
+// the face's own vertex loop (with vertices mapped through vmap).
+carve::csg::FaceLoop* untouchedFaceLoop(carve::mesh::MeshSet<3>::face_t* face,
+		const carve::csg::detail::Data& data)
+{
+	carve::csg::FaceLoop* loop = new carve::csg::FaceLoop(
+			face, std::vector<carve::mesh::MeshSet<3>::vertex_t*>());
+	loop->vertices.reserve(face->n_edges);
+	carve::mesh::MeshSet<3>::edge_t* e = face->edge;
+	do
+	{
+		loop->vertices.push_back(carve::csg::map_vertex(data.vmap, e->vert));
+		e = e->next;
+	} while (e != face->edge);
+	return loop;
+}
+
+// Records edge division hook calls made by a worker thread, so that
+// they can be replayed in face order once all faces are divided.
+struct EdgeDivisionRecorder : public carve::csg::CSG::Hook
+{
+	struct record
+	{
+		const carve::mesh::MeshSet<3>::edge_t* orig_edge;
+		size_t orig_edge_idx;
+		const carve::mesh::MeshSet<3>::vertex_t* v1;
+		const carve::mesh::MeshSet<3>::vertex_t* v2;
+	};
+
+	std::vector<record>& records;
 
-			face_loops_out.append(new FaceLoop(face, *f));
-			generated_edges += (*f).size();
+	explicit EdgeDivisionRecorder(std::vector<record>& _records)
+			: records(_records) {}
+
+	void edgeDivision(const carve::mesh::MeshSet<3>::edge_t* orig_edge,
+			size_t orig_edge_idx, const carve::mesh::MeshSet<3>::vertex_t* v1,
+			const carve::mesh::MeshSet<3>::vertex_t* v2) override
+	{
+		record r = {orig_edge, orig_edge_idx, v1, v2};
+		records.push_back(r);
+	}
+};
+} // namespace
+
+/**
+ * \brief Build a set of face loops for all (split) faces of a Polyhedron.
+ *
+ * Faces are divided concurrently, in chunks. Each chunk collects its
+ * face loops (and any edge division hook calls) locally, and the
+ * results are then appended in face order, so the output does not
+ * depend on the number of threads.
+ *
+ * @param[in] poly The polyhedron to process
+ * @param[in] data Internal intersection data
+ * @param[out] face_loops_out The resulting face loops
+ *
+ * @return The number of edges generated.
+ */
+size_t carve::csg::CSG::generateFaceLoops(carve::mesh::MeshSet<3>* poly,
+		const detail::Data& data,
+		FaceLoopList& face_loops_out,
+		const std::vector<bool>* skip_shells)
+{
+	static carve::TimingName FUNC_NAME("CSG::generateFaceLoops()");
+	carve::TimingBlock block(FUNC_NAME);
+
+	std::vector<carve::mesh::MeshSet<3>::face_t*> faces;
+	size_t n_faces = 0;
+	for (size_t m = 0; m < poly->meshes.size(); ++m)
+	{
+		const std::vector<carve::mesh::MeshSet<3>::face_t*>& mesh_faces =
+				poly->meshes[m]->faces;
+		n_faces += mesh_faces.size();
+		if (skip_shells == nullptr || !(*skip_shells)[m])
+		{
+			faces.insert(faces.end(), mesh_faces.begin(), mesh_faces.end());
 		}
+	}
+
+	// faces that the intersection does not touch skip face division,
+	// and have their loops copied straight from the face.
+	std::vector<bool> touched;
+	const bool fast_path = findTouchedFaces(faces, n_faces, data, touched);
+
 #if defined(CARVE_DEBUG)
-		std::cerr << "### ======" << std::endl;
+	// keep the debugging output of each face together.
+	const size_t grain = std::max<size_t>(faces.size(), 1);
+#else
+	const size_t grain = 256;
 #endif
+	const size_t n_chunks = carve::parallel::chunkCount(faces.size(), grain);
+	const bool record_hooks = n_chunks > 1 && hooks.hasHook(Hooks::EDGE_DIVISION_HOOK);
+
+	std::vector<std::vector<FaceLoop*>> chunk_loops(n_chunks);
+	std::vector<std::vector<EdgeDivisionRecorder::record>> chunk_divisions(n_chunks);
+	std::vector<size_t> chunk_edges(n_chunks, 0);
+
+	try
+	{
+		carve::parallel::for_chunks(0, faces.size(), grain, [&](size_t lo, size_t hi, size_t c) {
+			Hooks chunk_hooks;
+			if (record_hooks)
+			{
+				chunk_hooks.registerHook(new EdgeDivisionRecorder(chunk_divisions[c]),
+						Hooks::EDGE_DIVISION_BIT);
+			}
+			Hooks& h = n_chunks > 1 ? chunk_hooks : hooks;
+			for (size_t i = lo; i < hi; ++i)
+			{
+				if (fast_path && !touched[faces[i]->id])
+				{
+					chunk_loops[c].push_back(untouchedFaceLoop(faces[i], data));
+					chunk_edges[c] += faces[i]->n_edges;
+				}
+				else
+				{
+					chunk_edges[c] += divideFace(faces[i], data, vertex_intersections, h, chunk_loops[c]);
+				}
+			}
+		});
+	}
+	catch (...)
+	{
+		for (size_t c = 0; c < n_chunks; ++c)
+		{
+			for (size_t i = 0; i < chunk_loops[c].size(); ++i)
+			{
+				delete chunk_loops[c][i];
+			}
+		}
+		throw;
+	}
+
+	size_t generated_edges = 0;
+	for (size_t c = 0; c < n_chunks; ++c)
+	{
+		for (size_t i = 0; i < chunk_divisions[c].size(); ++i)
+		{
+			const EdgeDivisionRecorder::record& r = chunk_divisions[c][i];
+			hooks.edgeDivision(r.orig_edge, r.orig_edge_idx, r.v1, r.v2);
+		}
+		for (size_t i = 0; i < chunk_loops[c].size(); ++i)
+		{
+			face_loops_out.append(chunk_loops[c][i]);
+		}
+		generated_edges += chunk_edges[c];
 	}
 	return generated_edges;
 }
@@ -87,9 +87,11 @@ struct GroupPoly : public CSG::Collector
 class FaceMaker
 {
 public:
-	bool pointOn(VertexClassification& vclass, FaceLoop* f, size_t index) const
+	bool pointOn(const VertexClassification& vclass, FaceLoop* f,
+			size_t index) const
 	{
-		return vclass[f->vertices[index]].cls[0] == POINT_ON;
+		VertexClassification::const_iterator i = vclass.find(f->vertices[index]);
+		return i != vclass.end() && (*i).second.cls[0] == POINT_ON;
 	}
 
 	void explain(FaceLoop* f, size_t index, PointClass pc) const
@@ -23,10 +23,12 @@
 // SOFTWARE.
 #include <carve/mesh.hpp>
 #include <carve/mesh_impl.hpp>
+#include <carve/parallel.hpp>
 #include <carve/poly.hpp>
 #include <carve/rtree.hpp>
 
 #include <functional>
+#include <random>
 
 namespace {
 inline double CALC_X(const carve::geom::plane<3>& p, double y, double z)
@@ -317,34 +319,64 @@ bool FaceStitcher::EdgeOrderData::Cmp::operator()(
 void FaceStitcher::matchSimpleEdges()
 {
 	// join faces that share an edge, where no other faces are incident.
+	// edges are classified in parallel; each simple edge pair is only
+	// linked by the thread that sees its lower edge pointer, and the
+	// face groups tolerate concurrent merges. open faces and complex
+	// edges are collected per chunk, and applied in iteration order.
+	std::vector<edge_map_t::iterator> all_edges;
+	all_edges.reserve(edges.size());
 	for (edge_map_t::iterator i = edges.begin(); i != edges.end(); ++i)
 	{
-		const vpair_t& ev = (*i).first;
-		edge_map_t::iterator j = edges.find(vpair_t(ev.second, ev.first));
-		if (j == edges.end())
+		all_edges.push_back(i);
+	}
+
+	const size_t n_chunks = carve::parallel::chunkCount(all_edges.size(), 4096);
+	std::vector<std::vector<size_t>> open_faces(n_chunks);
+	std::vector<std::vector<edge_map_t::iterator>> complex(n_chunks);
+
+	carve::parallel::for_chunks(0, all_edges.size(), 4096, [&](size_t lo, size_t hi, size_t c) {
+		for (size_t n = lo; n < hi; ++n)
 		{
-			for (edgelist_t::iterator k = (*i).second.begin(); k != (*i).second.end();
-					 ++k)
+			edge_map_t::iterator i = all_edges[n];
+			const vpair_t& ev = (*i).first;
+			edge_map_t::iterator j = edges.find(vpair_t(ev.second, ev.first));
+			if (j == edges.end())
+			{
+				for (edgelist_t::iterator k = (*i).second.begin(); k != (*i).second.end();
+						 ++k)
+				{
+					open_faces[c].push_back((*k)->face->id);
+				}
+			}
+			else if ((*i).second.size() != 1 || (*j).second.size() != 1)
 			{
-				is_open[(*k)->face->id] = true;
+				complex[c].push_back(i);
+			}
+			else
+			{
+				// simple edge.
+				edge_t* a = (*i).second.front();
+				edge_t* b = (*j).second.front();
+				if (a < b)
+				{
+					// every simple edge pair is encountered twice. only merge once.
+					a->rev = b;
+					b->rev = a;
+					face_groups.merge_sets(a->face->id, b->face->id);
+				}
 			}
 		}
-		else if ((*i).second.size() != 1 || (*j).second.size() != 1)
+	});
+
+	for (size_t c = 0; c < n_chunks; ++c)
+	{
+		for (size_t k = 0; k < open_faces[c].size(); ++k)
 		{
-			std::swap(complex_edges[(*i).first], (*i).second);
+			is_open[open_faces[c][k]] = true;
 		}
-		else
+		for (size_t k = 0; k < complex[c].size(); ++k)
 		{
-			// simple edge.
-			edge_t* a = (*i).second.front();
-			edge_t* b = (*j).second.front();
-			if (a < b)
-			{
-				// every simple edge pair is encountered twice. only merge once.
-				a->rev = b;
-				b->rev = a;
-				face_groups.merge_sets(a->face->id, b->face->id);
-			}
+			std::swap(complex_edges[(*complex[c][k]).first], (*complex[c][k]).second);
 		}
 	}
 }
@@ -1231,6 +1263,20 @@ template class carve::mesh::Face<3>;
 template class carve::mesh::Mesh<3>;
 template class carve::mesh::MeshSet<3>;
 
+namespace {
+// A random angle for a ray direction. rand() need not be thread safe,
+// so the chunks of parallel algorithms each use a generator of their own.
+double randomAngle()
+{
+	if (carve::parallel::inRegion())
+	{
+		static thread_local std::minstd_rand engine;
+		return (engine() - engine.min()) / double(engine.max() - engine.min()) * M_TWOPI;
+	}
+	return rand() / double(RAND_MAX) * M_TWOPI;
+}
+} // namespace
+
 carve::PointClass carve::mesh::classifyPoint(
 		const carve::mesh::MeshSet<3>* meshset,
 		const carve::geom::RTreeNode<3, carve::mesh::Face<3>*>* face_rtree,
@@ -1297,8 +1343,8 @@ carve::PointClass carve::mesh::classifyPoint(
 
 	for (;;)
 	{
-		double a1 = rand() / double(RAND_MAX) * M_TWOPI;
-		double a2 = rand() / double(RAND_MAX) * M_TWOPI;
+		double a1 = randomAngle();
+		double a2 = randomAngle();
 
 		carve::geom3d::Vector ray_dir =
 				carve::geom::VECTOR(sin(a1) * sin(a2), cos(a1) * sin(a2), cos(a2));
@@ -0,0 +1,81 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <carve/parallel.hpp>
+
+namespace carve {
+namespace parallel {
+static unsigned thread_count = 0;
+
+#if defined(CARVE_WITH_THREADS)
+static thread_local unsigned region_depth = 0;
+
+detail::region_guard::region_guard()
+{
+	++region_depth;
+}
+
+detail::region_guard::~region_guard()
+{
+	--region_depth;
+}
+#else
+detail::region_guard::region_guard() = default;
+
+detail::region_guard::~region_guard() = default;
+#endif
+
+void setThreadCount(unsigned n)
+{
+	thread_count = n;
+}
+
+unsigned threadCount()
+{
+#if defined(CARVE_WITH_THREADS)
+	if (region_depth != 0)
+	{
+		return 1;
+	}
+	if (thread_count == 0)
+	{
+		return std::max(1U, std::thread::hardware_concurrency());
+	}
+	return thread_count;
+#else
+	return 1;
+#endif
+}
+
+bool inRegion()
+{
+#if defined(CARVE_WITH_THREADS)
+	return region_depth != 0;
+#else
+	return false;
+#endif
+}
+}
+} // namespace carve::parallel
@@ -1304,6 +1304,12 @@ void carve::triangulate::triangulate(
 		return;
 	}
 
+	// ear clipping is quadratic; try a plane sweep for large polygons.
+	if (N >= MONOTONE_TRIANGULATION_THRESHOLD && triangulateMonotone(poly, result))
+	{
+		return;
+	}
+
 	vinfo.resize(N);
 
 	vinfo[0] = new detail::vertex_info(poly[0], 0);
@@ -1389,3 +1395,132 @@ void carve::triangulate::detail::tri_pairs_t::insert(
 		tp->b = t;
 	}
 }
+
+size_t carve::triangulate::improveDelaunay(
+		const std::vector<carve::geom2d::P2>& poly,
+		std::vector<carve::triangulate::tri_idx>& result)
+{
+	const size_t npos = ~size_t(0);
+	const size_t T = result.size();
+	if (T < 2)
+	{
+		return 0;
+	}
+
+	// half-edge 3t+i runs from result[t].v[i] to result[t].v[(i+1)%3].
+	auto vert = [&](size_t h) { return result[h / 3].v[h % 3]; };
+	auto nextHalf = [](size_t h) { return h - h % 3 + (h + 1) % 3; };
+
+	double area = 0.0;
+	for (size_t t = 0; t < T; ++t)
+	{
+		area += carve::geom2d::orient2d(
+				poly[result[t].a], poly[result[t].b], poly[result[t].c]);
+	}
+	const double sign = area < 0.0 ? -1.0 : +1.0;
+	auto orient = [&](unsigned a, unsigned b, unsigned c) {
+		return sign * carve::geom2d::orient2d(poly[a], poly[b], poly[c]);
+	};
+
+	// pair up half-edges; an edge used by other than two triangles,
+	// or by two with the same direction, is left alone.
+	std::vector<size_t> opp(3 * T, npos);
+	{
+		std::vector<std::pair<std::pair<unsigned, unsigned>, size_t>> keys;
+		keys.reserve(3 * T);
+		for (size_t h = 0; h < 3 * T; ++h)
+		{
+			const unsigned a = vert(h), b = vert(nextHalf(h));
+			keys.push_back(std::make_pair(std::make_pair(std::min(a, b), std::max(a, b)), h));
+		}
+		std::sort(keys.begin(), keys.end());
+		for (size_t i = 0; i + 1 < keys.size();)
+		{
+			size_t j = i + 1;
+			while (j < keys.size() && keys[j].first == keys[i].first)
+			{
+				++j;
+			}
+			const size_t h1 = keys[i].second, h2 = keys[i + 1].second;
+			if (j == i + 2 && vert(h1) == vert(nextHalf(h2)))
+			{
+				opp[h1] = h2;
+				opp[h2] = h1;
+			}
+			i = j;
+		}
+	}
+
+	std::vector<size_t> queue;
+	std::vector<char> queued(3 * T, 0);
+	auto push = [&](size_t h) {
+		if (opp[h] != npos && !queued[h] && !queued[opp[h]])
+		{
+			queued[h] = 1;
+			queue.push_back(h);
+		}
+	};
+	for (size_t h = 0; h < 3 * T; ++h)
+	{
+		if (h < opp[h])
+		{
+			push(h);
+		}
+	}
+
+	const size_t max_flips = DELAUNAY_FLIPS_PER_TRIANGLE * T;
+	size_t flips = 0;
+	while (!queue.empty() && flips < max_flips)
+	{
+		const size_t h = queue.back();
+		queue.pop_back();
+		queued[h] = 0;
+		const size_t o = opp[h];
+		if (o == npos)
+		{
+			continue;
+		}
+
+		// triangles (a, b, c) and (b, a, d) become (c, a, d) and (d, b, c).
+		const size_t h_bc = nextHalf(h), h_ca = nextHalf(h_bc);
+		const size_t o_ad = nextHalf(o), o_db = nextHalf(o_ad);
+		const unsigned a = vert(h), b = vert(h_bc), c = vert(h_ca), d = vert(o_db);
+
+		if (orient(c, a, d) <= 0.0 || orient(d, b, c) <= 0.0)
+		{
+			continue;
+		}
+		if (orient(a, b, c) > 0.0 && orient(b, a, d) > 0.0 &&
+				sign * carve::geom2d::incircle(poly[a], poly[b], poly[c], poly[d]) <= 0.0)
+		{
+			continue;
+		}
+
+		const size_t t1 = h / 3, t2 = o / 3;
+		const size_t opp_ca = opp[h_ca], opp_ad = opp[o_ad];
+		const size_t opp_db = opp[o_db], opp_bc = opp[h_bc];
+		result[t1] = carve::triangulate::tri_idx(c, a, d);
+		result[t2] = carve::triangulate::tri_idx(d, b, c);
+
+		// the half-edges of the new triangles, and across from them.
+		const size_t half[6] = { 3 * t1, 3 * t1 + 1, 3 * t1 + 2, 3 * t2, 3 * t2 + 1, 3 * t2 + 2 };
+		const size_t across[6] = { opp_ca, opp_ad, 3 * t2 + 2, opp_db, opp_bc, 3 * t1 + 2 };
+		for (size_t i = 0; i < 6; ++i)
+		{
+			opp[half[i]] = across[i];
+			if (across[i] != npos)
+			{
+				opp[across[i]] = half[i];
+			}
+		}
+		for (size_t i = 0; i < 6; ++i)
+		{
+			if (i % 3 != 2)
+			{
+				push(half[i]);
+			}
+		}
+		++flips;
+	}
+	return flips;
+}
@@ -0,0 +1,637 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <carve/triangulator.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <set>
+
+namespace {
+// Triangulation by partition into y-monotone pieces (de Berg et al.,
+// Computational Geometry, ch. 3). The polygon is swept from top to
+// bottom, adding diagonals that remove split and merge vertices; the
+// pieces that result are then triangulated in linear time.
+
+using carve::geom2d::P2;
+using carve::triangulate::tri_idx;
+
+const size_t npos = ~size_t(0);
+
+class MonotoneTriangulator
+{
+	enum vertex_type_t
+	{
+		START,
+		END,
+		SPLIT,
+		MERGE,
+		REGULAR_LEFT, // interior to the right.
+		REGULAR_RIGHT // interior to the left.
+	};
+
+	const std::vector<P2>& p;
+	const size_t N;
+	// the polygon is walked anticlockwise, whatever its input order.
+	const bool reversed;
+
+	std::vector<std::pair<size_t, size_t>> diagonals;
+
+	// vertices in sweep order, and the position of each in it.
+	std::vector<size_t> order, rank;
+
+	// the position of the sweep line.
+	double sweep_x, sweep_y;
+
+	size_t next(size_t i) const
+	{
+		return reversed ? (i ? i - 1 : N - 1) : (i + 1 == N ? 0 : i + 1);
+	}
+
+	size_t prev(size_t i) const
+	{
+		return reversed ? (i + 1 == N ? 0 : i + 1) : (i ? i - 1 : N - 1);
+	}
+
+	// the order in which the sweep visits vertices.
+	bool above(size_t a, size_t b) const
+	{
+		if (p[a].y != p[b].y)
+		{
+			return p[a].y > p[b].y;
+		}
+		if (p[a].x != p[b].x)
+		{
+			return p[a].x < p[b].x;
+		}
+		return a < b;
+	}
+
+	// x coordinate at the sweep line of the edge from e to next(e).
+	double edgeX(size_t e) const
+	{
+		const P2& u = p[e];
+		const P2& w = p[next(e)];
+		if (u.y == w.y)
+		{
+			return std::min(std::max(sweep_x, std::min(u.x, w.x)), std::max(u.x, w.x));
+		}
+		if (sweep_y == u.y)
+		{
+			return u.x;
+		}
+		if (sweep_y == w.y)
+		{
+			return w.x;
+		}
+		return u.x + (sweep_y - u.y) * (w.x - u.x) / (w.y - u.y);
+	}
+
+	// orders the edges cut by the sweep line from left to right. npos
+	// stands for the current event point, which sorts after edges that
+	// pass through it.
+	struct edge_order_t
+	{
+		const MonotoneTriangulator* t;
+
+		bool operator()(size_t a, size_t b) const
+		{
+			if (a == b)
+			{
+				return false;
+			}
+			if (a == npos)
+			{
+				return t->sweep_x < t->edgeX(b);
+			}
+			if (b == npos)
+			{
+				return t->edgeX(a) <= t->sweep_x;
+			}
+			const double xa = t->edgeX(a);
+			const double xb = t->edgeX(b);
+			if (xa != xb)
+			{
+				return xa < xb;
+			}
+			// edges that meet at the sweep line are ordered by direction.
+			const P2 da = t->p[t->next(a)] - t->p[a];
+			const P2 db = t->p[t->next(b)] - t->p[b];
+			const double cross = da.x * db.y - da.y * db.x;
+			if (cross != 0.0)
+			{
+				return cross > 0.0;
+			}
+			return a < b;
+		}
+	};
+
+	vertex_type_t classify(size_t v) const
+	{
+		const size_t a = prev(v), b = next(v);
+		const bool convex = carve::geom2d::orient2d(p[a], p[v], p[b]) > 0.0;
+		if (above(v, a) && above(v, b))
+		{
+			return convex ? START : SPLIT;
+		}
+		if (above(a, v) && above(b, v))
+		{
+			return convex ? END : MERGE;
+		}
+		return above(a, v) ? REGULAR_LEFT : REGULAR_RIGHT;
+	}
+
+	// add diagonals so that every piece is monotone.
+	bool partition()
+	{
+		order.resize(N);
+		for (size_t i = 0; i < N; ++i)
+		{
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(),
+				[this](size_t a, size_t b) { return above(a, b); });
+		rank.resize(N);
+		for (size_t i = 0; i < N; ++i)
+		{
+			rank[order[i]] = i;
+		}
+
+		std::vector<vertex_type_t> type(N);
+		for (size_t i = 0; i < N; ++i)
+		{
+			type[i] = classify(i);
+		}
+
+		std::set<size_t, edge_order_t> status(edge_order_t{ this });
+		std::vector<size_t> helper(N, npos);
+
+		auto fixUp = [&](size_t v, size_t e) {
+			if (helper[e] != npos && type[helper[e]] == MERGE)
+			{
+				diagonals.push_back(std::make_pair(v, helper[e]));
+			}
+		};
+		auto leftOf = [&]() {
+			std::set<size_t, edge_order_t>::iterator i = status.lower_bound(npos);
+			if (i == status.begin())
+			{
+				return npos;
+			}
+			return *--i;
+		};
+
+		for (size_t i = 0; i < N; ++i)
+		{
+			const size_t v = order[i];
+			sweep_x = p[v].x;
+			sweep_y = p[v].y;
+
+			switch (type[v])
+			{
+			case START:
+				status.insert(v);
+				helper[v] = v;
+				break;
+
+			case END:
+				fixUp(v, prev(v));
+				status.erase(prev(v));
+				break;
+
+			case SPLIT:
+			{
+				const size_t e = leftOf();
+				if (e == npos)
+				{
+					return false;
+				}
+				diagonals.push_back(std::make_pair(v, helper[e]));
+				helper[e] = v;
+				status.insert(v);
+				helper[v] = v;
+				break;
+			}
+
+			case MERGE:
+			{
+				fixUp(v, prev(v));
+				status.erase(prev(v));
+				const size_t e = leftOf();
+				if (e == npos)
+				{
+					return false;
+				}
+				fixUp(v, e);
+				helper[e] = v;
+				break;
+			}
+
+			case REGULAR_LEFT:
+				fixUp(v, prev(v));
+				status.erase(prev(v));
+				status.insert(v);
+				helper[v] = v;
+				break;
+
+			case REGULAR_RIGHT:
+			{
+				const size_t e = leftOf();
+				if (e == npos)
+				{
+					return false;
+				}
+				fixUp(v, e);
+				helper[e] = v;
+				break;
+			}
+			}
+		}
+		if (!status.empty())
+		{
+			return false;
+		}
+
+		for (size_t k = 0; k < diagonals.size(); ++k)
+		{
+			diagonals[k].first = twinFacing(diagonals[k].first, diagonals[k].second);
+			diagonals[k].second = twinFacing(diagonals[k].second, diagonals[k].first);
+		}
+		return true;
+	}
+
+	// where a hole was bridged, the polygon passes through a point more
+	// than once. Of the copies of v, return the one whose interior
+	// angle contains w.
+	size_t twinFacing(size_t v, size_t w) const
+	{
+		auto faces = [&](size_t u) {
+			return carve::geom2d::internalToAngle(p[next(u)], p[u], p[prev(u)], p[w]);
+		};
+		if (p[v] == p[w] || faces(v))
+		{
+			return v;
+		}
+		for (size_t i = rank[v]; i-- > 0 && p[order[i]] == p[v];)
+		{
+			if (faces(order[i]))
+			{
+				return order[i];
+			}
+		}
+		for (size_t i = rank[v] + 1; i < N && p[order[i]] == p[v]; ++i)
+		{
+			if (faces(order[i]))
+			{
+				return order[i];
+			}
+		}
+		return v;
+	}
+
+	// split the polygon along the diagonals, returning the vertex loops
+	// of the pieces.
+	bool pieces(std::vector<std::vector<size_t>>& loops) const
+	{
+		// half-edges: i runs from i to next(i), N + 2k and N + 2k + 1 run
+		// along diagonal k in each direction.
+		const size_t n_half = N + 2 * diagonals.size();
+		std::vector<size_t> target(n_half);
+		for (size_t i = 0; i < N; ++i)
+		{
+			target[i] = next(i);
+		}
+
+		// the edges around each vertex with diagonals, as (in, out)
+		// pairs, anticlockwise.
+		struct spoke_t
+		{
+			double angle;
+			int rank;
+			size_t in, out;
+		};
+		std::vector<std::vector<spoke_t>> spokes(N);
+		auto angle = [&](size_t v, size_t w) {
+			const P2 d = p[w] - p[v];
+			return std::atan2(d.y, d.x);
+		};
+		bool ok = true;
+		auto addSpoke = [&](size_t v, size_t w, size_t in, size_t out) {
+			if (p[v] != p[w])
+			{
+				spokes[v].push_back(spoke_t{ angle(v, w), 0, in, out });
+			}
+			// a diagonal joining two copies of a vertex, where a hole was
+			// bridged, leaves v just inside the edge along the bridge.
+			else if (angle(v, next(v)) == angle(w, prev(w)))
+			{
+				spokes[v].push_back(spoke_t{ angle(v, next(v)), +1, in, out });
+			}
+			else if (angle(v, prev(v)) == angle(w, next(w)))
+			{
+				spokes[v].push_back(spoke_t{ angle(v, prev(v)), -1, in, out });
+			}
+			else
+			{
+				ok = false;
+			}
+		};
+		for (size_t k = 0; k < diagonals.size(); ++k)
+		{
+			const size_t a = diagonals[k].first, b = diagonals[k].second;
+			target[N + 2 * k] = b;
+			target[N + 2 * k + 1] = a;
+			for (int j = 0; j < 2; ++j)
+			{
+				const size_t v = j ? b : a;
+				if (spokes[v].empty())
+				{
+					addSpoke(v, next(v), npos, v);
+					addSpoke(v, prev(v), prev(v), npos);
+				}
+			}
+			addSpoke(a, b, N + 2 * k + 1, N + 2 * k);
+			addSpoke(b, a, N + 2 * k, N + 2 * k + 1);
+		}
+		if (!ok)
+		{
+			return false;
+		}
+		for (size_t v = 0; v < N; ++v)
+		{
+			std::sort(spokes[v].begin(), spokes[v].end(),
+					[](const spoke_t& a, const spoke_t& b) {
+						return a.angle < b.angle || (a.angle == b.angle && a.rank < b.rank);
+					});
+		}
+
+		// the piece to the left of half-edge h continues along the first
+		// edge clockwise from h around its target.
+		auto nextHalf = [&](size_t h) {
+			const size_t v = target[h];
+			const std::vector<spoke_t>& s = spokes[v];
+			if (s.empty())
+			{
+				return v;
+			}
+			for (size_t i = 0; i < s.size(); ++i)
+			{
+				if (s[i].in == h)
+				{
+					return s[(i + s.size() - 1) % s.size()].out;
+				}
+			}
+			return npos;
+		};
+
+		std::vector<bool> seen(n_half, false);
+		for (size_t h = 0; h < n_half; ++h)
+		{
+			if (seen[h])
+			{
+				continue;
+			}
+			loops.push_back(std::vector<size_t>());
+			size_t e = h;
+			do
+			{
+				if (e == npos || seen[e])
+				{
+					return false;
+				}
+				seen[e] = true;
+				loops.back().push_back(target[e]);
+				e = nextHalf(e);
+			} while (e != h);
+		}
+		return loops.size() == diagonals.size() + 1;
+	}
+
+	void emit(size_t a, size_t b, size_t c, std::vector<tri_idx>& result) const
+	{
+		if (carve::geom2d::orient2d(p[a], p[b], p[c]) < 0.0)
+		{
+			std::swap(b, c);
+		}
+		// keep the winding of the input polygon.
+		if (reversed)
+		{
+			std::swap(b, c);
+		}
+		result.push_back(tri_idx(unsigned(a), unsigned(b), unsigned(c)));
+	}
+
+	// triangulate a y-monotone, anticlockwise loop.
+	void triangulatePiece(const std::vector<size_t>& loop,
+			std::vector<tri_idx>& result) const
+	{
+		const size_t n = loop.size();
+		if (n == 3)
+		{
+			emit(loop[0], loop[1], loop[2], result);
+			return;
+		}
+
+		size_t top = 0, bottom = 0;
+		for (size_t i = 1; i < n; ++i)
+		{
+			if (above(loop[i], loop[top]))
+			{
+				top = i;
+			}
+			if (above(loop[bottom], loop[i]))
+			{
+				bottom = i;
+			}
+		}
+
+		// merge the left chain (top to bottom, following the loop) and
+		// the right chain (bottom to top).
+		std::vector<std::pair<size_t, bool>> u;
+		u.reserve(n);
+		size_t l = top, r = (top + n - 1) % n;
+		u.push_back(std::make_pair(loop[top], true));
+		while (u.size() < n)
+		{
+			const size_t ln = (l + 1) % n;
+			if (l != bottom && (r == bottom || above(loop[ln], loop[r])))
+			{
+				u.push_back(std::make_pair(loop[ln], true));
+				l = ln;
+			}
+			else
+			{
+				u.push_back(std::make_pair(loop[r], false));
+				r = (r + n - 1) % n;
+			}
+		}
+
+		std::vector<std::pair<size_t, bool>> stack;
+		stack.push_back(u[0]);
+		stack.push_back(u[1]);
+		for (size_t j = 2; j < n - 1; ++j)
+		{
+			if (u[j].second != stack.back().second)
+			{
+				while (stack.size() > 1)
+				{
+					const size_t v = stack.back().first;
+					stack.pop_back();
+					emit(u[j].first, v, stack.back().first, result);
+				}
+				stack.clear();
+				stack.push_back(u[j - 1]);
+				stack.push_back(u[j]);
+			}
+			else
+			{
+				std::pair<size_t, bool> last = stack.back();
+				stack.pop_back();
+				while (!stack.empty())
+				{
+					const size_t a = stack.back().first, b = last.first, c = u[j].first;
+					const double o = u[j].second ? carve::geom2d::orient2d(p[a], p[b], p[c])
+																			 : carve::geom2d::orient2d(p[c], p[b], p[a]);
+					if (o <= 0.0)
+					{
+						break;
+					}
+					emit(a, b, c, result);
+					last = stack.back();
+					stack.pop_back();
+				}
+				stack.push_back(last);
+				stack.push_back(u[j]);
+			}
+		}
+		while (stack.size() > 1)
+		{
+			const size_t v = stack.back().first;
+			stack.pop_back();
+			emit(u[n - 1].first, v, stack.back().first, result);
+		}
+	}
+
+public:
+	MonotoneTriangulator(const std::vector<P2>& _p)
+			: p(_p), N(_p.size()), reversed(carve::geom2d::signedArea(_p) > 0.0),
+				sweep_x(0.0), sweep_y(0.0) {}
+
+	bool run(std::vector<tri_idx>& result)
+	{
+		std::vector<std::vector<size_t>> loops;
+		if (!partition() || !pieces(loops))
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < loops.size(); ++i)
+		{
+			if (loops[i].size() < 3)
+			{
+				return false;
+			}
+			triangulatePiece(loops[i], result);
+		}
+		if (result.size() != N - 2)
+		{
+			return false;
+		}
+
+		// the pieces of a polygon that is not simple can overlap; their
+		// area then exceeds that of the polygon.
+		double area = 0.0;
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			area += std::fabs(carve::geom2d::signedArea(
+					p[result[i].a], p[result[i].b], p[result[i].c]));
+		}
+		const double poly_area = std::fabs(carve::geom2d::signedArea(p));
+		return std::fabs(area - poly_area) <= 1e-9 * std::max(area, poly_area);
+	}
+};
+} // namespace
+
+bool carve::triangulate::triangulateMonotone(
+		const std::vector<carve::geom2d::P2>& poly,
+		std::vector<carve::triangulate::tri_idx>& result)
+{
+	result.clear();
+	if (poly.size() < 3)
+	{
+		return true;
+	}
+	result.reserve(poly.size() - 2);
+
+	// drop repeated vertices; each becomes a degenerate triangle.
+	std::vector<carve::geom2d::P2> loop;
+	std::vector<size_t> loop_idx;
+	loop.reserve(poly.size());
+	loop_idx.reserve(poly.size());
+	for (size_t i = 0; i < poly.size(); ++i)
+	{
+		if (loop.empty() || poly[i] != loop.back())
+		{
+			loop.push_back(poly[i]);
+			loop_idx.push_back(i);
+		}
+	}
+	while (loop.size() > 1 && loop.back() == loop.front())
+	{
+		loop.pop_back();
+		loop_idx.pop_back();
+	}
+	if (loop.size() < 3)
+	{
+		return false;
+	}
+
+	if (!MonotoneTriangulator(loop).run(result))
+	{
+		result.clear();
+		return false;
+	}
+
+	if (loop.size() != poly.size())
+	{
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			for (size_t j = 0; j < 3; ++j)
+			{
+				result[i].v[j] = unsigned(loop_idx[result[i].v[j]]);
+			}
+		}
+		for (size_t i = 0; i < loop_idx.size(); ++i)
+		{
+			const size_t a = loop_idx[i];
+			const size_t b = i + 1 == loop_idx.size() ? loop_idx[0] + poly.size() : loop_idx[i + 1];
+			for (size_t j = a + 1; j < b; ++j)
+			{
+				result.push_back(tri_idx(unsigned(a), unsigned(j % poly.size()),
+						unsigned((j + 1) % poly.size())));
+			}
+		}
+	}
+	return true;
+}
@@ -182,6 +182,10 @@ int main(int argc, char** argv)
 	{
 		poly = readOBJasMesh(options.file);
 	}
+	else if (endswith(options.file, ".stl"))
+	{
+		poly = readSTLasMesh(options.file);
+	}
 
 	if (poly == nullptr)
 	{
@@ -166,6 +166,10 @@ int main(int argc, char** argv)
 		{
 			readOBJ(options.file, inputs);
 		}
+		else if (endswith(options.file, ".stl"))
+		{
+			readSTL(options.file, inputs);
+		}
 	}
 
 	for (std::list<carve::input::Data*>::const_iterator i = inputs.input.begin();
@@ -134,6 +134,10 @@ carve::mesh::MeshSet<3>* read(const std::string& s)
 	{
 		return readOBJasMesh(s);
 	}
+	else if (endswith(s, ".stl"))
+	{
+		return readSTLasMesh(s);
+	}
 	else
 	{
 		return readPLYasMesh(s);
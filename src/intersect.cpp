@@ -43,6 +43,7 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 #include <set>
 #include <string>
 #include <utility>
@@ -54,6 +55,7 @@ struct Options : public opt::Parser
 	bool ascii;
 	bool obj;
 	bool vtk;
+	bool stl;
 	bool rescale;
 	bool canonicalize;
 	bool from_file;
@@ -103,6 +105,11 @@ struct Options : public opt::Parser
 			vtk = true;
 			return;
 		}
+		if (o == "--stl" || o == "-S")
+		{
+			stl = true;
+			return;
+		}
 		if (o == "--ascii" || o == "-a")
 		{
 			ascii = true;
@@ -140,6 +147,11 @@ struct Options : public opt::Parser
 			classifier = carve::csg::CSG::CLASSIFY_EDGE;
 			return;
 		}
+		if (o == "--flood" || o == "-F")
+		{
+			classifier = carve::csg::CSG::CLASSIFY_FLOOD;
+			return;
+		}
 		if (o == "--epsilon" || o == "-E")
 		{
 			carve::setEpsilon(strtod(v.c_str(), nullptr));
@@ -223,6 +235,12 @@ struct Options : public opt::Parser
 		out << "  file.obj                            - an object in wavefront "
 					 ".obj format."
 				<< std::endl;
+		out << "  file.stl                            - an object in ascii or "
+					 "binary .stl format."
+				<< std::endl;
+		out << "  file.cmesh                          - an object in carve binary "
+					 ".cmesh format."
+				<< std::endl;
 		out << "  (expression)                        - a subexpression to be "
 					 "evaluated."
 				<< std::endl;
@@ -255,6 +273,7 @@ struct Options : public opt::Parser
 		ascii = true;
 		obj = false;
 		vtk = false;
+		stl = false;
 		rescale = false;
 		triangulate = false;
 		no_holes = false;
@@ -270,6 +289,7 @@ struct Options : public opt::Parser
 		option("ascii", 'a', false, "ASCII output (default).");
 		option("obj", 'O', false, "Output in .obj format.");
 		option("vtk", 'V', false, "Output in .vtk format.");
+		option("stl", 'S', false, "Output in .stl format.");
 		option("rescale", 'r', false, "Rescale prior to CSG operations.");
 		option("triangulate", 't', false, "Triangulate output.");
 		option("no-holes", 'n', false, "Split faces containing holes.");
@@ -279,6 +299,8 @@ struct Options : public opt::Parser
 		option("improve", 'i', false,
 				"Improve triangulation by minimising internal edge lengths.");
 		option("edge", 'e', false, "Use edge classifier.");
+		option("flood", 'F', false,
+				"Propagate group classifications across crossing edges.");
 		option("epsilon", 'E', true, "Set epsilon used for calculations.");
 		option("file", 'f', true, "Read CSG expression from file.");
 		option("help", 'h', false, "This help message.");
@@ -450,6 +472,11 @@ carve::csg::CSG_TreeNode* parseBracketExpr(TOK& tok)
 	return result;
 }
 
+// Atoms that are spelled the same share one mesh set (owned by the
+// node of the first of them), so that the subexpressions built from
+// them are recognised as equal by the evaluation cache.
+static std::map<std::string, carve::mesh::MeshSet<3>*> atoms;
+
 carve::csg::CSG_TreeNode* parseAtom(TOK& tok)
 {
 	if (*tok == "(")
@@ -458,6 +485,24 @@ carve::csg::CSG_TreeNode* parseAtom(TOK& tok)
 	}
 	else
 	{
+		std::string atom = *tok;
+		TOK last = tok;
+		if (*(tok + 1) == "(")
+		{
+			do
+			{
+				++last;
+				atom += *last;
+			} while (*last != ")" && *last != "$");
+		}
+		std::map<std::string, carve::mesh::MeshSet<3>*>::iterator shared =
+				atoms.find(atom);
+		if (shared != atoms.end())
+		{
+			tok = last + 1;
+			return new carve::csg::CSG_PolyNode(shared->second, false);
+		}
+
 		carve::mesh::MeshSet<3>* poly = nullptr;
 
 		if (*tok == "CUBE")
@@ -609,6 +654,14 @@ carve::csg::CSG_TreeNode* parseAtom(TOK& tok)
 		{
 			poly = readOBJasMesh(*tok);
 		}
+		else if (endswith(*tok, ".stl"))
+		{
+			poly = readSTLasMesh(*tok);
+		}
+		else if (endswith(*tok, ".cmesh"))
+		{
+			poly = readCarveMesh(*tok);
+		}
 		if (poly == nullptr)
 		{
 			return nullptr;
@@ -635,6 +688,7 @@ carve::csg::CSG_TreeNode* parseAtom(TOK& tok)
 		std::cerr << std::endl;
 
 		++tok;
+		atoms[atom] = poly;
 		return new carve::csg::CSG_PolyNode(poly, true);
 	}
 }
@@ -952,6 +1006,10 @@ carve::csg::CSG_TreeNode* parseExpr(TOK& tok)
 		return nullptr;
 	}
 
+	// runs of unions or intersections are collected into a single n-ary
+	// node, which can evaluate them as a balanced, concurrent reduction.
+	carve::csg::CSG_NaryOPNode* nary = nullptr;
+
 	while (parseOP(tok, op))
 	{
 		carve::csg::CSG_TreeNode* rhs = parseTransform(tok);
@@ -960,8 +1018,25 @@ carve::csg::CSG_TreeNode* parseExpr(TOK& tok)
 			delete lhs;
 			return nullptr;
 		}
-		lhs = new carve::csg::CSG_OPNode(lhs, rhs, op, options.rescale,
-				options.classifier);
+		if (nary != nullptr && nary->getOp() == op)
+		{
+			nary->addChild(rhs);
+		}
+		else if (op == carve::csg::CSG::UNION ||
+						 op == carve::csg::CSG::INTERSECTION)
+		{
+			nary = new carve::csg::CSG_NaryOPNode(op, options.rescale,
+					options.classifier);
+			nary->addChild(lhs);
+			nary->addChild(rhs);
+			lhs = nary;
+		}
+		else
+		{
+			lhs = new carve::csg::CSG_OPNode(lhs, rhs, op, options.rescale,
+					options.classifier);
+			nary = nullptr;
+		}
 	}
 	return lhs;
 }
@@ -1008,6 +1083,8 @@ int main(int argc, char** argv)
 		try
 		{
 			carve::csg::CSG csg;
+			carve::csg::CSG_TreeCache cache;
+			csg.tree_cache = &cache;
 
 			if (options.triangulate)
 			{
@@ -1031,13 +1108,13 @@ int main(int argc, char** argv)
 					{
 						csg.hooks.registerHook(
 								new carve::csg::CarveTriangulatorWithImprovement,
-								carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+								carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACES_BIT);
 					}
 					else
 					{
 						csg.hooks.registerHook(
 								new carve::csg::CarveTriangulator,
-								carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+								carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACES_BIT);
 					}
 #if !defined(DISABLE_GLU_TRIANGULATOR)
 				}
@@ -1074,6 +1151,10 @@ int main(int argc, char** argv)
 			{
 				writeVTK(std::cout, result);
 			}
+			else if (options.stl)
+			{
+				writeSTL(std::cout, result, options.ascii);
+			}
 			else
 			{
 				writePLY(std::cout, result, options.ascii);
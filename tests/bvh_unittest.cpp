@@ -0,0 +1,130 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <gtest/gtest.h>
+
+#include <carve/carve.hpp>
+#include <carve/bvh.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using aabb_t = carve::geom::aabb<3>;
+
+struct box_t
+{
+	aabb_t bbox;
+	aabb_t getAABB() const { return bbox; }
+};
+
+using bvh_t = carve::geom::DynamicBVH<3, const box_t*>;
+
+static aabb_t randomBox(std::mt19937& rng)
+{
+	std::uniform_real_distribution<double> pos(-10.0, 10.0);
+	std::uniform_real_distribution<double> ext(0.0, 1.0);
+	return aabb_t(carve::geom::VECTOR(pos(rng), pos(rng), pos(rng)),
+			carve::geom::VECTOR(ext(rng), ext(rng), ext(rng)));
+}
+
+static void checkSearch(const bvh_t& bvh, const std::vector<box_t>& boxes,
+		const std::vector<bool>& present, std::mt19937& rng)
+{
+	for (int q = 0; q < 50; ++q)
+	{
+		aabb_t query = randomBox(rng);
+		query.extent *= 3.0;
+		std::vector<const box_t*> found, expected;
+		bvh.search(query, std::back_inserter(found));
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			if (present[i] && boxes[i].bbox.intersects(query))
+			{
+				expected.push_back(&boxes[i]);
+			}
+		}
+		std::sort(found.begin(), found.end());
+		ASSERT_EQ(found, expected);
+	}
+}
+
+TEST(DynamicBVHTest, BuildInsertRemoveUpdate)
+{
+	std::mt19937 rng(1);
+	std::vector<box_t> boxes(1000);
+	std::vector<const box_t*> ptrs;
+	for (box_t& b : boxes)
+	{
+		b.bbox = randomBox(rng);
+	}
+	for (size_t i = 0; i < boxes.size() / 2; ++i)
+	{
+		ptrs.push_back(&boxes[i]);
+	}
+
+	bvh_t bvh(ptrs.begin(), ptrs.end());
+	std::vector<bool> present(boxes.size(), false);
+	std::fill(present.begin(), present.begin() + boxes.size() / 2, true);
+	ASSERT_EQ(bvh.size(), boxes.size() / 2);
+	checkSearch(bvh, boxes, present, rng);
+
+	for (size_t i = boxes.size() / 2; i < boxes.size(); ++i)
+	{
+		bvh.insert(&boxes[i]);
+		present[i] = true;
+	}
+	checkSearch(bvh, boxes, present, rng);
+
+	for (size_t i = 0; i < boxes.size(); i += 3)
+	{
+		ASSERT_TRUE(bvh.remove(&boxes[i]));
+		present[i] = false;
+	}
+	ASSERT_FALSE(bvh.remove(&boxes[0]));
+	checkSearch(bvh, boxes, present, rng);
+
+	for (size_t i = 1; i < boxes.size(); i += 2)
+	{
+		boxes[i].bbox = randomBox(rng);
+		ASSERT_EQ(bvh.update(&boxes[i]), bool(present[i]));
+	}
+	checkSearch(bvh, boxes, present, rng);
+
+	for (box_t& b : boxes)
+	{
+		b.bbox.pos *= 0.5;
+	}
+	bvh.refit();
+	checkSearch(bvh, boxes, present, rng);
+
+	for (size_t i = 0; i < boxes.size(); ++i)
+	{
+		if (present[i])
+		{
+			bvh.remove(&boxes[i]);
+		}
+	}
+	ASSERT_TRUE(bvh.empty());
+}
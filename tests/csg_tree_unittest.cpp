@@ -0,0 +1,428 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <gtest/gtest.h>
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/csg_triangulator.hpp>
+#include <carve/input.hpp>
+#include <carve/parallel.hpp>
+#include <carve/tree.hpp>
+
+#include <memory>
+#include <set>
+#include <vector>
+
+static carve::mesh::MeshSet<3>* makeCube(const carve::math::Matrix& transform)
+{
+	carve::input::PolyhedronData data;
+
+	data.addVertex(transform * carve::geom::VECTOR(+1.0, +1.0, +1.0));
+	data.addVertex(transform * carve::geom::VECTOR(-1.0, +1.0, +1.0));
+	data.addVertex(transform * carve::geom::VECTOR(-1.0, -1.0, +1.0));
+	data.addVertex(transform * carve::geom::VECTOR(+1.0, -1.0, +1.0));
+	data.addVertex(transform * carve::geom::VECTOR(+1.0, +1.0, -1.0));
+	data.addVertex(transform * carve::geom::VECTOR(-1.0, +1.0, -1.0));
+	data.addVertex(transform * carve::geom::VECTOR(-1.0, -1.0, -1.0));
+	data.addVertex(transform * carve::geom::VECTOR(+1.0, -1.0, -1.0));
+
+	data.addFace(0, 1, 2, 3);
+	data.addFace(7, 6, 5, 4);
+	data.addFace(0, 4, 5, 1);
+	data.addFace(1, 5, 6, 2);
+	data.addFace(2, 6, 7, 3);
+	data.addFace(3, 7, 4, 0);
+
+	return new carve::mesh::MeshSet<3>(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+static double volume(const carve::mesh::MeshSet<3>* poly)
+{
+	double vol = 0.0;
+	for (size_t i = 0; i < poly->meshes.size(); ++i)
+	{
+		vol += poly->meshes[i]->volume();
+	}
+	return vol;
+}
+
+// a row of 4 overlapping cubes, and 4 cubes well apart from everything.
+static std::vector<carve::csg::CSG_TreeNode*> makeParts()
+{
+	std::vector<carve::csg::CSG_TreeNode*> parts;
+	for (int i = 0; i < 4; ++i)
+	{
+		parts.push_back(new carve::csg::CSG_PolyNode(
+				makeCube(carve::math::Matrix::TRANS(1.5 * i, 0.1 * i, 0.2 * i)), true));
+		parts.push_back(new carve::csg::CSG_PolyNode(
+				makeCube(carve::math::Matrix::TRANS(5.0 * i, 20, 0)), true));
+	}
+	return parts;
+}
+
+TEST(CSGTreeTest, NaryUnion)
+{
+	carve::parallel::setThreadCount(4);
+	for (int rescale = 0; rescale < 2; ++rescale)
+	{
+		std::vector<carve::csg::CSG_TreeNode*> parts = makeParts();
+		carve::csg::CSG_NaryOPNode nary(parts.begin(), parts.end(),
+				carve::csg::CSG::UNION, rescale != 0);
+
+		parts = makeParts();
+		carve::csg::CSG_TreeNode* chain = parts[0];
+		for (size_t i = 1; i < parts.size(); ++i)
+		{
+			chain = new carve::csg::CSG_OPNode(chain, parts[i],
+					carve::csg::CSG::UNION, rescale != 0);
+		}
+
+		carve::csg::CSG csg;
+		carve::mesh::MeshSet<3>* a = static_cast<carve::csg::CSG_TreeNode&>(nary).eval(csg);
+		carve::mesh::MeshSet<3>* b = chain->eval(csg);
+
+		ASSERT_EQ(a->meshes.size(), 5U);
+		ASSERT_EQ(a->meshes.size(), b->meshes.size());
+		ASSERT_NEAR(volume(a), volume(b), 1e-6);
+		ASSERT_NEAR(volume(a), 4 * 8.0 + 8.0 * 4 - 3 * 0.5 * 1.9 * 1.8, 1e-6);
+
+		delete a;
+		delete b;
+		delete chain;
+	}
+	carve::parallel::setThreadCount(0);
+}
+
+TEST(CSGTreeTest, NaryIntersection)
+{
+	carve::parallel::setThreadCount(4);
+	std::vector<carve::csg::CSG_TreeNode*> parts;
+	for (int i = 0; i < 3; ++i)
+	{
+		parts.push_back(new carve::csg::CSG_PolyNode(
+				makeCube(carve::math::Matrix::TRANS(0.5 * i, 0.25 * i, 0.125 * i)), true));
+	}
+	carve::csg::CSG_NaryOPNode nary(parts.begin(), parts.end(),
+			carve::csg::CSG::INTERSECTION, false);
+
+	carve::csg::CSG csg;
+	carve::csg::CSG_TreeNode* node = &nary;
+	carve::mesh::MeshSet<3>* a = node->eval(csg);
+	ASSERT_EQ(a->meshes.size(), 1U);
+	ASSERT_NEAR(volume(a), 1.0 * 1.5 * 1.75, 1e-6);
+	delete a;
+
+	// a disjoint operand makes the intersection empty.
+	nary.addChild(new carve::csg::CSG_PolyNode(
+			makeCube(carve::math::Matrix::TRANS(10, 0, 0)), true));
+	a = node->eval(csg);
+	ASSERT_TRUE(a->meshes.empty());
+	delete a;
+	carve::parallel::setThreadCount(0);
+}
+
+// registered hooks see the faces of disjoint operands, as they do when
+// the operands are combined by CSG_OPNode.
+TEST(CSGTreeTest, NaryHooks)
+{
+	size_t n_faces[2];
+	for (int nary = 0; nary < 2; ++nary)
+	{
+		carve::csg::CSG_TreeNode* a = new carve::csg::CSG_PolyNode(
+				makeCube(carve::math::Matrix::IDENT()), true);
+		carve::csg::CSG_TreeNode* b = new carve::csg::CSG_PolyNode(
+				makeCube(carve::math::Matrix::TRANS(10, 0, 0)), true);
+		std::unique_ptr<carve::csg::CSG_TreeNode> node;
+		if (nary)
+		{
+			carve::csg::CSG_NaryOPNode* n =
+					new carve::csg::CSG_NaryOPNode(carve::csg::CSG::UNION, false);
+			n->addChild(a);
+			n->addChild(b);
+			node.reset(n);
+		}
+		else
+		{
+			node.reset(new carve::csg::CSG_OPNode(a, b, carve::csg::CSG::UNION, false));
+		}
+
+		carve::csg::CSG csg;
+		csg.hooks.registerHook(new carve::csg::CarveTriangulator,
+				carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+		std::unique_ptr<carve::mesh::MeshSet<3>> result(node->eval(csg));
+		ASSERT_EQ(result->meshes.size(), 2U);
+		n_faces[nary] = 0;
+		for (carve::mesh::MeshSet<3>::face_iter i = result->faceBegin();
+				 i != result->faceEnd(); ++i)
+		{
+			ASSERT_EQ((*i)->nVertices(), 3U);
+			++n_faces[nary];
+		}
+	}
+	ASSERT_EQ(n_faces[0], 24U);
+	ASSERT_EQ(n_faces[1], n_faces[0]);
+}
+
+// the mesh sets that the faces of a result come from.
+struct SourceHook : public carve::csg::CSG::Hook
+{
+	std::set<const carve::mesh::MeshSet<3>*>& sources;
+
+	explicit SourceHook(std::set<const carve::mesh::MeshSet<3>*>& _sources)
+			: sources(_sources) {}
+
+	void resultFace(const carve::mesh::MeshSet<3>::face_t* /* new_face */,
+			const carve::mesh::MeshSet<3>::face_t* orig_face, bool /* flipped */) override
+	{
+		sources.insert(static_cast<const carve::mesh::MeshSet<3>*>(orig_face->mesh->meshset));
+	}
+};
+
+// a transformed operand that the node does not own is used as it is,
+// with the node's other (owned) operand moved into its frame instead.
+TEST(CSGTreeTest, OperandFrame)
+{
+	std::unique_ptr<carve::mesh::MeshSet<3>> a(makeCube(carve::math::Matrix::IDENT()));
+	std::unique_ptr<carve::mesh::MeshSet<3>> b(makeCube(carve::math::Matrix::IDENT()));
+	std::unique_ptr<carve::mesh::MeshSet<3>> c(
+			makeCube(carve::math::Matrix::TRANS(10, 0, 0)));
+	const carve::math::Matrix t = carve::math::Matrix::TRANS(1, 0.5, 0.25) *
+			carve::math::Matrix::ROT(0.3, 1, 2, 3);
+
+	double expected;
+	{
+		carve::csg::CSG csg;
+		std::unique_ptr<carve::mesh::MeshSet<3>> moved(a->clone());
+		moved->transform(carve::math::matrix_transformation(t));
+		std::unique_ptr<carve::mesh::MeshSet<3>> bc(
+				csg.compute(b.get(), c.get(), carve::csg::CSG::UNION));
+		std::unique_ptr<carve::mesh::MeshSet<3>> abc(
+				csg.compute(moved.get(), bc.get(), carve::csg::CSG::UNION));
+		expected = volume(abc.get());
+	}
+
+	for (int nary = 0; nary < 2; ++nary)
+	{
+		carve::csg::CSG_TreeNode* moved = new carve::csg::CSG_TransformNode(t,
+				new carve::csg::CSG_PolyNode(a.get(), false));
+		carve::csg::CSG_TreeNode* bc = new carve::csg::CSG_OPNode(
+				new carve::csg::CSG_PolyNode(b.get(), false),
+				new carve::csg::CSG_PolyNode(c.get(), false), carve::csg::CSG::UNION, false);
+		std::unique_ptr<carve::csg::CSG_TreeNode> node;
+		if (nary)
+		{
+			carve::csg::CSG_NaryOPNode* n =
+					new carve::csg::CSG_NaryOPNode(carve::csg::CSG::UNION, false);
+			n->addChild(moved);
+			n->addChild(bc);
+			node.reset(n);
+		}
+		else
+		{
+			node.reset(new carve::csg::CSG_OPNode(moved, bc, carve::csg::CSG::UNION, false));
+		}
+
+		std::set<const carve::mesh::MeshSet<3>*> sources;
+		carve::csg::CSG csg;
+		csg.hooks.registerHook(new SourceHook(sources),
+				carve::csg::CSG::Hooks::RESULT_FACE_BIT);
+		std::unique_ptr<carve::mesh::MeshSet<3>> result(node->eval(csg));
+		ASSERT_NEAR(volume(result.get()), expected, 1e-6);
+		ASSERT_EQ(result->meshes.size(), 2U);
+		ASSERT_TRUE(sources.count(a.get()) != 0);
+	}
+	ASSERT_EQ(a->vertex_storage[0].v, carve::geom::VECTOR(+1.0, +1.0, +1.0));
+}
+
+// transformed and rescaled operands that are not owned by the tree are
+// left as they were.
+TEST(CSGTreeTest, SharedOperands)
+{
+	carve::mesh::MeshSet<3>* cube = makeCube(carve::math::Matrix::IDENT());
+	std::vector<carve::geom3d::Vector> points;
+	for (size_t i = 0; i < cube->vertex_storage.size(); ++i)
+	{
+		points.push_back(cube->vertex_storage[i].v);
+	}
+	std::vector<carve::geom3d::Plane> planes;
+	for (size_t i = 0; i < cube->meshes[0]->faces.size(); ++i)
+	{
+		planes.push_back(cube->meshes[0]->faces[i]->plane);
+	}
+
+	for (unsigned threads = 1; threads <= 4; threads += 3)
+	{
+		carve::parallel::setThreadCount(threads);
+		for (int rescale = 0; rescale < 2; ++rescale)
+		{
+			carve::csg::CSG csg;
+
+			carve::csg::CSG_OPNode op(
+					new carve::csg::CSG_TransformNode(
+							carve::math::Matrix::TRANS(1, 0.5, 0.25),
+							new carve::csg::CSG_PolyNode(cube, false)),
+					new carve::csg::CSG_PolyNode(cube, false), carve::csg::CSG::UNION,
+					rescale != 0);
+			carve::mesh::MeshSet<3>* a = static_cast<carve::csg::CSG_TreeNode&>(op).eval(csg);
+			ASSERT_NEAR(volume(a), 16.0 - 1.0 * 1.5 * 1.75, 1e-6);
+			delete a;
+
+			carve::csg::CSG_NaryOPNode nary(carve::csg::CSG::UNION, rescale != 0);
+			nary.addChild(new carve::csg::CSG_PolyNode(cube, false));
+			nary.addChild(new carve::csg::CSG_TransformNode(
+					carve::math::Matrix::TRANS(1, 0.5, 0.25),
+					new carve::csg::CSG_PolyNode(cube, false)));
+			nary.addChild(new carve::csg::CSG_TransformNode(
+					carve::math::Matrix::TRANS(0, 0.5, 0),
+					new carve::csg::CSG_TransformNode(carve::math::Matrix::TRANS(20, 0, 0),
+							new carve::csg::CSG_PolyNode(cube, false))));
+			a = static_cast<carve::csg::CSG_TreeNode&>(nary).eval(csg);
+			ASSERT_EQ(a->meshes.size(), 2U);
+			ASSERT_NEAR(volume(a), 24.0 - 1.0 * 1.5 * 1.75, 1e-6);
+			delete a;
+
+			for (size_t i = 0; i < points.size(); ++i)
+			{
+				ASSERT_EQ(cube->vertex_storage[i].v, points[i]);
+			}
+			for (size_t i = 0; i < planes.size(); ++i)
+			{
+				ASSERT_EQ(cube->meshes[0]->faces[i]->plane.N, planes[i].N);
+				ASSERT_EQ(cube->meshes[0]->faces[i]->plane.d, planes[i].d);
+			}
+			ASSERT_FALSE(cube->meshes[0]->isNegative());
+		}
+	}
+	carve::parallel::setThreadCount(0);
+	delete cube;
+}
+
+// a cube with a corner cut away, as a new subtree over shared leaves.
+static carve::csg::CSG_TreeNode* makeCutCube(carve::mesh::MeshSet<3>* cube)
+{
+	return new carve::csg::CSG_OPNode(new carve::csg::CSG_PolyNode(cube, false),
+			new carve::csg::CSG_TransformNode(carve::math::Matrix::TRANS(1, 1, 1),
+					new carve::csg::CSG_PolyNode(cube, false)),
+			carve::csg::CSG::A_MINUS_B, false);
+}
+
+TEST(CSGTreeTest, TreeCache)
+{
+	carve::mesh::MeshSet<3>* cube = makeCube(carve::math::Matrix::IDENT());
+
+	for (unsigned threads = 1; threads <= 4; threads += 3)
+	{
+		carve::parallel::setThreadCount(threads);
+
+		carve::csg::CSG_NaryOPNode nary(carve::csg::CSG::UNION, false);
+		nary.addChild(makeCutCube(cube));
+		nary.addChild(new carve::csg::CSG_TransformNode(
+				carve::math::Matrix::TRANS(5, 0, 0), makeCutCube(cube)));
+		nary.addChild(new carve::csg::CSG_TransformNode(
+				carve::math::Matrix::TRANS(0, 5, 0), makeCutCube(cube)));
+		carve::csg::CSG_TreeNode* node = &nary;
+
+		carve::csg::CSG csg;
+		carve::mesh::MeshSet<3>* a = node->eval(csg);
+
+		carve::csg::CSG_TreeCache cache;
+		csg.tree_cache = &cache;
+		carve::mesh::MeshSet<3>* b = node->eval(csg);
+		ASSERT_EQ(cache.size(), 1U);
+		ASSERT_EQ(cache.hits(), 2U);
+
+		ASSERT_EQ(a->meshes.size(), 3U);
+		ASSERT_EQ(b->meshes.size(), a->meshes.size());
+		ASSERT_NEAR(volume(a), 3 * 7.0, 1e-6);
+		ASSERT_NEAR(volume(b), volume(a), 1e-6);
+		delete a;
+		delete b;
+
+		// a second evaluation is answered from the cache.
+		carve::csg::CSG_OPNode op(makeCutCube(cube),
+				new carve::csg::CSG_TransformNode(
+						carve::math::Matrix::TRANS(0.5, 0, 0), makeCutCube(cube)),
+				carve::csg::CSG::INTERSECTION, false);
+		a = static_cast<carve::csg::CSG_TreeNode&>(op).eval(csg);
+		ASSERT_EQ(cache.size(), 1U);
+		ASSERT_EQ(cache.hits(), 4U);
+		ASSERT_NEAR(volume(a), 1.5 * 2 * 2 - 1.0, 1e-6);
+		delete a;
+
+		cache.clear();
+		ASSERT_EQ(cache.size(), 0U);
+	}
+	carve::parallel::setThreadCount(0);
+	delete cube;
+}
+
+// a leaf that counts how often its hash is computed.
+class CountingPolyNode : public carve::csg::CSG_PolyNode
+{
+	size_t& n_hashes;
+
+public:
+	CountingPolyNode(carve::mesh::MeshSet<3>* poly, size_t& _n_hashes)
+			: CSG_PolyNode(poly, false), n_hashes(_n_hashes) {}
+
+protected:
+	size_t computeHash() const override
+	{
+		++n_hashes;
+		return CSG_PolyNode::computeHash();
+	}
+};
+
+// looking up every node of a deep tree hashes each subtree once.
+TEST(CSGTreeTest, TreeCacheHashOnce)
+{
+	carve::mesh::MeshSet<3>* cube = makeCube(carve::math::Matrix::IDENT());
+	size_t n_hashes = 0;
+	const size_t n = 8;
+	carve::csg::CSG_TreeNode* node = new CountingPolyNode(cube, n_hashes);
+	for (size_t i = 1; i < n; ++i)
+	{
+		node = new carve::csg::CSG_OPNode(node,
+				new carve::csg::CSG_TransformNode(carve::math::Matrix::TRANS(1.5 * i, 0, 0),
+						new CountingPolyNode(cube, n_hashes)),
+				carve::csg::CSG::UNION, false);
+	}
+
+	carve::csg::CSG csg;
+	carve::csg::CSG_TreeCache cache;
+	csg.tree_cache = &cache;
+	for (int run = 0; run < 2; ++run)
+	{
+		carve::mesh::MeshSet<3>* a = node->eval(csg);
+		ASSERT_EQ(a->meshes.size(), 1U);
+		delete a;
+		// the root is not looked up, so its right leaf is never hashed.
+		ASSERT_EQ(n_hashes, n - 1);
+	}
+	cache.clear();
+	delete node;
+	delete cube;
+}
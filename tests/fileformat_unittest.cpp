@@ -0,0 +1,373 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <gtest/gtest.h>
+
+#include <carve/carve.hpp>
+#include <carve/csg.hpp>
+#include <carve/input.hpp>
+#include <carve/mesh.hpp>
+#include <carve/parallel.hpp>
+
+#include "carve_binary.hpp"
+#include "geometry.hpp"
+#include "read_ply.hpp"
+#include "write_ply.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <sstream>
+
+TEST(FileFormatTest, STLBinaryRoundTrip)
+{
+	std::unique_ptr<carve::mesh::MeshSet<3>> cube(makeCube());
+
+	std::stringstream stl;
+	writeSTL(stl, cube.get(), false);
+	// 84 byte header, 50 bytes per triangle, two triangles per cube face.
+	ASSERT_EQ(stl.str().size(), 84U + 12U * 50U);
+
+	std::unique_ptr<carve::mesh::MeshSet<3>> result(readSTLasMesh(stl));
+	ASSERT_TRUE(result != nullptr);
+	ASSERT_EQ(result->vertex_storage.size(), 8U);
+	ASSERT_EQ(result->meshes.size(), 1U);
+	ASSERT_TRUE(result->isClosed());
+	ASSERT_NEAR(result->meshes[0]->volume(), cube->meshes[0]->volume(), 1e-6);
+}
+
+TEST(FileFormatTest, STLAsciiRoundTrip)
+{
+	std::unique_ptr<carve::mesh::MeshSet<3>> torus(makeTorus(20, 20, 2.0, 0.5));
+
+	std::stringstream stl;
+	writeSTL(stl, torus.get(), true);
+	ASSERT_EQ(stl.str().compare(0, 5, "solid"), 0);
+
+	carve::input::Input inputs;
+	ASSERT_TRUE(readSTL(stl, inputs));
+	ASSERT_EQ(inputs.input.size(), 1U);
+
+	std::unique_ptr<carve::mesh::MeshSet<3>> result(
+			inputs.create<carve::mesh::MeshSet<3>>(inputs.input.front()));
+	ASSERT_EQ(result->vertex_storage.size(), torus->vertex_storage.size());
+	ASSERT_TRUE(result->isClosed());
+}
+
+TEST(FileFormatTest, STLWeldTolerance)
+{
+	// two triangles sharing an edge whose endpoints differ slightly.
+	std::stringstream stl;
+	stl << "solid test\n"
+			<< "facet normal 0 0 1\n outer loop\n"
+			<< "  vertex 0 0 0\n  vertex 1 0 0\n  vertex 0 1 0\n"
+			<< " endloop\nendfacet\n"
+			<< "facet normal 0 0 1\n outer loop\n"
+			<< "  vertex 1.000001 0 0\n  vertex 1 1 0\n  vertex 0 1.000001 0\n"
+			<< " endloop\nendfacet\n"
+			<< "endsolid test\n";
+	const std::string data = stl.str();
+
+	for (unsigned threads = 1; threads <= 4; threads += 3)
+	{
+		carve::parallel::setThreadCount(threads);
+
+		std::istringstream exact_in(data);
+		std::unique_ptr<carve::mesh::MeshSet<3>> exact(readSTLasMesh(exact_in));
+		ASSERT_EQ(exact->vertex_storage.size(), 6U);
+		ASSERT_EQ(exact->meshes.size(), 2U);
+
+		std::istringstream welded_in(data);
+		std::unique_ptr<carve::mesh::MeshSet<3>> welded(
+				readSTLasMesh(welded_in, carve::math::Matrix::IDENT(), 1e-4));
+		ASSERT_EQ(welded->vertex_storage.size(), 4U);
+		ASSERT_EQ(welded->meshes.size(), 1U);
+	}
+	carve::parallel::setThreadCount(0);
+}
+
+TEST(FileFormatTest, STLWeldAcrossCells)
+{
+	// with a tolerance of 0.1, a is within tolerance of b, and b of c,
+	// across a cell boundary at x = 0.1; d and e share a cell, but are
+	// further apart than the tolerance.
+	const double corner[5][3] = {
+		{ 0.01, 0, 0 }, // a
+		{ 0.099, 0, 0 }, // b
+		{ 0.15, 0, 0 }, // c
+		{ 5.001, 5.001, 5.001 }, // d
+		{ 5.099, 5.099, 5.099 }, // e
+	};
+	std::stringstream stl;
+	stl << "solid test\n";
+	for (int i = 0; i < 5; ++i)
+	{
+		stl << "facet normal 0 0 1\n outer loop\n"
+				<< "  vertex " << corner[i][0] << " " << corner[i][1] << " " << corner[i][2] << "\n"
+				<< "  vertex " << 20 * i << " 20 0\n"
+				<< "  vertex " << 20 * i << " 0 20\n"
+				<< " endloop\nendfacet\n";
+	}
+	stl << "endsolid test\n";
+	const std::string data = stl.str();
+
+	for (unsigned threads = 1; threads <= 4; threads += 3)
+	{
+		carve::parallel::setThreadCount(threads);
+
+		std::istringstream in(data);
+		std::unique_ptr<carve::mesh::MeshSet<3>> welded(
+				readSTLasMesh(in, carve::math::Matrix::IDENT(), 0.1));
+		ASSERT_EQ(welded->vertex_storage.size(), 13U);
+		// a, b and c become a (the first of them), while d and e are kept.
+		std::vector<bool> found(5, false);
+		for (size_t v = 0; v < welded->vertex_storage.size(); ++v)
+		{
+			const carve::geom3d::Vector& p = welded->vertex_storage[v].v;
+			for (int i = 0; i < 5; ++i)
+			{
+				if (p == carve::geom::VECTOR(corner[i][0], corner[i][1], corner[i][2]))
+				{
+					found[i] = true;
+				}
+			}
+		}
+		ASSERT_TRUE(found[0]);
+		ASSERT_FALSE(found[1]);
+		ASSERT_FALSE(found[2]);
+		ASSERT_TRUE(found[3]);
+		ASSERT_TRUE(found[4]);
+	}
+	carve::parallel::setThreadCount(0);
+}
+
+TEST(FileFormatTest, CarveMeshRoundTrip)
+{
+	std::unique_ptr<carve::mesh::MeshSet<3>> torus(makeTorus(20, 20, 2.0, 0.5));
+
+	std::stringstream cmesh;
+	writeCarveMesh(cmesh, torus.get());
+
+	carve::parallel::setThreadCount(4);
+	std::unique_ptr<carve::mesh::MeshSet<3>> result(readCarveMesh(cmesh));
+	carve::parallel::setThreadCount(0);
+	ASSERT_TRUE(result != nullptr);
+
+	ASSERT_EQ(result->vertex_storage.size(), torus->vertex_storage.size());
+	ASSERT_EQ(result->meshes.size(), torus->meshes.size());
+	for (size_t m = 0; m < torus->meshes.size(); ++m)
+	{
+		const carve::mesh::Mesh<3>* a = torus->meshes[m];
+		const carve::mesh::Mesh<3>* b = result->meshes[m];
+		ASSERT_EQ(b->faces.size(), a->faces.size());
+		ASSERT_EQ(b->open_edges.size(), a->open_edges.size());
+		ASSERT_EQ(b->closed_edges.size(), a->closed_edges.size());
+		ASSERT_EQ(b->is_negative, a->is_negative);
+		ASSERT_EQ(b->meshset, result.get());
+		for (size_t f = 0; f < a->faces.size(); ++f)
+		{
+			ASSERT_EQ(b->faces[f]->nVertices(), a->faces[f]->nVertices());
+			ASSERT_EQ(b->faces[f]->plane.N, a->faces[f]->plane.N);
+			ASSERT_EQ(b->faces[f]->plane.d, a->faces[f]->plane.d);
+			ASSERT_EQ(b->faces[f]->project, a->faces[f]->project);
+			ASSERT_EQ(b->faces[f]->mesh, b);
+			b->faces[f]->edge->validateLoop();
+		}
+	}
+	ASSERT_TRUE(result->isClosed());
+	ASSERT_NEAR(result->meshes[0]->volume(), torus->meshes[0]->volume(), 1e-9);
+
+	std::unique_ptr<carve::mesh::MeshSet<3>> cube(makeCube());
+	carve::csg::CSG csg;
+	std::unique_ptr<carve::mesh::MeshSet<3>> r1(
+			csg.compute(torus.get(), cube.get(), carve::csg::CSG::UNION));
+	std::unique_ptr<carve::mesh::MeshSet<3>> r2(
+			csg.compute(result.get(), cube.get(), carve::csg::CSG::UNION));
+	ASSERT_EQ(r1->vertex_storage.size(), r2->vertex_storage.size());
+	ASSERT_EQ(r1->meshes.size(), r2->meshes.size());
+}
+
+TEST(FileFormatTest, CarveMeshRejectsBadInput)
+{
+	std::unique_ptr<carve::mesh::MeshSet<3>> cube(makeCube());
+
+	std::stringstream cmesh;
+	writeCarveMesh(cmesh, cube.get());
+	const std::string data = cmesh.str();
+
+	std::istringstream truncated(data.substr(0, data.size() - 8));
+	ASSERT_TRUE(readCarveMesh(truncated) == nullptr);
+
+	std::istringstream garbage(std::string(data.size(), 'x'));
+	ASSERT_TRUE(readCarveMesh(garbage) == nullptr);
+}
+
+static uint64_t getField(const std::string& data, size_t at)
+{
+	uint64_t v;
+	std::memcpy(&v, data.data() + at, sizeof(v));
+	return v;
+}
+
+static void setField(std::string& data, size_t at, uint64_t v)
+{
+	std::memcpy(&data[at], &v, sizeof(v));
+}
+
+static bool readsCarveMesh(const std::string& data)
+{
+	std::istringstream in(data);
+	std::unique_ptr<carve::mesh::MeshSet<3>> result(readCarveMesh(in));
+	return result != nullptr;
+}
+
+TEST(FileFormatTest, CarveMeshRejectsCorruptTables)
+{
+	using namespace carve_binary;
+
+	std::unique_ptr<carve::mesh::MeshSet<3>> cube(makeCube());
+
+	std::stringstream cmesh;
+	writeCarveMesh(cmesh, cube.get());
+	const std::string data = cmesh.str();
+	ASSERT_TRUE(readsCarveMesh(data));
+
+	const uint64_t n_vertices = getField(data, offsetof(header, n_vertices));
+	const uint64_t n_meshes = getField(data, offsetof(header, n_meshes));
+	const uint64_t n_faces = getField(data, offsetof(header, n_faces));
+	const uint64_t n_edges = getField(data, offsetof(header, n_edges));
+	ASSERT_EQ(n_meshes, 1U);
+	const size_t meshes_at = sizeof(header) + n_vertices * 3 * sizeof(double);
+	const size_t edges_at = meshes_at + n_meshes * sizeof(mesh_rec) + n_faces * sizeof(face_rec);
+	auto rev_at = [&](uint64_t e) { return edges_at + e * sizeof(edge_rec) + offsetof(edge_rec, rev); };
+
+	// section sizes that overflow when multiplied out.
+	for (size_t field : { offsetof(header, n_vertices), offsetof(header, n_faces),
+				 offsetof(header, n_edges) })
+	{
+		std::string bad = data;
+		setField(bad, field, NONE / 2);
+		ASSERT_FALSE(readsCarveMesh(bad));
+	}
+
+	// edge list counts that wrap around to the right total.
+	{
+		std::string bad = data;
+		const size_t open_at = meshes_at + offsetof(mesh_rec, n_open);
+		const size_t closed_at = meshes_at + offsetof(mesh_rec, n_closed);
+		setField(bad, open_at, getField(bad, open_at) + NONE);
+		setField(bad, closed_at, getField(bad, closed_at) + 1);
+		ASSERT_FALSE(readsCarveMesh(bad));
+	}
+
+	const uint64_t a = 0, b = getField(data, rev_at(0));
+	uint64_t c = 1;
+	while (c == b || getField(data, rev_at(c)) == a)
+	{
+		++c;
+	}
+	const uint64_t d = getField(data, rev_at(c));
+	ASSERT_LT(c, n_edges);
+
+	// a rev link that is not returned.
+	{
+		std::string bad = data;
+		setField(bad, rev_at(a), c);
+		ASSERT_FALSE(readsCarveMesh(bad));
+	}
+
+	// symmetric rev links between edges that do not share their vertices.
+	{
+		std::string bad = data;
+		setField(bad, rev_at(a), c);
+		setField(bad, rev_at(c), a);
+		setField(bad, rev_at(b), d);
+		setField(bad, rev_at(d), b);
+		ASSERT_FALSE(readsCarveMesh(bad));
+	}
+}
+
+TEST(FileFormatTest, PLYStreamedMesh)
+{
+	std::unique_ptr<carve::mesh::MeshSet<3>> torus(makeTorus(30, 30, 2.0, 0.5));
+
+	for (int ascii = 0; ascii < 2; ++ascii)
+	{
+		std::stringstream ply;
+		writePLY(ply, torus.get(), ascii != 0);
+
+		std::unique_ptr<carve::mesh::MeshSet<3>> result(readPLYasMesh(ply));
+		ASSERT_TRUE(result != nullptr);
+		ASSERT_EQ(result->vertex_storage.size(), torus->vertex_storage.size());
+		ASSERT_EQ(result->meshes.size(), 1U);
+		ASSERT_EQ(result->meshes[0]->faces.size(), torus->meshes[0]->faces.size());
+		ASSERT_TRUE(result->isClosed());
+		ASSERT_NEAR(result->meshes[0]->volume(), torus->meshes[0]->volume(), 1e-6);
+	}
+}
+
+TEST(FileFormatTest, StreamingPolyhedronData)
+{
+	std::unique_ptr<carve::mesh::MeshSet<3>> torus(makeTorus(20, 20, 2.0, 0.5));
+	carve::parallel::setThreadCount(4);
+
+	// a budget of a few faces forces many flushes and reallocations of
+	// the vertex storage after faces have been built.
+	carve::input::StreamingPolyhedronData data(64);
+	std::vector<int> idx;
+	size_t n_faces = 0;
+	for (carve::mesh::MeshSet<3>::face_iter f = torus->faceBegin();
+			 f != torus->faceEnd(); ++f, ++n_faces)
+	{
+		idx.clear();
+		for (carve::mesh::MeshSet<3>::face_t::edge_iter_t e = (*f)->begin();
+				 e != (*f)->end(); ++e)
+		{
+			idx.push_back((int)(e->vert - &torus->vertex_storage[0]));
+		}
+		// interleave vertices with faces, so that some faces refer to
+		// vertices that have not been added yet.
+		while (data.getVertexCount() < std::min<size_t>(n_faces, torus->vertex_storage.size()))
+		{
+			data.addVertex(torus->vertex_storage[data.getVertexCount()].v);
+		}
+		data.addFace(idx.begin(), idx.end());
+	}
+	while (data.getVertexCount() < torus->vertex_storage.size())
+	{
+		data.addVertex(torus->vertex_storage[data.getVertexCount()].v);
+	}
+	ASSERT_EQ((size_t)data.getFaceCount(), n_faces);
+
+	std::unique_ptr<carve::mesh::MeshSet<3>> result(
+			carve::input::Input::create<carve::mesh::MeshSet<3>>(&data));
+	carve::parallel::setThreadCount(0);
+
+	ASSERT_TRUE(result != nullptr);
+	ASSERT_EQ(result->vertex_storage.size(), torus->vertex_storage.size());
+	ASSERT_EQ(result->meshes.size(), 1U);
+	ASSERT_TRUE(result->isClosed());
+	ASSERT_NEAR(result->meshes[0]->volume(), torus->meshes[0]->volume(), 1e-9);
+}
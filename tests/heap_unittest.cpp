@@ -176,3 +176,45 @@ TEST(HeapTest, Sort)
 
 	test_sort(heap);
 }
+
+TEST(HeapTest, IndexedHeap)
+{
+	int data[] = {14, 9, 16, 1, 8, 2, 10, 18, 3, 11,
+			15, 4, 6, 19, 17, 5, 13, 7, 12, 0};
+	const size_t n = sizeof(data) / sizeof(data[0]);
+
+	carve::heap::indexed_heap<int> heap(n);
+	std::vector<carve::heap::indexed_heap<int>::entry_t> entries;
+	for (size_t i = 0; i < n; ++i)
+	{
+		entries.emplace_back(data[i], uint32_t(i));
+	}
+	heap.assign(std::move(entries));
+	ASSERT_EQ(heap.size(), n);
+
+	// raise, lower and remove some keys.
+	heap.update(0, -1);
+	heap.update(13, 20);
+	heap.update(7, 2);
+	heap.remove(3);
+	heap.remove(3);
+	ASSERT_FALSE(heap.contains(3));
+	heap.update(3, 30);
+	ASSERT_TRUE(heap.contains(3));
+
+	std::vector<int> keys;
+	std::vector<uint32_t> ids;
+	while (!heap.empty())
+	{
+		keys.push_back(heap.top_key());
+		ids.push_back(heap.pop());
+	}
+	ASSERT_EQ(keys.size(), n);
+	ASSERT_EQ(carve::is_sorted(keys.begin(), keys.end()), true);
+	ASSERT_EQ(ids.front(), 0U);
+	ASSERT_EQ(ids.back(), 3U);
+	for (size_t i = 0; i < n; ++i)
+	{
+		ASSERT_FALSE(heap.contains(uint32_t(i)));
+	}
+}
@@ -27,9 +27,16 @@
 
 #include <carve/carve.hpp>
 #include <carve/csg.hpp>
+#include <carve/csg_collector.hpp>
+#include <carve/csg_triangulator.hpp>
 #include <carve/input.hpp>
+#include <carve/interpolator.hpp>
+#include <carve/parallel.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <map>
+#include <vector>
 
 static carve::mesh::MeshSet<3>* makeCube(const carve::math::Matrix& transform)
 {
@@ -93,3 +100,703 @@ TEST(HookTest, ResultFace)
 	delete b;
 	delete a_union_b;
 }
+
+// a prism with an n-gon cross section, so that there are enough faces
+// to be divided in several chunks.
+static carve::mesh::MeshSet<3>* makePrism(int n, const carve::math::Matrix& transform)
+{
+	carve::input::PolyhedronData data;
+	for (int i = 0; i < n; ++i)
+	{
+		double a = 2.0 * M_PI * i / n;
+		data.addVertex(transform * carve::geom::VECTOR(std::cos(a), std::sin(a), -1.0));
+		data.addVertex(transform * carve::geom::VECTOR(std::cos(a), std::sin(a), +1.0));
+	}
+	std::vector<int> top, bottom;
+	for (int i = 0; i < n; ++i)
+	{
+		int j = (i + 1) % n;
+		data.addFace(2 * i, 2 * j, 2 * j + 1, 2 * i + 1);
+		top.push_back(2 * i + 1);
+		bottom.push_back(2 * (n - 1 - i));
+	}
+	data.addFace(top.begin(), top.end());
+	data.addFace(bottom.begin(), bottom.end());
+
+	return new carve::mesh::MeshSet<3>(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+struct EdgeDivisionHook : public carve::csg::CSG::Hook
+{
+	std::vector<std::pair<const carve::mesh::MeshSet<3>::edge_t*, carve::geom3d::Vector>>& calls;
+
+	EdgeDivisionHook(std::vector<std::pair<const carve::mesh::MeshSet<3>::edge_t*, carve::geom3d::Vector>>& _calls)
+			: calls(_calls) {}
+
+	void edgeDivision(const carve::mesh::MeshSet<3>::edge_t* orig_edge,
+			size_t orig_edge_idx, const carve::mesh::MeshSet<3>::vertex_t* v1,
+			const carve::mesh::MeshSet<3>::vertex_t* v2) override
+	{
+		calls.push_back(std::make_pair(orig_edge, v2->v - v1->v));
+	}
+};
+
+TEST(HookTest, EdgeDivisionOrder)
+{
+	carve::mesh::MeshSet<3>* a = makePrism(1000, carve::math::Matrix::IDENT());
+	carve::mesh::MeshSet<3>* b = makeCube(carve::math::Matrix::ROT(.5, +1, +1, +1));
+
+	std::vector<std::pair<const carve::mesh::MeshSet<3>::edge_t*, carve::geom3d::Vector>> calls[2];
+	size_t n_faces[2];
+	for (int run = 0; run < 2; ++run)
+	{
+		carve::parallel::setThreadCount(run == 0 ? 1 : 4);
+		carve::csg::CSG csg;
+		csg.hooks.registerHook(new EdgeDivisionHook(calls[run]),
+				carve::csg::CSG::Hooks::EDGE_DIVISION_BIT);
+		carve::mesh::MeshSet<3>* c = csg.compute(a, b, carve::csg::CSG::INTERSECTION);
+		n_faces[run] = std::distance(c->faceBegin(), c->faceEnd());
+		delete c;
+	}
+	carve::parallel::setThreadCount(0);
+
+	ASSERT_FALSE(calls[0].empty());
+	ASSERT_EQ(n_faces[0], n_faces[1]);
+	ASSERT_EQ(calls[0].size(), calls[1].size());
+	for (size_t i = 0; i < calls[0].size(); ++i)
+	{
+		ASSERT_EQ(calls[0][i].first, calls[1][i].first);
+		ASSERT_EQ(calls[0][i].second, calls[1][i].second);
+	}
+
+	delete a;
+	delete b;
+}
+
+static carve::mesh::MeshSet<3>* makeCubes(const std::vector<carve::math::Matrix>& transforms)
+{
+	carve::input::PolyhedronData data;
+	for (size_t i = 0; i < transforms.size(); ++i)
+	{
+		const int b = (int)data.getVertexCount();
+		for (int j = 0; j < 8; ++j)
+		{
+			data.addVertex(transforms[i] * carve::geom::VECTOR(
+																				 (j & 1) ? +1.0 : -1.0,
+																				 (j & 2) ? +1.0 : -1.0,
+																				 (j & 4) ? +1.0 : -1.0));
+		}
+		data.addFace(b + 0, b + 2, b + 3, b + 1);
+		data.addFace(b + 4, b + 5, b + 7, b + 6);
+		data.addFace(b + 0, b + 1, b + 5, b + 4);
+		data.addFace(b + 2, b + 6, b + 7, b + 3);
+		data.addFace(b + 0, b + 4, b + 6, b + 2);
+		data.addFace(b + 1, b + 3, b + 7, b + 5);
+	}
+	return new carve::mesh::MeshSet<3>(data.points, data.getFaceCount(), data.faceIndices);
+}
+
+// Compute every operation between a and b, with and without shell
+// pass-through, and check that the results agree.
+static void checkShellPassThrough(carve::mesh::MeshSet<3>* a, carve::mesh::MeshSet<3>* b)
+{
+	const carve::csg::CSG::OP ops[] = {
+		carve::csg::CSG::UNION,
+		carve::csg::CSG::INTERSECTION,
+		carve::csg::CSG::A_MINUS_B,
+		carve::csg::CSG::B_MINUS_A,
+		carve::csg::CSG::SYMMETRIC_DIFFERENCE,
+		carve::csg::CSG::ALL,
+	};
+	for (size_t op = 0; op < sizeof(ops) / sizeof(ops[0]); ++op)
+	{
+		size_t n_meshes[2], n_negative[2], n_faces[2];
+		double volume[2];
+		std::map<const carve::mesh::MeshSet<3>*, int> counter[2];
+		for (int run = 0; run < 2; ++run)
+		{
+			carve::csg::CSG csg;
+			csg.pass_through_shells = run == 1;
+			csg.hooks.registerHook(new ResultFaceHook(counter[run]),
+					carve::csg::CSG::Hooks::RESULT_FACE_BIT);
+			carve::mesh::MeshSet<3>* c = csg.compute(a, b, ops[op]);
+			n_meshes[run] = c->meshes.size();
+			n_negative[run] = 0;
+			volume[run] = 0.0;
+			for (size_t m = 0; m < c->meshes.size(); ++m)
+			{
+				ASSERT_TRUE(c->meshes[m]->isClosed());
+				n_negative[run] += c->meshes[m]->isNegative() ? 1 : 0;
+				volume[run] += c->meshes[m]->volume();
+			}
+			n_faces[run] = std::distance(c->faceBegin(), c->faceEnd());
+			delete c;
+		}
+
+		ASSERT_EQ(n_meshes[0], n_meshes[1]);
+		ASSERT_EQ(n_negative[0], n_negative[1]);
+		ASSERT_EQ(n_faces[0], n_faces[1]);
+		ASSERT_NEAR(volume[0], volume[1], 1e-9);
+		ASSERT_EQ(counter[0], counter[1]);
+	}
+}
+
+TEST(HookTest, UntouchedShellPassThrough)
+{
+	// a: a cube cut by b, and a cube that b does not reach.
+	// b: a cube that cuts a, a cube far from a, and a cube inside a.
+	carve::mesh::MeshSet<3>* a = makeCubes({
+			carve::math::Matrix::IDENT(),
+			carve::math::Matrix::TRANS(10, 0, 0),
+	});
+	carve::mesh::MeshSet<3>* b = makeCubes({
+			carve::math::Matrix::TRANS(1, 1, 1),
+			carve::math::Matrix::TRANS(0, 10, 0),
+			carve::math::Matrix::TRANS(10, 0, 0) * carve::math::Matrix::SCALE(.5, .5, .5),
+	});
+
+	checkShellPassThrough(a, b);
+
+	delete a;
+	delete b;
+}
+
+TEST(HookTest, NonIntersectingOperands)
+{
+	// operands with disjoint bounds.
+	carve::mesh::MeshSet<3>* a = makeCubes({ carve::math::Matrix::IDENT() });
+	carve::mesh::MeshSet<3>* b = makeCubes({
+			carve::math::Matrix::TRANS(10, 0, 0),
+			carve::math::Matrix::TRANS(10, 5, 0),
+	});
+	checkShellPassThrough(a, b);
+	delete b;
+
+	// overlapping bounds, but no intersecting faces.
+	b = makeCubes({
+			carve::math::Matrix::SCALE(.5, .5, .5),
+			carve::math::Matrix::TRANS(3, 3, 3),
+	});
+	checkShellPassThrough(a, b);
+	checkShellPassThrough(b, a);
+	delete b;
+
+	delete a;
+}
+
+static double volume(const carve::mesh::MeshSet<3>* poly)
+{
+	double vol = 0.0;
+	for (size_t i = 0; i < poly->meshes.size(); ++i)
+	{
+		vol += poly->meshes[i]->volume();
+	}
+	return vol;
+}
+
+TEST(HookTest, ParallelClassification)
+{
+	// a slab with a grid of cubes poking out of its top face, which
+	// splits both operands into many face loop groups.
+	std::vector<carve::math::Matrix> grid;
+	for (int i = 0; i < 8; ++i)
+	{
+		for (int j = 0; j < 8; ++j)
+		{
+			grid.push_back(carve::math::Matrix::TRANS(2.5 * i - 8.75, 2.5 * j - 8.75, 1) *
+					carve::math::Matrix::SCALE(.5, .5, .5));
+		}
+	}
+	carve::mesh::MeshSet<3>* a = makeCubes({ carve::math::Matrix::SCALE(10, 10, 1) });
+	carve::mesh::MeshSet<3>* b = makeCubes(grid);
+
+	const carve::csg::CSG::CLASSIFY_TYPE classifiers[] = {
+		carve::csg::CSG::CLASSIFY_NORMAL,
+		carve::csg::CSG::CLASSIFY_EDGE,
+		carve::csg::CSG::CLASSIFY_FLOOD,
+	};
+	for (size_t c = 0; c < 3; ++c)
+	{
+		carve::mesh::MeshSet<3>* r[2];
+		for (int threads = 0; threads < 2; ++threads)
+		{
+			carve::parallel::setThreadCount(threads ? 4 : 1);
+			carve::csg::CSG csg;
+			r[threads] = csg.compute(a, b, carve::csg::CSG::A_MINUS_B, nullptr,
+					classifiers[c]);
+		}
+		carve::parallel::setThreadCount(0);
+
+		ASSERT_EQ(r[0]->meshes.size(), r[1]->meshes.size());
+		ASSERT_EQ(r[0]->vertex_storage.size(), r[1]->vertex_storage.size());
+		ASSERT_EQ(std::distance(r[0]->faceBegin(), r[0]->faceEnd()),
+				std::distance(r[1]->faceBegin(), r[1]->faceEnd()));
+		ASSERT_NEAR(volume(r[0]), 800.0 - 64 * 0.5, 1e-6);
+		ASSERT_NEAR(volume(r[1]), volume(r[0]), 1e-6);
+
+		delete r[0];
+		delete r[1];
+	}
+
+	delete a;
+	delete b;
+}
+
+TEST(HookTest, FloodClassification)
+{
+	// cubes crossing both faces of a slab, cubes crossing one face, and
+	// cubes meeting it along a face.
+	std::vector<carve::math::Matrix> grid;
+	for (int i = 0; i < 6; ++i)
+	{
+		for (int j = 0; j < 6; ++j)
+		{
+			const double z[] = { 0.0, 1.0, 1.5 };
+			grid.push_back(carve::math::Matrix::TRANS(3 * i - 7.5, 3 * j - 7.5, z[(i + j) % 3]) *
+					carve::math::Matrix::SCALE(.5, .5, (i + j) % 3 ? .5 : 2));
+		}
+	}
+	carve::mesh::MeshSet<3>* a = makeCubes({ carve::math::Matrix::SCALE(10, 10, 1) });
+	carve::mesh::MeshSet<3>* b = makeCubes(grid);
+
+	const carve::csg::CSG::OP ops[] = {
+		carve::csg::CSG::UNION,
+		carve::csg::CSG::INTERSECTION,
+		carve::csg::CSG::A_MINUS_B,
+		carve::csg::CSG::B_MINUS_A,
+	};
+	for (carve::csg::CSG::OP op : ops)
+	{
+		carve::csg::CSG csg;
+		carve::mesh::MeshSet<3>* r0 = csg.compute(a, b, op, nullptr,
+				carve::csg::CSG::CLASSIFY_NORMAL);
+		const size_t n0 = csg.n_group_classifications;
+		carve::mesh::MeshSet<3>* r1 = csg.compute(a, b, op, nullptr,
+				carve::csg::CSG::CLASSIFY_FLOOD);
+		const size_t n1 = csg.n_group_classifications;
+
+		// the slab's top and bottom are each one region, split into many
+		// groups by the cubes crossing them, and need a single seed.
+		ASSERT_GT(n1, 0u);
+		ASSERT_LT(n1, n0);
+		ASSERT_EQ(r0->meshes.size(), r1->meshes.size());
+		ASSERT_EQ(r0->vertex_storage.size(), r1->vertex_storage.size());
+		ASSERT_EQ(std::distance(r0->faceBegin(), r0->faceEnd()),
+				std::distance(r1->faceBegin(), r1->faceEnd()));
+		ASSERT_NEAR(volume(r0), volume(r1), 1e-6);
+		delete r0;
+		delete r1;
+	}
+	delete a;
+	delete b;
+}
+
+// Face loops in an order that does not depend on where faces and
+// vertices were allocated: each loop starts at its least vertex, and
+// the loops are sorted.
+static std::vector<std::vector<carve::geom3d::Vector>> canonicalLoops(
+		std::vector<std::vector<carve::geom3d::Vector>> loops)
+{
+	for (size_t i = 0; i < loops.size(); ++i)
+	{
+		std::rotate(loops[i].begin(),
+				std::min_element(loops[i].begin(), loops[i].end()), loops[i].end());
+	}
+	std::sort(loops.begin(), loops.end());
+	return loops;
+}
+
+TEST(HookTest, DeferredTriangulation)
+{
+	carve::mesh::MeshSet<3>* a = makePrism(200, carve::math::Matrix::IDENT());
+	carve::mesh::MeshSet<3>* b = makeCubes({
+			carve::math::Matrix::ROT(.5, +1, +1, +1),
+			carve::math::Matrix::TRANS(3, 0, 0),
+	});
+
+	// triangulating as faces are collected, and afterwards on one and
+	// on several threads.
+	const unsigned bits[] = {
+		carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT,
+		carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACES_BIT,
+		carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACES_BIT,
+	};
+	std::vector<std::vector<carve::geom3d::Vector>> tris[3];
+	std::map<const carve::mesh::MeshSet<3>*, int> counter[3];
+	for (int run = 0; run < 3; ++run)
+	{
+		carve::parallel::setThreadCount(run == 2 ? 4 : 1);
+		carve::csg::CSG csg;
+		csg.hooks.registerHook(new carve::csg::CarveTriangulatorWithImprovement, bits[run]);
+		csg.hooks.registerHook(new ResultFaceHook(counter[run]),
+				carve::csg::CSG::Hooks::RESULT_FACE_BIT);
+		carve::mesh::MeshSet<3>* c = csg.compute(a, b, carve::csg::CSG::UNION);
+		for (carve::mesh::MeshSet<3>::face_iter i = c->faceBegin(); i != c->faceEnd(); ++i)
+		{
+			ASSERT_EQ((*i)->nVertices(), 3U);
+			std::vector<carve::geom3d::Vector> tri;
+			for (carve::mesh::MeshSet<3>::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e)
+			{
+				tri.push_back(e->vert->v);
+			}
+			tris[run].push_back(tri);
+		}
+		for (size_t m = 0; m < c->meshes.size(); ++m)
+		{
+			ASSERT_TRUE(c->meshes[m]->isClosed());
+		}
+		delete c;
+	}
+	carve::parallel::setThreadCount(0);
+
+	ASSERT_FALSE(tris[0].empty());
+	ASSERT_EQ(canonicalLoops(tris[0]), canonicalLoops(tris[1]));
+	ASSERT_EQ(canonicalLoops(tris[0]), canonicalLoops(tris[2]));
+	ASSERT_EQ(counter[0], counter[1]);
+	ASSERT_EQ(counter[0], counter[2]);
+
+	delete a;
+	delete b;
+}
+
+// The same hooks, given to compute() by static type.
+struct StaticTriangulator : public carve::csg::CarveTriangulatorWithImprovement
+{
+	static const unsigned hook_bits = carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT;
+};
+
+struct StaticResultFaceHook : public ResultFaceHook
+{
+	static const unsigned hook_bits = carve::csg::CSG::Hooks::RESULT_FACE_BIT;
+	using ResultFaceHook::ResultFaceHook;
+};
+
+struct StaticEdgeDivisionHook : public EdgeDivisionHook
+{
+	static const unsigned hook_bits = carve::csg::CSG::Hooks::EDGE_DIVISION_BIT;
+	using EdgeDivisionHook::EdgeDivisionHook;
+};
+
+static std::vector<std::vector<carve::geom3d::Vector>> faceLoops(
+		const carve::mesh::MeshSet<3>* m)
+{
+	std::vector<std::vector<carve::geom3d::Vector>> loops;
+	for (carve::mesh::MeshSet<3>::const_face_iter i = m->faceBegin(); i != m->faceEnd(); ++i)
+	{
+		std::vector<carve::geom3d::Vector> loop;
+		for (carve::mesh::MeshSet<3>::face_t::const_edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e)
+		{
+			loop.push_back(e->vert->v);
+		}
+		loops.push_back(loop);
+	}
+	return loops;
+}
+
+TEST(HookTest, StaticHooks)
+{
+	carve::mesh::MeshSet<3>* a = makePrism(200, carve::math::Matrix::IDENT());
+	carve::mesh::MeshSet<3>* b = makeCubes({
+			carve::math::Matrix::ROT(.5, +1, +1, +1),
+			carve::math::Matrix::TRANS(3, 0, 0),
+	});
+
+	// without hooks, including an untouched shell.
+	{
+		carve::csg::CSG csg;
+		carve::mesh::MeshSet<3>* c = csg.compute(a, b, carve::csg::CSG::UNION);
+		carve::mesh::MeshSet<3>* d = carve::csg::compute<carve::csg::CSG::UNION>(
+				csg, a, b, carve::csg::CSG::CLASSIFY_NORMAL);
+		ASSERT_EQ(faceLoops(c), faceLoops(d));
+		ASSERT_EQ(c->meshes.size(), d->meshes.size());
+		delete c;
+		delete d;
+	}
+
+	// repeated computations give the same faces, each starting at the
+	// same vertex, although intersection vertices land elsewhere.
+	{
+		std::vector<std::vector<carve::geom3d::Vector>> first;
+		for (int run = 0; run < 4; ++run)
+		{
+			carve::csg::CSG csg;
+			csg.pass_through_shells = false;
+			carve::mesh::MeshSet<3>* c = carve::csg::compute<carve::csg::CSG::A_MINUS_B>(
+					csg, a, b, carve::csg::CSG::CLASSIFY_NORMAL);
+			if (run == 0)
+			{
+				first = faceLoops(c);
+			}
+			else
+			{
+				ASSERT_EQ(first, faceLoops(c));
+			}
+			delete c;
+		}
+	}
+
+	// registered hooks, and the same hooks as static types.
+	std::map<const carve::mesh::MeshSet<3>*, int> counter[2];
+	std::vector<std::pair<const carve::mesh::MeshSet<3>::edge_t*, carve::geom3d::Vector>> calls[2];
+	std::vector<std::vector<carve::geom3d::Vector>> loops[2];
+	{
+		carve::csg::CSG csg;
+		csg.hooks.registerHook(new carve::csg::CarveTriangulatorWithImprovement,
+				carve::csg::CSG::Hooks::PROCESS_OUTPUT_FACE_BIT);
+		csg.hooks.registerHook(new ResultFaceHook(counter[0]),
+				carve::csg::CSG::Hooks::RESULT_FACE_BIT);
+		csg.hooks.registerHook(new EdgeDivisionHook(calls[0]),
+				carve::csg::CSG::Hooks::EDGE_DIVISION_BIT);
+		carve::mesh::MeshSet<3>* c = csg.compute(a, b, carve::csg::CSG::A_MINUS_B);
+		loops[0] = faceLoops(c);
+		delete c;
+	}
+	{
+		carve::csg::CSG csg;
+		StaticTriangulator triangulator;
+		StaticResultFaceHook result_face(counter[1]);
+		StaticEdgeDivisionHook edge_division(calls[1]);
+		carve::mesh::MeshSet<3>* c = carve::csg::compute<carve::csg::CSG::A_MINUS_B>(
+				csg, a, b, carve::csg::CSG::CLASSIFY_NORMAL, triangulator, result_face,
+				edge_division);
+		loops[1] = faceLoops(c);
+		delete c;
+		// the bridge for edge division is gone with the computation.
+		ASSERT_FALSE(csg.hooks.hasHook(carve::csg::CSG::Hooks::EDGE_DIVISION_HOOK));
+	}
+
+	ASSERT_FALSE(loops[0].empty());
+	for (size_t i = 0; i < loops[1].size(); ++i)
+	{
+		ASSERT_EQ(loops[1][i].size(), 3U);
+	}
+	ASSERT_EQ(loops[0], loops[1]);
+	ASSERT_EQ(counter[0], counter[1]);
+	ASSERT_FALSE(calls[0].empty());
+	ASSERT_EQ(calls[0].size(), calls[1].size());
+
+	delete a;
+	delete b;
+}
+
+// The canonical face loops of each mesh of m, with whether it is
+// closed, in an order that does not depend on mesh order.
+static std::vector<std::pair<bool, std::vector<std::vector<carve::geom3d::Vector>>>> meshLoops(
+		const carve::mesh::MeshSet<3>* m)
+{
+	std::vector<std::pair<bool, std::vector<std::vector<carve::geom3d::Vector>>>> r;
+	for (size_t i = 0; i < m->meshes.size(); ++i)
+	{
+		std::vector<std::vector<carve::geom3d::Vector>> loops;
+		for (size_t j = 0; j < m->meshes[i]->faces.size(); ++j)
+		{
+			const carve::mesh::MeshSet<3>::face_t* f = m->meshes[i]->faces[j];
+			std::vector<carve::geom3d::Vector> loop;
+			for (carve::mesh::MeshSet<3>::face_t::const_edge_iter_t e = f->begin(); e != f->end(); ++e)
+			{
+				loop.push_back(e->vert->v);
+			}
+			loops.push_back(loop);
+		}
+		r.push_back(std::make_pair(m->meshes[i]->isClosed(), canonicalLoops(loops)));
+	}
+	std::sort(r.begin(), r.end());
+	return r;
+}
+
+TEST(HookTest, NonManifoldAssembly)
+{
+	// cubes sharing an edge, so that the result has an edge with two
+	// half-edges in each direction, which only the stitcher can pair.
+	carve::mesh::MeshSet<3>* a = makeCubes({ carve::math::Matrix::IDENT() });
+	carve::mesh::MeshSet<3>* b = makeCubes({ carve::math::Matrix::TRANS(2, 2, 0) });
+
+	const carve::csg::CSG::OP ops[] = {
+		carve::csg::CSG::UNION,
+		carve::csg::CSG::SYMMETRIC_DIFFERENCE,
+	};
+	for (carve::csg::CSG::OP op : ops)
+	{
+		carve::csg::CSG csg;
+		csg.pass_through_shells = false;
+		carve::mesh::MeshSet<3>* r = csg.compute(a, b, op);
+
+		// stitch the same faces from scratch.
+		std::vector<int> face_indices;
+		size_t n_faces = 0;
+		for (carve::mesh::MeshSet<3>::face_iter i = r->faceBegin(); i != r->faceEnd(); ++i)
+		{
+			face_indices.push_back((int)(*i)->nVertices());
+			for (carve::mesh::MeshSet<3>::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e)
+			{
+				face_indices.push_back((int)(e->vert - &r->vertex_storage[0]));
+			}
+			++n_faces;
+		}
+		std::vector<carve::geom3d::Vector> points;
+		for (size_t i = 0; i < r->vertex_storage.size(); ++i)
+		{
+			points.push_back(r->vertex_storage[i].v);
+		}
+		carve::mesh::MeshSet<3>* s = new carve::mesh::MeshSet<3>(points, n_faces, face_indices);
+
+		ASSERT_EQ(n_faces, 12u);
+		ASSERT_EQ(r->meshes.size(), s->meshes.size());
+		ASSERT_EQ(meshLoops(r), meshLoops(s));
+		ASSERT_NEAR(volume(r), 16.0, 1e-9);
+		ASSERT_NEAR(volume(r), volume(s), 1e-9);
+		delete r;
+		delete s;
+	}
+	delete a;
+	delete b;
+}
+
+// A value that varies linearly over space, so that interpolating it
+// over any face should reproduce it exactly.
+struct LinearAttr
+{
+	double v{0.0};
+
+	LinearAttr& operator+=(const LinearAttr& o)
+	{
+		v += o.v;
+		return *this;
+	}
+};
+
+static LinearAttr operator*(double s, const LinearAttr& a)
+{
+	LinearAttr r;
+	r.v = s * a.v;
+	return r;
+}
+
+static double linearAt(const carve::geom3d::Vector& p)
+{
+	return 1.0 + p.x - 2.0 * p.y + 0.5 * p.z;
+}
+
+TEST(HookTest, Interpolate)
+{
+	using meshset_t = carve::mesh::MeshSet<3>;
+
+	meshset_t* a = makeCube(carve::math::Matrix::IDENT());
+	meshset_t* b = makeCube(carve::math::Matrix::ROT(.5, +1, +1, +1) *
+			carve::math::Matrix::SCALE(.8, .8, .8));
+
+	carve::interpolate::FaceVertexAttr<LinearAttr> fv;
+	carve::interpolate::FaceEdgeAttr<int> fe;
+	carve::interpolate::FaceAttr<int> f;
+
+	// each original edge is labelled with the index of its endpoints.
+	std::vector<std::pair<carve::geom3d::Vector, carve::geom3d::Vector>> edges;
+	int n_faces = 0;
+	for (meshset_t* m : { a, b })
+	{
+		for (meshset_t::face_iter i = m->faceBegin(); i != m->faceEnd(); ++i)
+		{
+			f.setAttribute(*i, n_faces++);
+			for (meshset_t::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e)
+			{
+				LinearAttr attr;
+				attr.v = linearAt(e->vert->v);
+				fv.setAttribute(*i, e.idx(), attr);
+				fe.setAttribute(*i, e.idx(), int(edges.size()));
+				edges.push_back(std::make_pair(e->v1()->v, e->v2()->v));
+			}
+		}
+	}
+	ASSERT_TRUE(fv.hasAttribute(*a->faceBegin(), 3));
+	ASSERT_FALSE(fv.hasAttribute(*a->faceBegin(), 4));
+	// corners and edges past the end of a face are ignored.
+	fv.setAttribute(*a->faceBegin(), 4, LinearAttr());
+	fe.setAttribute(*a->faceBegin(), 100, -1);
+	ASSERT_FALSE(fv.hasAttribute(*a->faceBegin(), 4));
+	ASSERT_FALSE(fe.hasAttribute(*a->faceBegin(), 100));
+
+	carve::csg::CSG csg;
+	fv.installHooks(csg);
+	fe.installHooks(csg);
+	f.installHooks(csg);
+	meshset_t* c = csg.compute(a, b, carve::csg::CSG::UNION);
+
+	size_t n_edge_attrs = 0;
+	for (meshset_t::face_iter i = c->faceBegin(); i != c->faceEnd(); ++i)
+	{
+		ASSERT_TRUE(f.hasAttribute(*i));
+		ASSERT_LT(f.getAttribute(*i), n_faces);
+		for (meshset_t::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e)
+		{
+			ASSERT_TRUE(fv.hasAttribute(*i, e.idx()));
+			ASSERT_NEAR(fv.getAttribute(*i, e.idx()).v, linearAt(e->vert->v), 1e-10);
+
+			// an edge that keeps a label lies on the edge it came from.
+			if (fe.hasAttribute(*i, e.idx()))
+			{
+				++n_edge_attrs;
+				const std::pair<carve::geom3d::Vector, carve::geom3d::Vector>& orig =
+						edges[fe.getAttribute(*i, e.idx())];
+				const carve::geom3d::Vector d = (orig.second - orig.first).normalized();
+				for (const carve::geom3d::Vector& p : { e->v1()->v, e->v2()->v })
+				{
+					ASSERT_NEAR(carve::geom::cross(d, p - orig.first).length(), 0.0, 1e-10);
+				}
+			}
+		}
+	}
+	ASSERT_GT(n_edge_attrs, 0U);
+
+	delete a;
+	delete b;
+	delete c;
+}
+
+TEST(HookTest, InterpolateChannels)
+{
+	using meshset_t = carve::mesh::MeshSet<3>;
+
+	meshset_t* a = makeCube(carve::math::Matrix::IDENT());
+	meshset_t* b = makeCube(carve::math::Matrix::ROT(.5, +1, +1, +1) *
+			carve::math::Matrix::SCALE(.8, .8, .8));
+
+	// a scalar channel, and the position itself.
+	carve::interpolate::FaceVertexChannels fv;
+	const size_t scalar = fv.addChannel(1);
+	const size_t position = fv.addChannel(3);
+	ASSERT_EQ(fv.nChannels(), 2U);
+	ASSERT_EQ(fv.channelWidth(position), 3U);
+
+	for (meshset_t* m : { a, b })
+	{
+		for (meshset_t::face_iter i = m->faceBegin(); i != m->faceEnd(); ++i)
+		{
+			for (meshset_t::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e)
+			{
+				const double s = linearAt(e->vert->v);
+				fv.setAttribute(*i, e.idx(), scalar, &s);
+				fv.setAttribute(*i, e.idx(), position, e->vert->v);
+			}
+		}
+	}
+
+	carve::csg::CSG csg;
+	fv.installHooks(csg);
+	meshset_t* c = csg.compute(a, b, carve::csg::CSG::INTERSECTION);
+
+	for (meshset_t::face_iter i = c->faceBegin(); i != c->faceEnd(); ++i)
+	{
+		for (meshset_t::face_t::edge_iter_t e = (*i)->begin(); e != (*i)->end(); ++e)
+		{
+			ASSERT_TRUE(fv.hasAttribute(*i, e.idx()));
+			ASSERT_NEAR(*fv.getAttribute(*i, e.idx(), scalar), linearAt(e->vert->v), 1e-10);
+			const carve::geom3d::Vector p =
+					fv.getAttribute(*i, e.idx(), position, carve::geom3d::Vector());
+			ASSERT_NEAR((p - e->vert->v).length(), 0.0, 1e-10);
+		}
+	}
+
+	delete a;
+	delete b;
+	delete c;
+}
@@ -0,0 +1,229 @@
+// Copyright 2006-2015 Tobias Sargeant (tobias.sargeant@gmail.com).
+//
+// This file is part of the Carve CSG Library (http://carve-csg.com/)
+//
+// Permission is hereby granted, free of charge, to any person
+// obtaining a copy of this software and associated documentation
+// files (the "Software"), to deal in the Software without
+// restriction, including without limitation the rights to use, copy,
+// modify, merge, publish, distribute, sublicense, and/or sell copies
+// of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be
+// included in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+// EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+// NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+// BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <gtest/gtest.h>
+
+#include <carve/carve.hpp>
+#include <carve/mesh.hpp>
+#include <carve/mesh_impl.hpp>
+#include <carve/mesh_simplify.hpp>
+#include <carve/parallel.hpp>
+
+#include <cmath>
+#include <vector>
+
+// A cube of side 2 about the origin, each face divided into n x n
+// squares, each split into two triangles. Optionally projected onto the
+// unit sphere.
+static carve::mesh::MeshSet<3>* makeTessellatedCube(int n, bool sphere)
+{
+	std::vector<carve::geom3d::Vector> points;
+	std::vector<int> faces;
+	size_t n_faces = 0;
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		for (int side = -1; side <= 1; side += 2)
+		{
+			const size_t base = points.size();
+			for (int i = 0; i <= n; ++i)
+			{
+				for (int j = 0; j <= n; ++j)
+				{
+					carve::geom3d::Vector v;
+					v[axis] = side;
+					v[(axis + 1) % 3] = -1.0 + 2.0 * i / n;
+					v[(axis + 2) % 3] = -1.0 + 2.0 * j / n;
+					points.push_back(sphere ? v.normalized() : v);
+				}
+			}
+			for (int i = 0; i < n; ++i)
+			{
+				for (int j = 0; j < n; ++j)
+				{
+					int a = (int)base + i * (n + 1) + j;
+					int b = a + (n + 1), c = b + 1, d = a + 1;
+					if (side < 0)
+					{
+						std::swap(b, d);
+					}
+					faces.insert(faces.end(), { 3, a, b, c, 3, a, c, d });
+					n_faces += 2;
+				}
+			}
+		}
+	}
+
+	// merge the duplicated points along the cube edges.
+	std::vector<carve::geom3d::Vector> unique;
+	std::vector<int> remap(points.size());
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		size_t j = 0;
+		while (j < unique.size() && (unique[j] - points[i]).length2() > 1e-12)
+		{
+			++j;
+		}
+		if (j == unique.size())
+		{
+			unique.push_back(points[i]);
+		}
+		remap[i] = (int)j;
+	}
+	for (size_t i = 0; i < faces.size(); i += 4)
+	{
+		for (size_t k = 1; k < 4; ++k)
+		{
+			faces[i + k] = remap[faces[i + k]];
+		}
+	}
+	return new carve::mesh::MeshSet<3>(unique, n_faces, faces);
+}
+
+static size_t faceCount(carve::mesh::MeshSet<3>* poly)
+{
+	return std::distance(poly->faceBegin(), poly->faceEnd());
+}
+
+static double volume(carve::mesh::MeshSet<3>* poly)
+{
+	double v = 0.0;
+	for (size_t i = 0; i < poly->meshes.size(); ++i)
+	{
+		v += poly->meshes[i]->volume();
+	}
+	return v;
+}
+
+TEST(MeshSimplifyTest, DecimateFlat)
+{
+	carve::mesh::MeshSet<3>* poly = makeTessellatedCube(8, false);
+	ASSERT_EQ(faceCount(poly), 6u * 8 * 8 * 2);
+
+	// flat regions collapse at no cost, until only the corners are left.
+	carve::mesh::MeshSimplifier simplifier;
+	EXPECT_GT(simplifier.decimate(poly, 0, 1e-12), 0u);
+
+	ASSERT_EQ(poly->meshes.size(), 1u);
+	EXPECT_TRUE(poly->meshes[0]->isClosed());
+	EXPECT_LE(faceCount(poly), 24u);
+	EXPECT_EQ(poly->vertex_storage.size(), faceCount(poly) / 2 + 2);
+	EXPECT_NEAR(volume(poly), 8.0, 1e-9);
+
+	delete poly;
+}
+
+TEST(MeshSimplifyTest, DecimateToTarget)
+{
+	carve::mesh::MeshSet<3>* poly = makeTessellatedCube(16, true);
+	const double v0 = volume(poly);
+
+	carve::mesh::MeshSimplifier simplifier;
+	simplifier.decimate(poly, 300);
+
+	ASSERT_EQ(poly->meshes.size(), 1u);
+	EXPECT_TRUE(poly->meshes[0]->isClosed());
+	EXPECT_LE(faceCount(poly), 300u);
+	EXPECT_GE(faceCount(poly), 290u);
+	EXPECT_EQ(poly->vertex_storage.size(), faceCount(poly) / 2 + 2);
+	EXPECT_NEAR(volume(poly), v0, 0.05 * v0);
+	for (carve::mesh::MeshSet<3>::face_iter i = poly->faceBegin();
+			 i != poly->faceEnd(); ++i)
+	{
+		EXPECT_EQ((*i)->nEdges(), 3u);
+	}
+
+	delete poly;
+}
+
+TEST(MeshSimplifyTest, DecimateKeepsBoundary)
+{
+	// an open, flat square of side 2, divided into 6 x 6 squares.
+	const int n = 6;
+	std::vector<carve::geom3d::Vector> points;
+	std::vector<int> faces;
+	for (int i = 0; i <= n; ++i)
+	{
+		for (int j = 0; j <= n; ++j)
+		{
+			points.push_back(carve::geom::VECTOR(-1.0 + 2.0 * i / n, -1.0 + 2.0 * j / n, 0.0));
+		}
+	}
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < n; ++j)
+		{
+			const int a = i * (n + 1) + j, b = a + (n + 1), c = b + 1, d = a + 1;
+			faces.insert(faces.end(), { 3, a, b, c, 3, a, c, d });
+		}
+	}
+	carve::mesh::MeshSet<3>* poly = new carve::mesh::MeshSet<3>(points, n * n * 2, faces);
+
+	carve::mesh::MeshSimplifier simplifier;
+	simplifier.decimate(poly, 0, 1e-12);
+
+	ASSERT_EQ(poly->meshes.size(), 1u);
+	double area = 0.0;
+	for (carve::mesh::MeshSet<3>::face_iter i = poly->faceBegin();
+			 i != poly->faceEnd(); ++i)
+	{
+		const carve::mesh::MeshSet<3>::edge_t* e = (*i)->edge;
+		area += carve::geom::cross(e->next->vert->v - e->vert->v,
+				e->next->next->vert->v - e->vert->v).length() / 2.0;
+	}
+	EXPECT_NEAR(area, 4.0, 1e-9);
+	EXPECT_LT(faceCount(poly), (size_t)n * n * 2);
+
+	delete poly;
+}
+
+TEST(MeshSimplifyTest, DecimatePartitioned)
+{
+	for (int threads = 1; threads <= 4; threads += 3)
+	{
+		carve::parallel::setThreadCount(threads);
+
+		carve::mesh::MeshSet<3>* flat = makeTessellatedCube(8, false);
+		carve::mesh::MeshSimplifier simplifier;
+		simplifier.decimatePartitioned(flat, 0, 1e-12, true, 8);
+		ASSERT_EQ(flat->meshes.size(), 1u);
+		EXPECT_TRUE(flat->meshes[0]->isClosed());
+		EXPECT_LE(faceCount(flat), 24u);
+		EXPECT_NEAR(volume(flat), 8.0, 1e-9);
+		delete flat;
+
+		carve::mesh::MeshSet<3>* poly = makeTessellatedCube(16, true);
+		const double v0 = volume(poly);
+		simplifier.decimatePartitioned(poly, 400, std::numeric_limits<double>::max(), true, 8);
+		ASSERT_EQ(poly->meshes.size(), 1u);
+		EXPECT_TRUE(poly->meshes[0]->isClosed());
+		EXPECT_LE(faceCount(poly), 400u);
+		EXPECT_GE(faceCount(poly), 390u);
+		EXPECT_EQ(poly->vertex_storage.size(), faceCount(poly) / 2 + 2);
+		EXPECT_NEAR(volume(poly), v0, 0.05 * v0);
+		delete poly;
+	}
+	carve::parallel::setThreadCount(0);
+}
@@ -28,9 +28,11 @@
 #include <carve/carve.hpp>
 #include <carve/mesh.hpp>
 #include <carve/mesh_impl.hpp>
+#include <carve/parallel.hpp>
 
 #include "write_ply.hpp"
 
+#include <cmath>
 #include <vector>
 
 void dumpMeshes(carve::mesh::MeshSet<3>* meshes)
@@ -353,3 +355,116 @@ TEST(MeshTest, MeshConstruction1)
 	dumpMeshes(mesh);
 	delete mesh;
 }
+
+TEST(MeshTest, RecalcFaces)
+{
+	// a mix of triangles, quads and degenerate triangles with
+	// irregular coordinates.
+	std::vector<carve::mesh::Vertex<3>> vertices;
+	for (int i = 0; i < 3000; ++i)
+	{
+		vertices.push_back(carve::mesh::Vertex<3>(carve::geom::VECTOR(
+				std::sin(i * 1.3) * 7.1, std::cos(i * 0.7) * 3.3, (i % 17) * 0.37 - 2.0)));
+	}
+	std::vector<carve::mesh::Face<3>*> faces;
+	for (size_t i = 0; i + 3 < vertices.size(); i += 3)
+	{
+		if (i % 9 == 0)
+		{
+			faces.push_back(new carve::mesh::Face<3>(&vertices[i], &vertices[i + 1], &vertices[i + 2], &vertices[i + 3]));
+		}
+		else if (i % 10 == 0)
+		{
+			faces.push_back(new carve::mesh::Face<3>(&vertices[i], &vertices[i], &vertices[i + 1]));
+		}
+		else
+		{
+			faces.push_back(new carve::mesh::Face<3>(&vertices[i], &vertices[i + 1], &vertices[i + 2]));
+		}
+	}
+
+	std::vector<carve::geom::plane<3>> expected;
+	std::vector<carve::mesh::Face<3>::project_t> expected_project;
+	for (size_t i = 0; i < faces.size(); ++i)
+	{
+		faces[i]->recalc();
+		expected.push_back(faces[i]->plane);
+		expected_project.push_back(faces[i]->project);
+		faces[i]->plane = carve::geom::plane<3>();
+	}
+
+	carve::parallel::setThreadCount(4);
+	carve::mesh::recalcFaces(faces.data(), faces.size());
+	carve::parallel::setThreadCount(0);
+
+	for (size_t i = 0; i < faces.size(); ++i)
+	{
+		ASSERT_DOUBLE_EQ(faces[i]->plane.N.x, expected[i].N.x);
+		ASSERT_DOUBLE_EQ(faces[i]->plane.N.y, expected[i].N.y);
+		ASSERT_DOUBLE_EQ(faces[i]->plane.N.z, expected[i].N.z);
+		ASSERT_DOUBLE_EQ(faces[i]->plane.d, expected[i].d);
+		ASSERT_TRUE(faces[i]->project == expected_project[i]);
+		delete faces[i];
+	}
+}
+
+TEST(MeshTest, ManyShells)
+{
+	// a grid of disjoint cubes, with the faces of the cubes interleaved
+	// so that each shell is spread through the face list.
+	const int N = 10;
+	std::vector<carve::geom::vector<3>> points;
+	for (int c = 0; c < N * N * N; ++c)
+	{
+		const double x = (c % N) * 2.0, y = (c / N % N) * 2.0, z = (c / N / N) * 2.0;
+		for (int k = 0; k < 8; ++k)
+		{
+			points.push_back(carve::geom::VECTOR(x + (k & 1), y + ((k >> 1) & 1), z + ((k >> 2) & 1)));
+		}
+	}
+	const int quads[6][4] = {{0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+			{2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+	std::vector<int> face_indices;
+	for (int q = 0; q < 6; ++q)
+	{
+		for (int c = 0; c < N * N * N; ++c)
+		{
+			face_indices.push_back(4);
+			for (int k = 0; k < 4; ++k)
+			{
+				face_indices.push_back(c * 8 + quads[q][k]);
+			}
+		}
+	}
+
+	carve::parallel::setThreadCount(4);
+	carve::mesh::MeshSet<3> shells(points, N * N * N * 6, face_indices);
+	ASSERT_EQ(shells.meshes.size(), (size_t)(N * N * N));
+	for (size_t m = 0; m < shells.meshes.size(); ++m)
+	{
+		carve::mesh::Mesh<3>* mesh = shells.meshes[m];
+		ASSERT_EQ(mesh->faces.size(), 6U);
+		ASSERT_TRUE(mesh->isClosed());
+		ASSERT_FALSE(mesh->isNegative());
+		// meshes are numbered by their lowest face.
+		ASSERT_EQ(mesh->faces[0]->edge->vert, &shells.vertex_storage[m * 8]);
+	}
+
+	shells.separateMeshes();
+	carve::parallel::setThreadCount(0);
+	ASSERT_EQ(shells.vertex_storage.size(), points.size());
+	for (size_t m = 0; m < shells.meshes.size(); ++m)
+	{
+		carve::mesh::Mesh<3>* mesh = shells.meshes[m];
+		for (size_t f = 0; f < mesh->faces.size(); ++f)
+		{
+			for (carve::mesh::Face<3>::edge_iter_t e = mesh->faces[f]->begin();
+					 e != mesh->faces[f]->end(); ++e)
+			{
+				const size_t v = e->vert - &shells.vertex_storage[0];
+				ASSERT_TRUE(v >= m * 8 && v < m * 8 + 8);
+			}
+		}
+		ASSERT_NEAR(mesh->volume(), 1.0, 1e-12);
+	}
+}
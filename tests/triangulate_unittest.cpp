@@ -29,6 +29,11 @@
 #include <carve/geom.hpp>
 #include <carve/triangulator.hpp>
 
+#include "coords.h"
+
+#include <cmath>
+#include <map>
+
 TEST(Triangulate, Test2)
 {
 	std::vector<carve::geom::vector<2>> poly;
@@ -62,3 +67,134 @@ TEST(Triangulate, Test1)
 
 	carve::triangulate::triangulate(poly, result);
 }
+
+// check that result is a triangulation of poly, with poly's winding.
+static void checkTriangulation(const std::vector<carve::geom2d::P2>& poly,
+		const std::vector<carve::triangulate::tri_idx>& result)
+{
+	ASSERT_EQ(result.size(), poly.size() - 2);
+	const double poly_area = carve::geom2d::signedArea(poly);
+	double area = 0.0;
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		const double a = carve::geom2d::signedArea(poly[result[i].a],
+				poly[result[i].b], poly[result[i].c]);
+		ASSERT_GE(a * poly_area, 0.0);
+		area += a;
+	}
+	ASSERT_NEAR(area, poly_area, 1e-9 * std::fabs(poly_area));
+}
+
+TEST(Triangulate, Monotone)
+{
+	std::vector<carve::geom2d::P2> poly;
+	std::vector<carve::triangulate::tri_idx> result;
+
+	for (size_t i = 0; i < sizeof(floral) / sizeof(floral[0]); ++i)
+	{
+		poly.push_back(carve::geom::VECTOR(floral[i][0], floral[i][1]));
+	}
+	ASSERT_TRUE(carve::triangulate::triangulateMonotone(poly, result));
+	checkTriangulation(poly, result);
+
+	std::reverse(poly.begin(), poly.end());
+	ASSERT_TRUE(carve::triangulate::triangulateMonotone(poly, result));
+	checkTriangulation(poly, result);
+
+	// a comb, with horizontal edges, collinear and repeated vertices.
+	poly.clear();
+	for (int i = 0; i < 40; ++i)
+	{
+		poly.push_back(carve::geom::VECTOR(2.0 * i, 0.0));
+		poly.push_back(carve::geom::VECTOR(2.0 * i, 0.0));
+		poly.push_back(carve::geom::VECTOR(2.0 * i + 1, 0.0));
+		poly.push_back(carve::geom::VECTOR(2.0 * i + 1, 5.0 + i % 3));
+	}
+	poly.push_back(carve::geom::VECTOR(80.0, 0.0));
+	poly.push_back(carve::geom::VECTOR(80.0, -1.0));
+	poly.push_back(carve::geom::VECTOR(0.0, -1.0));
+	ASSERT_TRUE(carve::triangulate::triangulateMonotone(poly, result));
+	checkTriangulation(poly, result);
+}
+
+TEST(Triangulate, MonotoneHoles)
+{
+	// a square with a grid of square holes, joined into one loop.
+	std::vector<std::vector<carve::geom2d::P2>> loops(1);
+	loops[0].push_back(carve::geom::VECTOR(0.0, 0.0));
+	loops[0].push_back(carve::geom::VECTOR(30.0, 0.0));
+	loops[0].push_back(carve::geom::VECTOR(30.0, 30.0));
+	loops[0].push_back(carve::geom::VECTOR(0.0, 30.0));
+	for (int i = 0; i < 10; ++i)
+	{
+		for (int j = 0; j < 10; ++j)
+		{
+			std::vector<carve::geom2d::P2> hole;
+			hole.push_back(carve::geom::VECTOR(3.0 * i + 1, 3.0 * j + 1));
+			hole.push_back(carve::geom::VECTOR(3.0 * i + 1, 3.0 * j + 2));
+			hole.push_back(carve::geom::VECTOR(3.0 * i + 2, 3.0 * j + 2));
+			hole.push_back(carve::geom::VECTOR(3.0 * i + 2, 3.0 * j + 1));
+			loops.push_back(hole);
+		}
+	}
+
+	std::vector<std::pair<size_t, size_t>> merged =
+			carve::triangulate::incorporateHolesIntoPolygon(loops);
+	std::vector<carve::geom2d::P2> poly;
+	for (size_t i = 0; i < merged.size(); ++i)
+	{
+		poly.push_back(loops[merged[i].first][merged[i].second]);
+	}
+
+	std::vector<carve::triangulate::tri_idx> result;
+	ASSERT_TRUE(carve::triangulate::triangulateMonotone(poly, result));
+	checkTriangulation(poly, result);
+	ASSERT_NEAR(std::fabs(carve::geom2d::signedArea(poly)), 800.0, 1e-9);
+
+	carve::triangulate::triangulate(poly, result);
+	checkTriangulation(poly, result);
+}
+
+TEST(Triangulate, ImproveDelaunay)
+{
+	std::vector<carve::geom2d::P2> poly;
+	std::vector<carve::triangulate::tri_idx> result;
+
+	for (size_t i = 0; i < sizeof(map) / sizeof(map[0]); ++i)
+	{
+		poly.push_back(carve::geom::VECTOR(map[i][0], map[i][1]));
+	}
+	carve::triangulate::triangulate(poly, result);
+	ASSERT_GT(carve::triangulate::improveDelaunay(poly, result), 0U);
+	checkTriangulation(poly, result);
+
+	// every internal edge is locally Delaunay.
+	std::map<std::pair<unsigned, unsigned>, unsigned> opposite;
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			opposite[std::make_pair(result[i].v[j], result[i].v[(j + 1) % 3])] =
+					result[i].v[(j + 2) % 3];
+		}
+	}
+	const double sign = carve::geom2d::signedArea(poly) < 0.0 ? +1.0 : -1.0;
+	for (size_t i = 0; i < result.size(); ++i)
+	{
+		const carve::triangulate::tri_idx& t = result[i];
+		for (unsigned j = 0; j < 3; ++j)
+		{
+			std::map<std::pair<unsigned, unsigned>, unsigned>::iterator k =
+					opposite.find(std::make_pair(t.v[(j + 1) % 3], t.v[j]));
+			if (k != opposite.end())
+			{
+				ASSERT_LE(sign * carve::geom2d::incircle(poly[t.a], poly[t.b], poly[t.c],
+														 poly[(*k).second]),
+						1e-9);
+			}
+		}
+	}
+
+	// a second pass has nothing to do.
+	ASSERT_EQ(carve::triangulate::improveDelaunay(poly, result), 0U);
+}